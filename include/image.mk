@@ -825,7 +825,7 @@ define BuildImage
   ifneq ($(DUMP),)
     all: dumpinfo
     dumpinfo: FORCE
-	@true
+	@true$$(if $$(SCAN_DEPS_FILE),$$(file >>$$(SCAN_DEPS_FILE),$$(abspath $$(MAKEFILE_LIST))))
   endif
 
   download:
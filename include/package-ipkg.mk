@@ -264,7 +264,8 @@ $(_endef)
     endif
 
 	$(INSTALL_DIR) $$(PDIR_$(1))
-	$(FAKEROOT) $(STAGING_DIR_HOST)/bin/bash $(SCRIPT_DIR)/ipkg-build -m "$(FILE_MODES)" $$(IDIR_$(1)) $$(PDIR_$(1))
+	$(if $(CONFIG_IPK_ZSTD),IPKG_ZSTD_LEVEL=$(CONFIG_IPK_ZSTD_LEVEL)) \
+	$(FAKEROOT) $(STAGING_DIR_HOST)/bin/bash $(SCRIPT_DIR)/ipkg-build -m "$(FILE_MODES)" $(if $(CONFIG_IPK_ZSTD),$(if $(filter m,$(CONFIG_PACKAGE_$(1))),-z)) $$(IDIR_$(1)) $$(PDIR_$(1))
 	@[ -f $$(IPKG_$(1)) ]
 
     $(1)-clean:
@@ -0,0 +1,10 @@
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# Read after a package or target Makefile by scripts/scan-dump.sh, records
+# the makefiles that were read to dump its metadata. Target dumps run sub-makes
+# for the image and each subtarget, which append their own MAKEFILE_LIST from
+# the dumpinfo recipes in include/target.mk and include/image.mk.
+
+ifneq ($(SCAN_DEPS_FILE),)
+  $(file >$(SCAN_DEPS_FILE),$(abspath $(MAKEFILE_LIST)))
+endif
@@ -14,12 +14,22 @@ OVERRIDELIST:=$(TMP_DIR)/info/.overrides-$(SCAN_TARGET)-$(SCAN_COOKIE)
 export ORIG_PATH:=$(if $(ORIG_PATH),$(ORIG_PATH),$(PATH))
 export PATH:=$(STAGING_DIR_HOST)/bin:$(PATH)
 
+# Dump output is cached by the content of all makefiles read, see
+# scripts/scan-dump.sh. Set SCAN_CACHE_DIR empty to disable the cache.
+# Entries of Makefiles that are no longer scanned and output that was
+# replaced are dropped after each scan, unless SCAN_CACHE_PRUNE is empty,
+# e.g. for a cache shared between trees.
+SCAN_CACHE_DIR ?= $(TOPDIR)/.scan-cache
+SCAN_CACHE_PRUNE ?= 1
+SCAN_TIMING:=$(TMP_DIR)/info/.timing-$(SCAN_TARGET)
+export SCAN_CACHE_DIR SCAN_TIMING
+
 define feedname
 $(if $(patsubst feeds/%,,$(1)),,$(word 2,$(subst /, ,$(1))))
 endef
 
 ifeq ($(SCAN_NAME),target)
-  SCAN_DEPS=image/Makefile profiles/*.mk $(TOPDIR)/include/kernel*.mk $(TOPDIR)/include/target.mk image/*.mk
+  SCAN_DEPS=image/Makefile profiles/*.mk $(TOPDIR)/include/kernel*.mk $(TOPDIR)/include/target.mk image/*.mk */target.mk
 else
   SCAN_DEPS=$(TOPDIR)/include/package*.mk
 ifneq ($(call feedname,$(SCAN_DIR)),)
@@ -43,16 +53,21 @@ else
   endef
 endif
 
+define scan_deps
+$(foreach DEP,$(1),$(wildcard $(if $(filter /%,$(DEP)),$(DEP),$(SCAN_DIR)/$(2)/$(DEP))))
+endef
+
 define PackageDir
   $(TMP_DIR)/.$(SCAN_TARGET): $(TMP_DIR)/info/.$(SCAN_TARGET)-$(1)
-  $(TMP_DIR)/info/.$(SCAN_TARGET)-$(1): $(SCAN_DIR)/$(2)/Makefile $(foreach DEP,$(DEPS_$(SCAN_DIR)/$(2)/Makefile) $(SCAN_DEPS),$(wildcard $(if $(filter /%,$(DEP)),$(DEP),$(SCAN_DIR)/$(2)/$(DEP))))
+  $(TMP_DIR)/info/.$(SCAN_TARGET)-$(1): $(SCAN_DIR)/$(2)/Makefile $(call scan_deps,$(DEPS_$(SCAN_DIR)/$(2)/Makefile) $(SCAN_DEPS),$(2))
 	{ \
 		$$(call progress,Collecting $(SCAN_NAME) info: $(SCAN_DIR)/$(2)) \
 		echo Source-Makefile: $(SCAN_DIR)/$(2)/Makefile; \
 		$(if $(3),echo Override: $(3),true); \
-		$(NO_TRACE_MAKE) --no-print-dir -r DUMP=1 FEED="$(call feedname,$(2))" -C $(SCAN_DIR)/$(2) $(SCAN_MAKEOPTS) 2>/dev/null || { \
-			mkdir -p "$(TOPDIR)/logs/$(SCAN_DIR)/$(2)"; \
-			$(NO_TRACE_MAKE) --no-print-dir -r DUMP=1 FEED="$(call feedname,$(2))" -C $(SCAN_DIR)/$(2) $(SCAN_MAKEOPTS) > $(TOPDIR)/logs/$(SCAN_DIR)/$(2)/dump.txt 2>&1; \
+		SCAN_MAKE="$(NO_TRACE_MAKE)" SCAN_MAKEOPTS="$(SCAN_MAKEOPTS)" \
+		$(SCRIPT_DIR)/scan-dump.sh $(SCAN_DIR)/$(2) "$(call feedname,$(2))" \
+			$(TOPDIR)/logs/$(SCAN_DIR)/$(2)/dump.txt \
+			$(call scan_deps,$(DEPS_$(SCAN_DIR)/$(2)/Makefile) $(SCAN_DEPS),$(2)) || { \
 			$$(call progress,ERROR: please fix $(SCAN_DIR)/$(2)/Makefile - see logs/$(SCAN_DIR)/$(2)/dump.txt for details\n) \
 			rm -f $$@; \
 		}; \
@@ -61,6 +76,17 @@ define PackageDir
 	mv $$@.tmp $$@
 endef
 
+# Summary of the last scan, with the SCAN_REPORT slowest Makefiles
+define timing_report
+	[ -z "$(SCAN_REPORT)" -o ! -s $(SCAN_TIMING) ] || { \
+		awk '{ n++; ms += $$1; if ($$2 == "hit") hit++ } \
+			END { printf "Collected $(SCAN_NAME) info of %d Makefiles, %d cached, %.1fs total\n", n, hit, ms / 1000 }' $(SCAN_TIMING); \
+		sort -rn $(SCAN_TIMING) | head -n $(SCAN_REPORT) | \
+			awk '{ printf "%8.2fs %-5s %s\n", $$1 / 1000, $$2, $$3 }'; \
+	} >&2
+	rm -f $(SCAN_TIMING)
+endef
+
 $(OVERRIDELIST):
 	rm -f $(TMP_DIR)/info/.overrides-$(SCAN_TARGET)-*
 	touch $@
@@ -113,9 +139,11 @@ $(TARGET_STAMP)::
 $(TMP_DIR)/.$(SCAN_TARGET): $(TARGET_STAMP)
 	$(call progress,Collecting $(SCAN_NAME) info: merging...)
 	-cat $(FILELIST) | awk '{gsub(/\//, "_", $$0);print "$(TMP_DIR)/info/.$(SCAN_TARGET)-" $$0}' | xargs cat > $@ 2>/dev/null
+	$(if $(SCAN_CACHE_DIR),$(if $(SCAN_CACHE_PRUNE), \
+		SCAN_MAKEOPTS="$(SCAN_MAKEOPTS)" $(SCRIPT_DIR)/scan-dump.sh --prune $(SCAN_DIR) < $(FILELIST)))
 	$(call progress,Collecting $(SCAN_NAME) info: done)
 	echo
+	$(call timing_report)
 
 FORCE:
 .PHONY: FORCE
-.NOTPARALLEL:
@@ -348,6 +348,7 @@ define BuildTargets/DumpCurrent
   .PHONY: dumpinfo
   dumpinfo : export DESCRIPTION=$$(Target/Description)
   dumpinfo:
+	@true$$(if $$(SCAN_DEPS_FILE),$$(file >>$$(SCAN_DEPS_FILE),$$(abspath $$(MAKEFILE_LIST) $$(LINUX_KCONFIG_LIST))))
 	@echo 'Target: $(TARGETID)'; \
 	 echo 'Target-Board: $(BOARD)'; \
 	 echo 'Target-Name: $(BOARDNAME)$(if $(SUBTARGETS),$(if $(SUBTARGET),))'; \
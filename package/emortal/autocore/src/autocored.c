@@ -0,0 +1,985 @@
+/*
+ * autocored - cached system status for the LuCI status page
+ *
+ * Copyright (C) 2026 ImmortalWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Samples the CPU frequency, the temperatures and the link and traffic
+ * state of the ethernet ports from sysfs and procfs at a fixed interval.
+ * The results are served by the "cpuinfo", "tempinfo" and "ethinfo" calls
+ * of the "autocore" ubus object, and the lines printed by the cpuinfo and
+ * tempinfo scripts are kept in RUN_DIR for them to return as they are.
+ * These lines are built from the same sources as the scripts used, so
+ * bcm27xx still asks vcgencmd, and x86 asks wechatpush if it is set up.
+ */
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
+#include <net/if.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libubox/blobmsg.h>
+#include <libubox/list.h>
+#include <libubox/ulog.h>
+#include <libubox/uloop.h>
+#include <libubox/utils.h>
+#include <libubus.h>
+
+#define MAX_POLICIES		16
+#define MAX_WIFI_TEMPS		8
+#define MAX_ZONES		16
+#define MAX_HWMON		64
+
+#define RUN_DIR			"/var/run/autocore"
+#define OPENWRT_RELEASE		"/etc/openwrt_release"
+#define WECHATPUSH_CONFIG	"/etc/config/wechatpush"
+#define PROC_CPUINFO		"/proc/cpuinfo"
+#define PROC_NET_DEV		"/proc/net/dev"
+#define SYS_CPUFREQ		"/sys/devices/system/cpu/cpufreq"
+#define SYS_THERMAL		"/sys/class/thermal"
+#define SYS_HWMON		"/sys/class/hwmon"
+#define SYS_IEEE80211		"/sys/class/ieee80211"
+#define SYS_NET			"/sys/class/net"
+
+#define DEGREES			"\xc2\xb0""C"
+
+enum {
+	STAT_RX_BYTES,
+	STAT_RX_PACKETS,
+	STAT_MULTICAST,
+	STAT_RX_ERRORS,
+	STAT_RX_DROPPED,
+	STAT_TX_BYTES,
+	STAT_TX_PACKETS,
+	STAT_TX_ERRORS,
+	STAT_TX_DROPPED,
+	STAT_COLLISIONS,
+	__STAT_MAX
+};
+
+static const char * const stat_names[__STAT_MAX] = {
+	[STAT_RX_BYTES] = "rx_bytes",
+	[STAT_RX_PACKETS] = "rx_packets",
+	[STAT_MULTICAST] = "multicast",
+	[STAT_RX_ERRORS] = "rx_errors",
+	[STAT_RX_DROPPED] = "rx_dropped",
+	[STAT_TX_BYTES] = "tx_bytes",
+	[STAT_TX_PACKETS] = "tx_packets",
+	[STAT_TX_ERRORS] = "tx_errors",
+	[STAT_TX_DROPPED] = "tx_dropped",
+	[STAT_COLLISIONS] = "collisions",
+};
+
+/* Where the cpuinfo script takes the frequency and temperature from */
+enum freq_source {
+	FREQ_POLICY0,
+	FREQ_POLICIES,
+	FREQ_PROC,
+	FREQ_VCGENCMD,
+	FREQ_STATIC,
+};
+
+enum temp_source {
+	TEMP_ZONE0,
+	TEMP_X86,
+	TEMP_VCGENCMD,
+};
+
+struct eth_port {
+	struct list_head list;
+
+	char name[IFNAMSIZ];
+	bool seen;
+	bool carrier;
+	int speed;
+	char duplex[8];
+
+	uint64_t stats[__STAT_MAX];
+	uint64_t rx_rate, tx_rate;
+};
+
+struct temp_zone {
+	char type[32];
+	double temp;
+};
+
+static struct {
+	char target[64];
+	enum freq_source freq_src;
+	enum temp_source temp_src;
+	bool freq_only;
+	bool ipq40xx;
+	bool wifi_device_hwmon;
+	bool intel, amd;
+	const char *static_freq;
+
+	char model[128];
+	char cores[32];
+
+	char freq[128];
+	char cpu_temp[64];
+	char hwmon[PATH_MAX];
+
+	bool has_zone0;
+	double zone0;
+
+	struct temp_zone zones[MAX_ZONES];
+	int n_zones;
+
+	double wifi_temps[MAX_WIFI_TEMPS];
+	int n_wifi_temps;
+	char mt76_temp[64];
+
+	char cpuinfo[256];
+	char tempinfo[256];
+} sys;
+
+static LIST_HEAD(ports);
+static struct timespec last_sample;
+
+static unsigned int interval = 5;
+
+static struct blob_buf b;
+static struct ubus_auto_conn conn;
+
+static int read_file(const char *path, char *buf, size_t len)
+{
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n < 0)
+		return -1;
+
+	buf[n] = 0;
+	while (n > 0 && isspace(buf[n - 1]))
+		buf[--n] = 0;
+
+	return 0;
+}
+
+static int read_int(const char *path, int *val)
+{
+	char buf[32], *end;
+
+	if (read_file(path, buf, sizeof(buf)) || !buf[0])
+		return -1;
+
+	*val = strtol(buf, &end, 10);
+
+	return *end ? -1 : 0;
+}
+
+/* A number like awk reads it: the numeric prefix, 0 without one */
+static int read_num(const char *path, double *val)
+{
+	char buf[32];
+
+	if (read_file(path, buf, sizeof(buf)) || !buf[0])
+		return -1;
+
+	*val = strtod(buf, NULL);
+
+	return 0;
+}
+
+/* Output of a command like $(...), without the trailing newlines */
+static void read_cmd(const char *cmd, char *buf, size_t len)
+{
+	size_t n = 0;
+	FILE *f;
+
+	f = popen(cmd, "r");
+	if (f) {
+		n = fread(buf, 1, len - 1, f);
+		pclose(f);
+	}
+
+	buf[n] = 0;
+	while (n > 0 && buf[n - 1] == '\n')
+		buf[--n] = 0;
+}
+
+/* $2 of awk -F <fs>, the line ends at the first newline */
+static const char *field2(char *line, const char *fs)
+{
+	char *val, *end;
+
+	line[strcspn(line, "\n")] = 0;
+
+	val = strstr(line, fs);
+	if (!val)
+		return "";
+
+	val += strlen(fs);
+	end = strstr(val, fs);
+	if (end)
+		*end = 0;
+
+	return val;
+}
+
+static bool path_exists(const char *fmt, const char *name)
+{
+	char path[128];
+
+	snprintf(path, sizeof(path), fmt, name);
+
+	return access(path, F_OK) == 0;
+}
+
+/* Write a cache file, atomically and only if its content changed */
+static void write_cache(const char *name, const char *val, char *cur, size_t len)
+{
+	char path[64], tmp[64];
+	int fd, ret;
+
+	if (!strcmp(cur, val))
+		return;
+
+	snprintf(path, sizeof(path), RUN_DIR "/%s", name);
+	snprintf(tmp, sizeof(tmp), RUN_DIR "/.%s", name);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		ULOG_WARN("failed to write %s: %s\n", tmp, strerror(errno));
+		return;
+	}
+
+	ret = write(fd, val, strlen(val));
+	close(fd);
+
+	if (ret < 0 || rename(tmp, path)) {
+		ULOG_WARN("failed to write %s: %s\n", path, strerror(errno));
+		unlink(tmp);
+		return;
+	}
+
+	snprintf(cur, len, "%s", val);
+}
+
+static void format_temp(char *buf, size_t len, double temp)
+{
+	snprintf(buf, len, "%.1f" DEGREES, temp / 1000);
+}
+
+static bool target_is(const char *prefix)
+{
+	return !strncmp(sys.target, prefix, strlen(prefix));
+}
+
+/* The scripts match some of their cases against the whole file */
+static void release_init(void)
+{
+	char buf[4096], *val;
+
+	if (read_file(OPENWRT_RELEASE, buf, sizeof(buf)))
+		return;
+
+	sys.freq_only = strstr(buf, "ipq") || strstr(buf, "mediatek");
+	sys.ipq40xx = !!strstr(buf, "ipq40xx");
+	sys.wifi_device_hwmon = sys.ipq40xx || strstr(buf, "ipq806x");
+
+	val = strstr(buf, "DISTRIB_TARGET=");
+	if (val) {
+		val += 15;
+		val[strcspn(val, "\n")] = 0;
+		if (*val == '\'' || *val == '"') {
+			val++;
+			val[strcspn(val, "'\"")] = 0;
+		}
+
+		snprintf(sys.target, sizeof(sys.target), "%s", val);
+	}
+
+	if (target_is("bcm27xx/")) {
+		sys.freq_src = FREQ_VCGENCMD;
+		sys.temp_src = TEMP_VCGENCMD;
+	} else if (target_is("bcm53xx/") || !strcmp(sys.target, "mediatek/filogic") ||
+		   target_is("mvebu/")) {
+		sys.freq_src = FREQ_STATIC;
+	} else if (target_is("rockchip/")) {
+		sys.freq_src = FREQ_POLICIES;
+	} else if (target_is("x86/")) {
+		sys.freq_src = FREQ_PROC;
+		sys.temp_src = TEMP_X86;
+	}
+}
+
+/* Model and core count, these do not change at runtime */
+static void cpuinfo_init(void)
+{
+	char line[256], core_ids[64][64];
+	unsigned int n_ids = 0, threads = 0, i;
+	bool model = false;
+	FILE *f;
+
+	f = fopen(PROC_CPUINFO, "r");
+	if (!f)
+		return;
+
+	while (fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\n")] = 0;
+
+		if (strstr(line, "processor"))
+			threads++;
+
+		if (strstr(line, "GenuineIntel"))
+			sys.intel = true;
+		else if (strstr(line, "AuthenticAMD"))
+			sys.amd = true;
+
+		if (strstr(line, "model name") && !model) {
+			snprintf(sys.model, sizeof(sys.model), "%s", field2(line, ": "));
+			model = true;
+		} else if (strstr(line, "core id")) {
+			/* sort -u of the whole lines */
+			for (i = 0; i < n_ids; i++)
+				if (!strcmp(core_ids[i], line))
+					break;
+
+			if (i == n_ids && n_ids < ARRAY_SIZE(core_ids))
+				snprintf(core_ids[n_ids++], sizeof(core_ids[0]), "%.*s",
+					 (int) sizeof(core_ids[0]) - 1, line);
+		}
+	}
+	fclose(f);
+
+	if (!sys.model[0])
+		strcpy(sys.model, "?");
+
+	if (sys.freq_src == FREQ_PROC)
+		snprintf(sys.cores, sizeof(sys.cores), "%uC %uT", n_ids, threads);
+	else
+		snprintf(sys.cores, sizeof(sys.cores), "%u", threads);
+}
+
+static void freq_update(void)
+{
+	char line[256], path[PATH_MAX];
+	const char *val;
+	size_t i, n = 0;
+	double khz;
+	glob_t gl;
+	FILE *f;
+
+	sys.freq[0] = 0;
+
+	switch (sys.freq_src) {
+	case FREQ_STATIC:
+		if (sys.static_freq)
+			snprintf(sys.freq, sizeof(sys.freq), "%s", sys.static_freq);
+		break;
+
+	case FREQ_PROC:
+		f = fopen(PROC_CPUINFO, "r");
+		if (!f)
+			break;
+
+		while (fgets(line, sizeof(line), f)) {
+			if (!strstr(line, "MHz"))
+				continue;
+
+			snprintf(sys.freq, sizeof(sys.freq), "%s", field2(line, ": "));
+			break;
+		}
+		fclose(f);
+
+		strncat(sys.freq, "MHz", sizeof(sys.freq) - strlen(sys.freq) - 1);
+		break;
+
+	case FREQ_VCGENCMD:
+		/* frequency(48)=1500398464 */
+		read_cmd("vcgencmd measure_clock arm", line, sizeof(line));
+		val = field2(line, "=");
+		if (*val)
+			snprintf(sys.freq, sizeof(sys.freq), "%lldMhz",
+				 strtoll(val, NULL, 10) / 1000000);
+		break;
+
+	case FREQ_POLICIES:
+		if (glob(SYS_CPUFREQ "/policy*/cpuinfo_cur_freq", 0, NULL, &gl))
+			break;
+
+		for (i = 0; i < gl.gl_pathc && n < sizeof(sys.freq); i++) {
+			if (read_num(gl.gl_pathv[i], &khz))
+				continue;
+
+			n += snprintf(sys.freq + n, sizeof(sys.freq) - n, "%s%.fMHz",
+				      n ? " " : "", khz / 1000);
+		}
+		globfree(&gl);
+		break;
+
+	case FREQ_POLICY0:
+		snprintf(path, sizeof(path), SYS_CPUFREQ "/policy0/cpuinfo_cur_freq");
+		if (!read_num(path, &khz))
+			snprintf(sys.freq, sizeof(sys.freq), "%.fMHz", khz / 1000);
+		break;
+	}
+}
+
+static bool hwmon_label(const char *label)
+{
+	if (sys.intel)
+		return !strncmp(label, "Package id ", 11) || !strncmp(label, "Core ", 5);
+
+	return !!strstr(label, "Tdie");
+}
+
+static bool hwmon_name(const char *name)
+{
+	size_t len = strlen(name);
+
+	if (sys.intel)
+		return !strcmp(name, "coretemp");
+
+	return name[0] == 'k' && len >= 5 && !strcmp(name + len - 4, "temp");
+}
+
+/*
+ * The first package or core temperature of coretemp with an Intel CPU, the
+ * Tdie temperature of k*temp with an AMD one, as the cpuinfo script took
+ * them from sensors(1)
+ */
+static bool hwmon_find(void)
+{
+	char path[PATH_MAX], buf[64];
+	int i, j;
+
+	if (!sys.intel && !sys.amd)
+		return false;
+
+	for (i = 0; i < MAX_HWMON; i++) {
+		snprintf(path, sizeof(path), SYS_HWMON "/hwmon%d/name", i);
+		if (read_file(path, buf, sizeof(buf)) || !hwmon_name(buf))
+			continue;
+
+		for (j = 1; j < 64; j++) {
+			snprintf(path, sizeof(path), SYS_HWMON "/hwmon%d/temp%d_label", i, j);
+			if (read_file(path, buf, sizeof(buf)) || !hwmon_label(buf))
+				continue;
+
+			snprintf(sys.hwmon, sizeof(sys.hwmon),
+				 SYS_HWMON "/hwmon%d/temp%d_input", i, j);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void x86_temp_update(void)
+{
+	char buf[64];
+	double temp;
+
+	/* The wechatpush app knows better, if it is configured */
+	if (!access(WECHATPUSH_CONFIG, F_OK))
+		read_cmd("uci -q get wechatpush.config.server_host", buf, sizeof(buf));
+	else
+		buf[0] = 0;
+
+	if (buf[0]) {
+		read_cmd("/usr/share/wechatpush/wechatpush soc", buf, sizeof(buf));
+		snprintf(sys.cpu_temp, sizeof(sys.cpu_temp), "%.*s" DEGREES,
+			 (int) sizeof(sys.cpu_temp) - 4, buf);
+		return;
+	}
+
+	if ((sys.hwmon[0] && !read_num(sys.hwmon, &temp)) ||
+	    (hwmon_find() && !read_num(sys.hwmon, &temp)))
+		format_temp(sys.cpu_temp, sizeof(sys.cpu_temp), temp);
+}
+
+static void temp_update(void)
+{
+	char path[PATH_MAX], buf[64];
+	const char *val;
+	struct dirent *e;
+	size_t i;
+	glob_t gl;
+	DIR *d;
+
+	sys.has_zone0 = !read_num(SYS_THERMAL "/thermal_zone0/temp", &sys.zone0);
+
+	sys.cpu_temp[0] = 0;
+	switch (sys.temp_src) {
+	case TEMP_VCGENCMD:
+		/* temp=47.2'C */
+		read_cmd("vcgencmd measure_temp", buf, sizeof(buf));
+		val = field2(buf, "=");
+		snprintf(sys.cpu_temp, sizeof(sys.cpu_temp), "%.*s" DEGREES,
+			 (int) strcspn(val, "'"), val);
+		break;
+
+	case TEMP_X86:
+		x86_temp_update();
+		break;
+
+	case TEMP_ZONE0:
+		if (sys.has_zone0)
+			format_temp(sys.cpu_temp, sizeof(sys.cpu_temp), sys.zone0);
+		break;
+	}
+
+	sys.n_zones = 0;
+	d = opendir(SYS_THERMAL);
+	if (d) {
+		while ((e = readdir(d)) != NULL && sys.n_zones < MAX_ZONES) {
+			struct temp_zone *zone = &sys.zones[sys.n_zones];
+
+			if (strncmp(e->d_name, "thermal_zone", 12) != 0)
+				continue;
+
+			snprintf(path, sizeof(path), SYS_THERMAL "/%s/temp", e->d_name);
+			if (read_num(path, &zone->temp))
+				continue;
+
+			snprintf(path, sizeof(path), SYS_THERMAL "/%s/type", e->d_name);
+			if (read_file(path, zone->type, sizeof(zone->type)) || !zone->type[0])
+				snprintf(zone->type, sizeof(zone->type), "%.*s",
+					 (int) sizeof(zone->type) - 1, e->d_name);
+
+			sys.n_zones++;
+		}
+		closedir(d);
+	}
+
+	/* Only the part after ": " of the mt76 sensor, which is none */
+	sys.mt76_temp[0] = 0;
+	if (sys.ipq40xx && !access(SYS_IEEE80211 "/phy0/hwmon0/temp1_input", F_OK)) {
+		if (read_file(SYS_IEEE80211 "/phy0/hwmon0/temp1_input", buf, sizeof(buf)))
+			buf[0] = 0;
+
+		snprintf(sys.mt76_temp, sizeof(sys.mt76_temp), "%s" DEGREES,
+			 field2(buf, ": "));
+	}
+
+	sys.n_wifi_temps = 0;
+	if (glob(sys.wifi_device_hwmon ?
+		 SYS_IEEE80211 "/phy*/device/hwmon/hwmon*/temp1_input" :
+		 SYS_IEEE80211 "/phy*/hwmon*/temp1_input", 0, NULL, &gl))
+		return;
+
+	for (i = 0; i < gl.gl_pathc && sys.n_wifi_temps < MAX_WIFI_TEMPS; i++)
+		if (!read_num(gl.gl_pathv[i], &sys.wifi_temps[sys.n_wifi_temps]))
+			sys.n_wifi_temps++;
+	globfree(&gl);
+}
+
+/* Same line as the cpuinfo script */
+static void format_cpuinfo(char *buf, size_t len)
+{
+	const char *freq = sys.freq, *temp = sys.cpu_temp;
+
+	if (!freq[0] && temp[0])
+		snprintf(buf, len, "%s x %s (%s)", sys.model, sys.cores, temp);
+	else if ((!temp[0] && freq[0]) || sys.freq_only)
+		snprintf(buf, len, "%s x %s (%s)", sys.model, sys.cores, freq);
+	else if (temp[0] && freq[0])
+		snprintf(buf, len, "%s x %s (%s, %s)", sys.model, sys.cores, freq, temp);
+	else
+		snprintf(buf, len, "%s x %s", sys.model, sys.cores);
+}
+
+/* Same line as the tempinfo script */
+static void format_tempinfo(char *buf, size_t len)
+{
+	char cpu[16] = "", wifi[192] = "";
+	size_t n = 0;
+	int i;
+
+	if (sys.has_zone0 && !sys.ipq40xx)
+		format_temp(cpu, sizeof(cpu), sys.zone0);
+
+	for (i = 0; i < sys.n_wifi_temps && n < sizeof(wifi); i++) {
+		if (i)
+			wifi[n++] = ' ';
+		format_temp(wifi + n, sizeof(wifi) - n, sys.wifi_temps[i]);
+		n += strlen(wifi + n);
+	}
+
+	if (sys.mt76_temp[0] && n < sizeof(wifi))
+		snprintf(wifi + n, sizeof(wifi) - n, "%s%s", n ? " " : "", sys.mt76_temp);
+
+	if (cpu[0] && wifi[0])
+		snprintf(buf, len, "CPU: %s, WiFi: %s", cpu, wifi);
+	else if (cpu[0])
+		snprintf(buf, len, "CPU: %s", cpu);
+	else if (wifi[0])
+		snprintf(buf, len, "WiFi: %s", wifi);
+	else
+		snprintf(buf, len, "No temperature info");
+}
+
+static struct eth_port *port_find(const char *name)
+{
+	struct eth_port *port;
+
+	list_for_each_entry(port, &ports, list)
+		if (!strcmp(port->name, name))
+			return port;
+
+	return NULL;
+}
+
+/* Physical ethernet ports, and switch ports, but not their DSA conduit */
+static bool port_valid(const char *name)
+{
+	char path[128];
+	int type;
+
+	snprintf(path, sizeof(path), SYS_NET "/%s/type", name);
+	if (read_int(path, &type) || type != 1)
+		return false;
+
+	return path_exists(SYS_NET "/%s/device", name) &&
+	       !path_exists(SYS_NET "/%s/wireless", name) &&
+	       !path_exists(SYS_NET "/%s/phy80211", name) &&
+	       !path_exists(SYS_NET "/%s/dsa", name);
+}
+
+static void port_update(struct eth_port *port, const uint64_t *stats, double elapsed)
+{
+	char path[128], buf[16];
+
+	snprintf(path, sizeof(path), SYS_NET "/%s/carrier", port->name);
+	port->carrier = !read_file(path, buf, sizeof(buf)) && !strcmp(buf, "1");
+
+	port->speed = 0;
+	port->duplex[0] = 0;
+	if (port->carrier) {
+		snprintf(path, sizeof(path), SYS_NET "/%s/speed", port->name);
+		if (read_int(path, &port->speed) || port->speed < 0)
+			port->speed = 0;
+
+		snprintf(path, sizeof(path), SYS_NET "/%s/duplex", port->name);
+		if (read_file(path, port->duplex, sizeof(port->duplex)) ||
+		    !strcmp(port->duplex, "unknown"))
+			port->duplex[0] = 0;
+	}
+
+	port->rx_rate = port->tx_rate = 0;
+	if (port->seen && elapsed > 0) {
+		if (stats[STAT_RX_BYTES] >= port->stats[STAT_RX_BYTES])
+			port->rx_rate = (stats[STAT_RX_BYTES] - port->stats[STAT_RX_BYTES]) / elapsed;
+		if (stats[STAT_TX_BYTES] >= port->stats[STAT_TX_BYTES])
+			port->tx_rate = (stats[STAT_TX_BYTES] - port->stats[STAT_TX_BYTES]) / elapsed;
+	}
+
+	memcpy(port->stats, stats, sizeof(port->stats));
+	port->seen = true;
+}
+
+/* All counters of all devices are taken from a single read of /proc/net/dev */
+static void ports_update(void)
+{
+	struct eth_port *port, *tmp;
+	uint64_t val[16], stats[__STAT_MAX];
+	struct timespec now;
+	char line[512], *name, *p;
+	double elapsed;
+	unsigned int i;
+	FILE *f;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed = (now.tv_sec - last_sample.tv_sec) +
+		  (now.tv_nsec - last_sample.tv_nsec) / 1e9;
+	last_sample = now;
+
+	f = fopen(PROC_NET_DEV, "r");
+	if (!f)
+		return;
+
+	list_for_each_entry(port, &ports, list)
+		port->seen = false;
+
+	while (fgets(line, sizeof(line), f)) {
+		p = strchr(line, ':');
+		if (!p)
+			continue;
+
+		*p++ = 0;
+		name = line + strspn(line, " ");
+		if (strlen(name) >= IFNAMSIZ)
+			continue;
+
+		for (i = 0; i < ARRAY_SIZE(val); i++)
+			val[i] = strtoull(p, &p, 10);
+
+		/* rx: bytes packets errs drop fifo frame compressed multicast
+		 * tx: bytes packets errs drop fifo colls carrier compressed */
+		stats[STAT_RX_BYTES] = val[0];
+		stats[STAT_RX_PACKETS] = val[1];
+		stats[STAT_RX_ERRORS] = val[2];
+		stats[STAT_RX_DROPPED] = val[3];
+		stats[STAT_MULTICAST] = val[7];
+		stats[STAT_TX_BYTES] = val[8];
+		stats[STAT_TX_PACKETS] = val[9];
+		stats[STAT_TX_ERRORS] = val[10];
+		stats[STAT_TX_DROPPED] = val[11];
+		stats[STAT_COLLISIONS] = val[13];
+
+		port = port_find(name);
+		if (!port) {
+			if (!port_valid(name))
+				continue;
+
+			port = calloc(1, sizeof(*port));
+			if (!port)
+				continue;
+
+			snprintf(port->name, sizeof(port->name), "%s", name);
+			list_add_tail(&port->list, &ports);
+		} else {
+			/* flag a port as already sampled, for the rates */
+			port->seen = true;
+		}
+
+		port_update(port, stats, elapsed);
+	}
+	fclose(f);
+
+	list_for_each_entry_safe(port, tmp, &ports, list) {
+		if (port->seen)
+			continue;
+
+		list_del(&port->list);
+		free(port);
+	}
+}
+
+static void status_update(void)
+{
+	char buf[256];
+
+	freq_update();
+	temp_update();
+	ports_update();
+
+	format_cpuinfo(buf, sizeof(buf));
+	write_cache("cpuinfo", buf, sys.cpuinfo, sizeof(sys.cpuinfo));
+
+	format_tempinfo(buf, sizeof(buf));
+	write_cache("tempinfo", buf, sys.tempinfo, sizeof(sys.tempinfo));
+}
+
+static void status_timer_cb(struct uloop_timeout *t)
+{
+	status_update();
+	uloop_timeout_set(t, interval * 1000);
+}
+
+static struct uloop_timeout status_timer = {
+	.cb = status_timer_cb,
+};
+
+static void blobmsg_add_temp(struct blob_buf *buf, const char *name, double temp)
+{
+	blobmsg_add_double(buf, name, temp / 1000);
+}
+
+static int
+autocore_cpuinfo(struct ubus_context *ctx, struct ubus_object *obj,
+		 struct ubus_request_data *req, const char *method,
+		 struct blob_attr *msg)
+{
+	const char *p = sys.freq;
+	char *end;
+	double val;
+	void *c;
+
+	blob_buf_init(&b, 0);
+
+	blobmsg_add_string(&b, "cpuinfo", sys.cpuinfo);
+	blobmsg_add_string(&b, "model", sys.model);
+	blobmsg_add_string(&b, "cores", sys.cores);
+
+	/* MHz of each policy, in the order shown */
+	c = blobmsg_open_array(&b, "frequency");
+	while (*p) {
+		val = strtod(p, &end);
+		if (end != p)
+			blobmsg_add_u32(&b, NULL, val + 0.5);
+		p = end + strcspn(end, " ");
+		p += strspn(p, " ");
+	}
+	blobmsg_close_array(&b, c);
+
+	val = strtod(sys.cpu_temp, &end);
+	if (end != sys.cpu_temp)
+		blobmsg_add_double(&b, "temperature", val);
+
+	ubus_send_reply(ctx, req, b.head);
+
+	return 0;
+}
+
+static int
+autocore_tempinfo(struct ubus_context *ctx, struct ubus_object *obj,
+		  struct ubus_request_data *req, const char *method,
+		  struct blob_attr *msg)
+{
+	void *c;
+	int i;
+
+	blob_buf_init(&b, 0);
+
+	blobmsg_add_string(&b, "tempinfo", sys.tempinfo);
+	if (sys.has_zone0)
+		blobmsg_add_temp(&b, "cpu", sys.zone0);
+
+	c = blobmsg_open_array(&b, "wifi");
+	for (i = 0; i < sys.n_wifi_temps; i++)
+		blobmsg_add_temp(&b, NULL, sys.wifi_temps[i]);
+	blobmsg_close_array(&b, c);
+
+	c = blobmsg_open_table(&b, "zones");
+	for (i = 0; i < sys.n_zones; i++)
+		blobmsg_add_temp(&b, sys.zones[i].type, sys.zones[i].temp);
+	blobmsg_close_table(&b, c);
+
+	ubus_send_reply(ctx, req, b.head);
+
+	return 0;
+}
+
+static int
+autocore_ethinfo(struct ubus_context *ctx, struct ubus_object *obj,
+		 struct ubus_request_data *req, const char *method,
+		 struct blob_attr *msg)
+{
+	struct eth_port *port;
+	void *c, *d, *s;
+	int i;
+
+	blob_buf_init(&b, 0);
+
+	c = blobmsg_open_table(&b, "ports");
+	list_for_each_entry(port, &ports, list) {
+		d = blobmsg_open_table(&b, port->name);
+		blobmsg_add_u8(&b, "carrier", port->carrier);
+		if (port->speed)
+			blobmsg_add_u32(&b, "speed", port->speed);
+		if (port->duplex[0])
+			blobmsg_add_string(&b, "duplex", port->duplex);
+		blobmsg_add_u64(&b, "rx_rate", port->rx_rate);
+		blobmsg_add_u64(&b, "tx_rate", port->tx_rate);
+
+		s = blobmsg_open_table(&b, "stats");
+		for (i = 0; i < __STAT_MAX; i++)
+			blobmsg_add_u64(&b, stat_names[i], port->stats[i]);
+		blobmsg_close_table(&b, s);
+
+		blobmsg_close_table(&b, d);
+	}
+	blobmsg_close_table(&b, c);
+
+	ubus_send_reply(ctx, req, b.head);
+
+	return 0;
+}
+
+static const struct ubus_method autocore_methods[] = {
+	UBUS_METHOD_NOARG("cpuinfo", autocore_cpuinfo),
+	UBUS_METHOD_NOARG("tempinfo", autocore_tempinfo),
+	UBUS_METHOD_NOARG("ethinfo", autocore_ethinfo),
+};
+
+static struct ubus_object_type autocore_object_type =
+	UBUS_OBJECT_TYPE("autocore", autocore_methods);
+
+static struct ubus_object autocore_object = {
+	.name = "autocore",
+	.type = &autocore_object_type,
+	.methods = autocore_methods,
+	.n_methods = ARRAY_SIZE(autocore_methods),
+};
+
+static void ubus_connect_handler(struct ubus_context *ctx)
+{
+	if (ubus_add_object(ctx, &autocore_object))
+		ULOG_ERR("failed to add ubus object\n");
+}
+
+static int usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [options]\n"
+		"Options:\n"
+		" -i <seconds>:	Update interval (default: %u)\n"
+		" -m <freq>:	CPU frequency as shown, for targets without cpufreq\n"
+		" -s <path>:	Path to the ubus socket\n"
+		"\n", prog, interval);
+
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	int ch;
+
+	while ((ch = getopt(argc, argv, "i:m:s:")) != -1) {
+		switch (ch) {
+		case 'i':
+			interval = strtoul(optarg, NULL, 0);
+			if (!interval)
+				interval = 1;
+			break;
+		case 'm':
+			sys.static_freq = *optarg ? optarg : NULL;
+			break;
+		case 's':
+			conn.path = optarg;
+			break;
+		default:
+			return usage(argv[0]);
+		}
+	}
+
+	ulog_open(ULOG_SYSLOG | ULOG_STDIO, LOG_DAEMON, "autocored");
+
+	if (mkdir(RUN_DIR, 0755) && errno != EEXIST)
+		ULOG_WARN("failed to create %s: %s\n", RUN_DIR, strerror(errno));
+
+	release_init();
+	cpuinfo_init();
+
+	uloop_init();
+
+	conn.cb = ubus_connect_handler;
+	ubus_auto_connect(&conn);
+
+	status_timer_cb(&status_timer);
+	uloop_run();
+
+	ubus_auto_shutdown(&conn);
+	uloop_done();
+
+	/* the scripts fall back to sampling themselves */
+	unlink(RUN_DIR "/cpuinfo");
+	unlink(RUN_DIR "/tempinfo");
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+#!/bin/sh
+# Measure trelay throughput between two veth pairs, in qdisc and direct mode.
+#
+#   [ns tx] a0 <-> a1 [trelay] b1 <-> b0 [ns rx]
+#
+# Frames are generated with pktgen on a0 and counted on b0.
+# Requires root, iproute2, debugfs and the trelay and pktgen modules.
+#
+# Environment:
+#   DURATION  seconds per run (default 10)
+#   PKT_SIZE  pktgen frame size (default 64)
+#   THREADS   pktgen threads / veth queues (default 1)
+#   XDP_OBJ   optional XDP object attached to a1 and b1 in generic mode,
+#             to measure the relay behind an XDP_PASS program
+
+set -e
+
+DURATION="${DURATION:-10}"
+PKT_SIZE="${PKT_SIZE:-64}"
+THREADS="${THREADS:-1}"
+
+trelay=/sys/kernel/debug/trelay
+ns_tx="trelay-tx-$$"
+ns_rx="trelay-rx-$$"
+relay="bench-$$"
+
+cleanup() {
+	[ -d "$trelay/$relay" ] && echo > "$trelay/$relay/remove"
+	ip link del a1 2>/dev/null || true
+	ip link del b1 2>/dev/null || true
+	ip netns del "$ns_tx" 2>/dev/null || true
+	ip netns del "$ns_rx" 2>/dev/null || true
+}
+trap cleanup EXIT
+
+modprobe trelay
+modprobe pktgen
+[ -d "$trelay" ] || mount -t debugfs none /sys/kernel/debug
+
+ip netns add "$ns_tx"
+ip netns add "$ns_rx"
+ip link add a0 numtxqueues "$THREADS" numrxqueues "$THREADS" netns "$ns_tx" \
+	type veth peer name a1 numtxqueues "$THREADS" numrxqueues "$THREADS"
+ip link add b0 numtxqueues "$THREADS" numrxqueues "$THREADS" netns "$ns_rx" \
+	type veth peer name b1 numtxqueues "$THREADS" numrxqueues "$THREADS"
+for dev in a1 b1; do
+	ip link set "$dev" up
+	[ -n "$XDP_OBJ" ] && ip link set dev "$dev" xdpgeneric obj "$XDP_OBJ" sec xdp
+done
+ip -n "$ns_tx" link set a0 up
+ip -n "$ns_rx" link set b0 up
+
+dst_mac="$(ip netns exec "$ns_rx" cat /sys/class/net/b0/address)"
+
+pgset() {
+	ip netns exec "$ns_tx" sh -c "echo '$2' > /proc/net/pktgen/$1"
+}
+
+pktgen_setup() {
+	local i=0
+
+	while [ "$i" -lt "$THREADS" ]; do
+		pgset "kpktgend_$i" "rem_device_all"
+		pgset "kpktgend_$i" "add_device a0@$i"
+		pgset "a0@$i" "count 0"
+		pgset "a0@$i" "pkt_size $PKT_SIZE"
+		pgset "a0@$i" "queue_map_min $i"
+		pgset "a0@$i" "queue_map_max $i"
+		pgset "a0@$i" "dst 198.51.100.2"
+		pgset "a0@$i" "dst_mac $dst_mac"
+		pgset "a0@$i" "flag UDPSRC_RND"
+		pgset "a0@$i" "udp_src_min 1024"
+		pgset "a0@$i" "udp_src_max 65535"
+		i=$((i + 1))
+	done
+}
+
+rx_packets() {
+	ip netns exec "$ns_rx" cat /sys/class/net/b0/statistics/rx_packets
+}
+
+run() {
+	local mode="$1" opt="" start end
+
+	[ "$mode" = direct ] && opt=",direct"
+	echo "$relay,a1,b1$opt" > "$trelay/add"
+
+	start="$(rx_packets)"
+	ip netns exec "$ns_tx" sh -c "echo start > /proc/net/pktgen/pgctrl" &
+	sleep "$DURATION"
+	ip netns exec "$ns_tx" sh -c "echo stop > /proc/net/pktgen/pgctrl" || true
+	wait
+	end="$(rx_packets)"
+
+	printf "%-8s %12d pps\n" "$mode" $(((end - start) / DURATION))
+	cat "$trelay/$relay/stats"
+	echo
+
+	echo > "$trelay/$relay/remove"
+}
+
+pktgen_setup
+run qdisc
+run direct
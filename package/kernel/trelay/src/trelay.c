@@ -19,6 +19,13 @@
 #include <linux/netdevice.h>
 #include <linux/rtnetlink.h>
 #include <linux/debugfs.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/u64_stats_sync.h>
+#include <linux/version.h>
+
+/* frames queued per relay direction and CPU before direct xmit */
+#define TRELAY_BULK	16
 
 #define trelay_log(loglevel, tr, fmt, ...) \
 	printk(loglevel "trelay: %s <-> %s: " fmt "\n", \
@@ -27,30 +34,261 @@
 static LIST_HEAD(trelay_devs);
 static struct dentry *debugfs_dir;
 
+struct trelay_stats {
+	u64_stats_t rx_packets;
+	u64_stats_t rx_bytes;
+	u64_stats_t tx_packets;
+	u64_stats_t tx_bytes;
+	u64_stats_t tx_dropped;
+	struct u64_stats_sync syncp;
+};
+
+struct trelay_pcpu {
+	struct trelay_stats stats;
+
+	/* entry on the trelay_flush list of this CPU, empty if not queued */
+	struct list_head flush;
+	struct trelay_port *port;
+
+	unsigned int bulk_len;
+	struct sk_buff *bulk[TRELAY_BULK];
+};
+
+/* one direction of a relay, attached as rx_handler_data to dev */
+struct trelay_port {
+	struct trelay *tr;
+	struct net_device *dev, *peer;
+	struct trelay_pcpu __percpu *pcpu;
+};
+
 struct trelay {
 	struct list_head list;
 	struct net_device *dev1, *dev2;
+	struct trelay_port port[2];
 	struct dentry *debugfs;
 	int to_remove;
+	bool direct;
 	char name[];
 };
 
+/*
+ * In direct mode, frames are queued per CPU and relay direction and handed
+ * to the peer driver from a per-CPU NAPI context, which runs once the NAPI
+ * poll of the receiving device has finished. This bypasses the qdisc layer
+ * and lets the driver defer its doorbell write via xmit_more.
+ */
+struct trelay_flush {
+	struct list_head list;
+	struct napi_struct napi;
+};
+
+static DEFINE_PER_CPU(struct trelay_flush, trelay_flush);
+static struct net_device trelay_napi_dev;
+
+static void trelay_stats_add(struct trelay_stats *st, u64_stats_t *packets,
+			     u64_stats_t *bytes, unsigned int len)
+{
+	u64_stats_update_begin(&st->syncp);
+	u64_stats_inc(packets);
+	if (bytes)
+		u64_stats_add(bytes, len);
+	u64_stats_update_end(&st->syncp);
+}
+
+#define trelay_count(st, dir, len) \
+	trelay_stats_add(st, &(st)->dir##_packets, &(st)->dir##_bytes, len)
+
+#define trelay_count_drop(st) \
+	trelay_stats_add(st, &(st)->tx_dropped, NULL, 0)
+
+static u16 trelay_pick_tx(struct net_device *dev, struct sk_buff *skb)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	int queue;
+
+	if (dev->real_num_tx_queues == 1)
+		return 0;
+
+	/* keep frames on the TX queue matching the RX queue they arrived on,
+	 * which usually maps to the same CPU on both sides */
+	if (ops->ndo_select_queue)
+		queue = ops->ndo_select_queue(dev, skb, NULL);
+	else if (skb_rx_queue_recorded(skb))
+		queue = skb_get_rx_queue(skb);
+	else
+		queue = netdev_pick_tx(dev, skb, NULL);
+
+	if (unlikely(queue < 0 || queue >= dev->real_num_tx_queues))
+		queue = (unsigned int)queue % dev->real_num_tx_queues;
+
+	return queue;
+}
+
+static void trelay_tx_lock(struct net_device *dev, struct netdev_queue *txq)
+{
+	if (!(dev->features & NETIF_F_LLTX))
+		__netif_tx_lock(txq, smp_processor_id());
+}
+
+static void trelay_tx_unlock(struct net_device *dev, struct netdev_queue *txq)
+{
+	if (!(dev->features & NETIF_F_LLTX))
+		__netif_tx_unlock(txq);
+}
+
+static bool trelay_bulk_more(struct trelay_pcpu *pc, unsigned int i, u16 queue)
+{
+	struct sk_buff *skb;
+
+	if (i >= pc->bulk_len)
+		return false;
+
+	skb = pc->bulk[i];
+	return skb && skb_get_queue_mapping(skb) == queue;
+}
+
+static void trelay_xmit_bulk(struct trelay_pcpu *pc)
+{
+	struct net_device *dev = pc->port->peer;
+	struct trelay_stats *st = &pc->stats;
+	struct netdev_queue *txq = NULL;
+	struct sk_buff *skb, *next;
+	unsigned int i;
+
+	/* checksum offload fixups and segmentation, outside of the queue lock */
+	for (i = 0; i < pc->bulk_len; i++) {
+		bool again = false;
+
+		pc->bulk[i] = validate_xmit_skb_list(pc->bulk[i], dev, &again);
+		if (!pc->bulk[i])
+			trelay_count_drop(st);
+	}
+
+	for (i = 0; i < pc->bulk_len; i++) {
+		u16 queue;
+
+		skb = pc->bulk[i];
+		if (!skb)
+			continue;
+
+		queue = skb_get_queue_mapping(skb);
+		if (txq != netdev_get_tx_queue(dev, queue)) {
+			if (txq)
+				trelay_tx_unlock(dev, txq);
+			txq = netdev_get_tx_queue(dev, queue);
+			trelay_tx_lock(dev, txq);
+		}
+
+		for (; skb; skb = next) {
+			unsigned int len = skb->len;
+			netdev_tx_t rc;
+			bool more;
+
+			next = skb->next;
+			skb_mark_not_on_list(skb);
+
+			if (netif_xmit_frozen_or_drv_stopped(txq)) {
+				kfree_skb(skb);
+				trelay_count_drop(st);
+				continue;
+			}
+
+			more = next || trelay_bulk_more(pc, i + 1, queue);
+			rc = netdev_start_xmit(skb, dev, txq, more);
+			if (rc == NETDEV_TX_OK) {
+				trelay_count(st, tx, len);
+				continue;
+			}
+
+			if (!dev_xmit_complete(rc))
+				kfree_skb(skb);
+			trelay_count_drop(st);
+		}
+	}
+
+	if (txq)
+		trelay_tx_unlock(dev, txq);
+
+	pc->bulk_len = 0;
+}
+
+static int trelay_flush_poll(struct napi_struct *napi, int budget)
+{
+	struct trelay_flush *fl = container_of(napi, struct trelay_flush, napi);
+	struct trelay_pcpu *pc, *tmp;
+
+	/* the NAPI context of an offlined CPU may run elsewhere, so always use
+	 * the list it belongs to instead of the local one */
+	list_for_each_entry_safe(pc, tmp, &fl->list, flush) {
+		list_del_init(&pc->flush);
+		trelay_xmit_bulk(pc);
+	}
+
+	napi_complete(napi);
+
+	return 0;
+}
+
+static void trelay_enqueue(struct trelay_pcpu *pc, struct sk_buff *skb)
+{
+	struct trelay_flush *fl;
+
+	skb_set_queue_mapping(skb, trelay_pick_tx(skb->dev, skb));
+	pc->bulk[pc->bulk_len++] = skb;
+	if (pc->bulk_len == TRELAY_BULK) {
+		trelay_xmit_bulk(pc);
+		return;
+	}
+
+	if (!list_empty(&pc->flush))
+		return;
+
+	fl = this_cpu_ptr(&trelay_flush);
+	list_add_tail(&pc->flush, &fl->list);
+	napi_schedule(&fl->napi);
+}
+
 rx_handler_result_t trelay_handle_frame(struct sk_buff **pskb)
 {
+	struct trelay_port *port;
+	struct trelay_pcpu *pc;
 	struct net_device *dev;
 	struct sk_buff *skb = *pskb;
+	unsigned int len;
 
-	dev = rcu_dereference(skb->dev->rx_handler_data);
-	if (!dev)
+	port = rcu_dereference(skb->dev->rx_handler_data);
+	if (!port)
 		return RX_HANDLER_PASS;
 
 	if (skb->protocol == htons(ETH_P_PAE))
 		return RX_HANDLER_PASS;
 
+	dev = port->peer;
+	pc = this_cpu_ptr(port->pcpu);
+
 	skb_push(skb, ETH_HLEN);
 	skb->dev = dev;
 	skb_forward_csum(skb);
-	dev_queue_xmit(skb);
+
+	len = skb->len;
+	trelay_count(&pc->stats, rx, len);
+
+	if (!READ_ONCE(port->tr->direct)) {
+		if (dev_queue_xmit(skb) == NET_XMIT_SUCCESS)
+			trelay_count(&pc->stats, tx, len);
+		else
+			trelay_count_drop(&pc->stats);
+
+		return RX_HANDLER_CONSUMED;
+	}
+
+	if (unlikely(!netif_running(dev) || !netif_carrier_ok(dev))) {
+		kfree_skb(skb);
+		trelay_count_drop(&pc->stats);
+		return RX_HANDLER_CONSUMED;
+	}
+
+	trelay_enqueue(pc, skb);
 
 	return RX_HANDLER_CONSUMED;
 }
@@ -61,23 +299,91 @@ static int trelay_open(struct inode *inode, struct file *file)
 	return 0;
 }
 
+static void trelay_stats_read(struct trelay_stats *st, u64 *val)
+{
+	unsigned int start;
+
+	do {
+		start = u64_stats_fetch_begin(&st->syncp);
+		val[0] = u64_stats_read(&st->rx_packets);
+		val[1] = u64_stats_read(&st->rx_bytes);
+		val[2] = u64_stats_read(&st->tx_packets);
+		val[3] = u64_stats_read(&st->tx_bytes);
+		val[4] = u64_stats_read(&st->tx_dropped);
+	} while (u64_stats_fetch_retry(&st->syncp, start));
+}
+
+static int trelay_stats_show(struct seq_file *s, void *unused)
+{
+	struct trelay *tr = s->private;
+	int i, j, cpu;
+
+	seq_printf(s, "mode: %s\n", READ_ONCE(tr->direct) ? "direct" : "qdisc");
+
+	for (i = 0; i < ARRAY_SIZE(tr->port); i++) {
+		struct trelay_port *port = &tr->port[i];
+		u64 total[5] = {};
+		u64 val[5];
+
+		seq_printf(s, "\n%s -> %s\n", port->dev->name, port->peer->name);
+		seq_printf(s, "%-6s %12s %16s %12s %16s %12s\n", "cpu",
+			   "rx_packets", "rx_bytes", "tx_packets", "tx_bytes",
+			   "dropped");
+
+		for_each_possible_cpu(cpu) {
+			trelay_stats_read(&per_cpu_ptr(port->pcpu, cpu)->stats,
+					  val);
+			if (!val[0] && !val[4])
+				continue;
+
+			for (j = 0; j < ARRAY_SIZE(val); j++)
+				total[j] += val[j];
+
+			seq_printf(s, "%-6d %12llu %16llu %12llu %16llu %12llu\n",
+				   cpu, val[0], val[1], val[2], val[3], val[4]);
+		}
+
+		seq_printf(s, "%-6s %12llu %16llu %12llu %16llu %12llu\n",
+			   "total", total[0], total[1], total[2], total[3],
+			   total[4]);
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(trelay_stats);
+
+static void trelay_free(struct trelay *tr)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tr->port); i++)
+		free_percpu(tr->port[i].pcpu);
+	kfree(tr);
+}
+
 static int trelay_do_remove(struct trelay *tr)
 {
+	int cpu;
+
 	list_del(&tr->list);
 
 	/* First and before all, ensure that the debugfs file is removed
 	 * to prevent dangling pointer in file->private_data */
 	debugfs_remove_recursive(tr->debugfs);
 
-	dev_put(tr->dev1);
-	dev_put(tr->dev2);
-
 	netdev_rx_handler_unregister(tr->dev1);
 	netdev_rx_handler_unregister(tr->dev2);
 
+	/* no new frames can be queued now, wait for pending direct xmit */
+	for_each_possible_cpu(cpu)
+		napi_synchronize(&per_cpu(trelay_flush, cpu).napi);
+
+	dev_put(tr->dev1);
+	dev_put(tr->dev2);
+
 	trelay_log(KERN_INFO, tr, "stopped");
 
-	kfree(tr);
+	trelay_free(tr);
 
 	return 0;
 }
@@ -146,16 +452,44 @@ static const struct file_operations fops_remove = {
 };
 
 
-static int trelay_do_add(char *name, char *devn1, char *devn2)
+static int trelay_port_init(struct trelay *tr, struct trelay_port *port)
+{
+	int cpu;
+
+	port->tr = tr;
+	port->pcpu = alloc_percpu(struct trelay_pcpu);
+	if (!port->pcpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct trelay_pcpu *pc = per_cpu_ptr(port->pcpu, cpu);
+
+		u64_stats_init(&pc->stats.syncp);
+		INIT_LIST_HEAD(&pc->flush);
+		pc->port = port;
+	}
+
+	return 0;
+}
+
+static int trelay_do_add(char *name, char *devn1, char *devn2, bool direct)
 {
 	struct net_device *dev1, *dev2;
 	struct trelay *tr, *tr1;
-	int ret;
+	int i, ret;
 
 	tr = kzalloc(sizeof(*tr) + strlen(name) + 1, GFP_KERNEL);
 	if (!tr)
 		return -ENOMEM;
 
+	for (i = 0; i < ARRAY_SIZE(tr->port); i++) {
+		ret = trelay_port_init(tr, &tr->port[i]);
+		if (ret < 0) {
+			trelay_free(tr);
+			return ret;
+		}
+	}
+
 	rtnl_lock();
 	rcu_read_lock();
 
@@ -171,11 +505,17 @@ static int trelay_do_add(char *name, char *devn1, char *devn2)
 	if (!dev1 || !dev2)
 		goto out;
 
-	ret = netdev_rx_handler_register(dev1, trelay_handle_frame, dev2);
+	tr->port[0].dev = dev1;
+	tr->port[0].peer = dev2;
+	tr->port[1].dev = dev2;
+	tr->port[1].peer = dev1;
+	tr->direct = direct;
+
+	ret = netdev_rx_handler_register(dev1, trelay_handle_frame, &tr->port[0]);
 	if (ret < 0)
 		goto out;
 
-	ret = netdev_rx_handler_register(dev2, trelay_handle_frame, dev1);
+	ret = netdev_rx_handler_register(dev2, trelay_handle_frame, &tr->port[1]);
 	if (ret < 0) {
 		netdev_rx_handler_unregister(dev1);
 		goto out;
@@ -189,17 +529,21 @@ static int trelay_do_add(char *name, char *devn1, char *devn2)
 	tr->dev2 = dev2;
 	list_add_tail(&tr->list, &trelay_devs);
 
-	trelay_log(KERN_INFO, tr, "started");
+	trelay_log(KERN_INFO, tr, "started%s", direct ? " (direct xmit)" : "");
 
 	tr->debugfs = debugfs_create_dir(name, debugfs_dir);
 	debugfs_create_file("remove", S_IWUSR, tr->debugfs, tr, &fops_remove);
+	debugfs_create_bool("direct", S_IRUSR | S_IWUSR, tr->debugfs,
+			    &tr->direct);
+	debugfs_create_file("stats", S_IRUSR, tr->debugfs, tr,
+			    &trelay_stats_fops);
 	ret = 0;
 
 out:
 	rcu_read_unlock();
 	rtnl_unlock();
 	if (ret < 0)
-		kfree(tr);
+		trelay_free(tr);
 
 	return ret;
 }
@@ -208,7 +552,8 @@ static ssize_t trelay_add_write(struct file *file, const char __user *ubuf,
 				size_t count, loff_t *ppos)
 {
 	char buf[256];
-	char *dev1, *dev2, *tmp;
+	char *dev1, *dev2, *opt, *tmp;
+	bool direct = false;
 	ssize_t len, ret;
 
 	len = min(count, sizeof(buf) - 1);
@@ -231,13 +576,20 @@ static ssize_t trelay_add_write(struct file *file, const char __user *ubuf,
 		return -EINVAL;
 
 	*(dev2++) = 0;
-	if (strchr(dev2, ','))
-		return -EINVAL;
+
+	opt = strchr(dev2, ',');
+	if (opt) {
+		*(opt++) = 0;
+		if (strcmp(opt, "direct") != 0)
+			return -EINVAL;
+
+		direct = true;
+	}
 
 	if (!strlen(buf) || !strlen(dev1) || !strlen(dev2))
 		return -EINVAL;
 
-	ret = trelay_do_add(buf, dev1, dev2);
+	ret = trelay_do_add(buf, dev1, dev2, direct);
 	if (ret < 0)
 		return ret;
 
@@ -254,6 +606,38 @@ static struct notifier_block tr_dev_notifier = {
 	.notifier_call = tr_device_event
 };
 
+static void trelay_flush_init(void)
+{
+	int cpu;
+
+	init_dummy_netdev(&trelay_napi_dev);
+
+	for_each_possible_cpu(cpu) {
+		struct trelay_flush *fl = per_cpu_ptr(&trelay_flush, cpu);
+
+		INIT_LIST_HEAD(&fl->list);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,1,0)
+		netif_napi_add(&trelay_napi_dev, &fl->napi, trelay_flush_poll);
+#else
+		netif_napi_add(&trelay_napi_dev, &fl->napi, trelay_flush_poll,
+			       NAPI_POLL_WEIGHT);
+#endif
+		napi_enable(&fl->napi);
+	}
+}
+
+static void trelay_flush_exit(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct trelay_flush *fl = per_cpu_ptr(&trelay_flush, cpu);
+
+		napi_disable(&fl->napi);
+		netif_napi_del(&fl->napi);
+	}
+}
+
 static int __init trelay_init(void)
 {
 	int ret;
@@ -262,6 +646,8 @@ static int __init trelay_init(void)
 	if (!debugfs_dir)
 		return -ENOMEM;
 
+	trelay_flush_init();
+
 	debugfs_create_file("add", S_IWUSR, debugfs_dir, NULL, &fops_add);
 
 	ret = register_netdevice_notifier(&tr_dev_notifier);
@@ -271,6 +657,7 @@ static int __init trelay_init(void)
 	return 0;
 
 error:
+	trelay_flush_exit();
 	debugfs_remove_recursive(debugfs_dir);
 	return ret;
 }
@@ -286,6 +673,7 @@ static void __exit trelay_exit(void)
 		trelay_do_remove(tr);
 	rtnl_unlock();
 
+	trelay_flush_exit();
 	debugfs_remove_recursive(debugfs_dir);
 }
 
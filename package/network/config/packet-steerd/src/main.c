@@ -0,0 +1,858 @@
+/*
+ * packet-steerd - IRQ and topology aware packet steering
+ *
+ * Copyright (C) 2026 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Keeps the RPS, RFS and XPS settings of all network devices up to date.
+ * Received packets of a device are steered to the CPUs of the cluster that
+ * services its IRQs, leaving out the CPUs which handle network IRQs. A CPU
+ * with a much higher NET_RX softirq load than the other candidates is left
+ * out for a while. XPS maps every CPU to one TX queue.
+ *
+ * The state is refreshed every interval, and on the "update" call of the
+ * "packet_steering" ubus object, whose "status" call shows the decisions.
+ */
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <net/if.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libubox/blobmsg.h>
+#include <libubox/list.h>
+#include <libubox/ulog.h>
+#include <libubox/uloop.h>
+#include <libubox/utils.h>
+#include <libubus.h>
+
+#define MAX_CPUS		64
+#define MAX_DEV_IRQS		16
+
+/* NET_RX softirqs per second below which the load is not balanced */
+#define LOAD_MIN		2000
+/* intervals a CPU stays excluded after it was found overloaded */
+#define DROP_HOLD		6
+
+#define SYS_NET			"/sys/class/net"
+#define SYS_CPU			"/sys/devices/system/cpu"
+#define SOCK_FLOW_ENTRIES	"/proc/sys/net/core/rps_sock_flow_entries"
+
+struct steer_cpu {
+	int package;
+	uint64_t net_rx;
+	unsigned int load;
+};
+
+struct steer_irq {
+	int irq;
+	int cpu;
+	uint64_t count[MAX_CPUS];
+};
+
+struct steer_dev {
+	struct list_head list;
+
+	char name[IFNAMSIZ];
+	char bus_id[64];
+	bool rps;
+	bool seen;
+	bool applied;
+
+	struct steer_irq irqs[MAX_DEV_IRQS];
+	int n_irqs;
+	uint64_t irq_cpus;
+
+	int rx_queues;
+	int tx_queues;
+	uint64_t rps_cpus;
+	uint64_t xps_online;
+	unsigned int flow_cnt;
+
+	uint64_t drop_cpus;
+	int drop_hold;
+
+	uint64_t rx_packets;
+	unsigned int rx_rate;
+};
+
+static LIST_HEAD(devs);
+static struct steer_cpu cpus[MAX_CPUS];
+static uint64_t cpu_online;
+static uint64_t net_irq_cpus;
+static bool softirqs_valid;
+
+static unsigned int interval = 10;
+/* time since the previous update, shorter than interval after "update" */
+static uint64_t elapsed_ms;
+static unsigned int flows;
+static int sock_flow_entries = -1;
+
+static struct blob_buf b;
+static struct ubus_auto_conn conn;
+
+#define for_each_cpu(cpu, mask) \
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) \
+		if ((mask) & (1ULL << cpu))
+
+static int read_file(const char *path, char *buf, size_t len)
+{
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n < 0)
+		return -1;
+
+	buf[n] = 0;
+	while (n > 0 && isspace(buf[n - 1]))
+		buf[--n] = 0;
+
+	return 0;
+}
+
+static int write_file(const char *path, const char *val)
+{
+	int fd, ret = 0;
+
+	ULOG_DBG("%s = %s\n", path, val);
+
+	fd = open(path, O_WRONLY | O_TRUNC);
+	if (fd < 0)
+		return -1;
+
+	if (write(fd, val, strlen(val)) < 0)
+		ret = -1;
+	close(fd);
+
+	if (ret)
+		ULOG_WARN("failed to write %s: %s\n", path, strerror(errno));
+
+	return ret;
+}
+
+static uint64_t parse_cpulist(const char *str)
+{
+	uint64_t mask = 0;
+	unsigned long start, end;
+	char *next;
+
+	while (*str) {
+		start = strtoul(str, &next, 10);
+		end = start;
+		if (*next == '-')
+			end = strtoul(next + 1, &next, 10);
+		if (next == str)
+			break;
+
+		for (; start <= end && start < MAX_CPUS; start++)
+			mask |= 1ULL << start;
+
+		str = next;
+		if (*str == ',')
+			str++;
+	}
+
+	return mask;
+}
+
+/* Kernel bitmap format, in comma separated groups of 32 bits */
+static void format_mask(char *buf, size_t len, uint64_t mask)
+{
+	if (mask >> 32)
+		snprintf(buf, len, "%x,%08x", (uint32_t) (mask >> 32), (uint32_t) mask);
+	else
+		snprintf(buf, len, "%x", (uint32_t) mask);
+}
+
+static void cpus_update(void)
+{
+	char path[64], buf[32];
+	int cpu;
+
+	if (read_file(SYS_CPU "/online", buf, sizeof(buf)))
+		strcpy(buf, "0");
+
+	cpu_online = parse_cpulist(buf);
+
+	for_each_cpu(cpu, cpu_online) {
+		cpus[cpu].package = 0;
+
+		snprintf(path, sizeof(path), SYS_CPU "/cpu%d/topology/cluster_id", cpu);
+		if (read_file(path, buf, sizeof(buf))) {
+			snprintf(path, sizeof(path), SYS_CPU "/cpu%d/topology/physical_package_id", cpu);
+			if (read_file(path, buf, sizeof(buf)))
+				continue;
+		}
+
+		cpus[cpu].package = atoi(buf);
+	}
+}
+
+/*
+ * The CPU columns of /proc/interrupts and /proc/softirqs, from a header
+ * like "CPU0 CPU1 CPU3"
+ */
+static int parse_cpu_columns(char *line, int *cols)
+{
+	char *tok, *saveptr;
+	int n = 0;
+
+	for (tok = strtok_r(line, " \t\n", &saveptr); tok && n < MAX_CPUS;
+	     tok = strtok_r(NULL, " \t\n", &saveptr)) {
+		if (strncmp(tok, "CPU", 3))
+			continue;
+
+		cols[n] = atoi(tok + 3);
+		if (cols[n] < 0 || cols[n] >= MAX_CPUS)
+			cols[n] = -1;
+		n++;
+	}
+
+	return n;
+}
+
+static unsigned int rate(uint64_t delta)
+{
+	return delta * 1000 / (elapsed_ms ? elapsed_ms : 1);
+}
+
+static void softirqs_update(void)
+{
+	char *line = NULL, *tok, *saveptr;
+	int cols[MAX_CPUS], n_cols = 0, i;
+	size_t len = 0;
+	uint64_t val;
+	FILE *f;
+
+	f = fopen("/proc/softirqs", "r");
+	if (!f)
+		return;
+
+	if (getline(&line, &len, f) > 0)
+		n_cols = parse_cpu_columns(line, cols);
+
+	while (getline(&line, &len, f) > 0) {
+		tok = strtok_r(line, " \t\n", &saveptr);
+		if (!tok || strcmp(tok, "NET_RX:") != 0)
+			continue;
+
+		for (i = 0; i < n_cols; i++) {
+			tok = strtok_r(NULL, " \t\n", &saveptr);
+			if (!tok)
+				break;
+			if (cols[i] < 0)
+				continue;
+
+			val = strtoull(tok, NULL, 10);
+			cpus[cols[i]].load = softirqs_valid ?
+				rate(val - cpus[cols[i]].net_rx) : 0;
+			cpus[cols[i]].net_rx = val;
+		}
+		break;
+	}
+
+	softirqs_valid = true;
+	free(line);
+	fclose(f);
+}
+
+static struct steer_dev *dev_find(const char *name)
+{
+	struct steer_dev *dev;
+
+	list_for_each_entry(dev, &devs, list)
+		if (!strcmp(dev->name, name))
+			return dev;
+
+	return NULL;
+}
+
+static bool dev_is_virtual(const char *name)
+{
+	char path[PATH_MAX];
+	struct dirent *e;
+	bool ret = false;
+	struct stat st;
+	DIR *d;
+
+	snprintf(path, sizeof(path), SYS_NET "/%s/device", name);
+	if (stat(path, &st) || !S_ISDIR(st.st_mode))
+		return true;
+
+	/* stacked devices, e.g. VLANs on top of a real device */
+	snprintf(path, sizeof(path), SYS_NET "/%s", name);
+	d = opendir(path);
+	if (!d)
+		return true;
+
+	while ((e = readdir(d)) != NULL) {
+		if (!strncmp(e->d_name, "lower_", 6)) {
+			ret = true;
+			break;
+		}
+	}
+	closedir(d);
+
+	return ret;
+}
+
+static void dev_read_link(const char *name, const char *link, char *buf, size_t len)
+{
+	char path[PATH_MAX], target[PATH_MAX], *base;
+	ssize_t n;
+
+	*buf = 0;
+
+	snprintf(path, sizeof(path), SYS_NET "/%s/%s", name, link);
+	n = readlink(path, target, sizeof(target) - 1);
+	if (n < 0)
+		return;
+
+	target[n] = 0;
+	base = strrchr(target, '/');
+	snprintf(buf, len, "%s", base ? base + 1 : target);
+}
+
+static void dev_update(struct steer_dev *dev)
+{
+	char path[PATH_MAX], buf[32];
+	struct dirent *e;
+	uint64_t rx;
+	DIR *d;
+
+	dev_read_link(dev->name, "device", dev->bus_id, sizeof(dev->bus_id));
+
+	/* DSA user ports share the queues of the conduit device */
+	dev_read_link(dev->name, "device/subsystem", buf, sizeof(buf));
+	dev->rps = strcmp(buf, "mdio_bus") != 0;
+
+	dev->rx_queues = 0;
+	dev->tx_queues = 0;
+
+	snprintf(path, sizeof(path), SYS_NET "/%s/queues", dev->name);
+	d = opendir(path);
+	if (d) {
+		while ((e = readdir(d)) != NULL) {
+			if (!strncmp(e->d_name, "rx-", 3))
+				dev->rx_queues++;
+			else if (!strncmp(e->d_name, "tx-", 3))
+				dev->tx_queues++;
+		}
+		closedir(d);
+	}
+
+	snprintf(path, sizeof(path), SYS_NET "/%s/statistics/rx_packets", dev->name);
+	if (!read_file(path, buf, sizeof(buf))) {
+		rx = strtoull(buf, NULL, 10);
+		dev->rx_rate = dev->rx_packets ? rate(rx - dev->rx_packets) : 0;
+		dev->rx_packets = rx;
+	}
+}
+
+static void devs_update(void)
+{
+	struct steer_dev *dev, *tmp;
+	struct dirent *e;
+	DIR *d;
+
+	list_for_each_entry(dev, &devs, list)
+		dev->seen = false;
+
+	d = opendir(SYS_NET);
+	if (!d)
+		return;
+
+	while ((e = readdir(d)) != NULL) {
+		if (e->d_name[0] == '.' || strlen(e->d_name) >= IFNAMSIZ)
+			continue;
+
+		if (dev_is_virtual(e->d_name))
+			continue;
+
+		dev = dev_find(e->d_name);
+		if (!dev) {
+			dev = calloc(1, sizeof(*dev));
+			if (!dev)
+				continue;
+
+			strcpy(dev->name, e->d_name);
+			list_add_tail(&dev->list, &devs);
+			ULOG_INFO("new device %s\n", dev->name);
+		}
+
+		dev->seen = true;
+		dev_update(dev);
+	}
+	closedir(d);
+
+	list_for_each_entry_safe(dev, tmp, &devs, list) {
+		if (dev->seen)
+			continue;
+
+		list_del(&dev->list);
+		free(dev);
+	}
+}
+
+static bool irq_name_match(const char *name, const char *id)
+{
+	size_t len = strlen(id);
+
+	if (!len || strncmp(name, id, len) != 0)
+		return false;
+
+	/* e.g. "eth0", "eth0-rx-1" or "eth0," for shared IRQs */
+	return !name[len] || name[len] == '-' || name[len] == ',';
+}
+
+static void irq_update(struct steer_dev *dev, int irq, const uint64_t *count,
+		       const int *cols, int n_cols)
+{
+	uint64_t delta, best_delta = 0, best_total = 0;
+	struct steer_irq *si = NULL;
+	int i, cpu, best = -1, total_best = -1;
+
+	for (i = 0; i < dev->n_irqs; i++)
+		if (dev->irqs[i].irq == irq)
+			si = &dev->irqs[i];
+
+	if (!si) {
+		if (dev->n_irqs == MAX_DEV_IRQS)
+			return;
+
+		si = &dev->irqs[dev->n_irqs++];
+		memset(si, 0, sizeof(*si));
+		si->irq = irq;
+		si->cpu = -1;
+	}
+
+	/* The CPU which serviced most interrupts since the last update */
+	for (i = 0; i < n_cols; i++) {
+		cpu = cols[i];
+		if (cpu < 0)
+			continue;
+
+		delta = count[i] - si->count[cpu];
+		if (delta > best_delta) {
+			best_delta = delta;
+			best = cpu;
+		}
+		if (count[i] > best_total) {
+			best_total = count[i];
+			total_best = cpu;
+		}
+		si->count[cpu] = count[i];
+	}
+
+	if (best >= 0)
+		si->cpu = best;
+	else if (si->cpu < 0)
+		si->cpu = total_best;
+}
+
+static void interrupts_update(void)
+{
+	char *line = NULL, *tok, *saveptr, *end;
+	int cols[MAX_CPUS], n_cols = 0, irq, i;
+	uint64_t count[MAX_CPUS];
+	struct steer_dev *dev;
+	size_t len = 0;
+	FILE *f;
+
+	f = fopen("/proc/interrupts", "r");
+	if (!f)
+		return;
+
+	if (getline(&line, &len, f) > 0)
+		n_cols = parse_cpu_columns(line, cols);
+
+	while (getline(&line, &len, f) > 0) {
+		tok = strtok_r(line, " \t\n", &saveptr);
+		if (!tok)
+			continue;
+
+		irq = strtol(tok, &end, 10);
+		if (end == tok || *end != ':')
+			continue;
+
+		for (i = 0; i < n_cols; i++) {
+			tok = strtok_r(NULL, " \t\n", &saveptr);
+			if (!tok)
+				break;
+			count[i] = strtoull(tok, NULL, 10);
+		}
+		if (i < n_cols)
+			continue;
+
+		/* chip name, hardware IRQ, trigger type and action names */
+		while ((tok = strtok_r(NULL, " \t\n", &saveptr)) != NULL) {
+			list_for_each_entry(dev, &devs, list) {
+				if (irq_name_match(tok, dev->name) ||
+				    irq_name_match(tok, dev->bus_id))
+					irq_update(dev, irq, count, cols, n_cols);
+			}
+		}
+	}
+
+	free(line);
+	fclose(f);
+
+	net_irq_cpus = 0;
+	list_for_each_entry(dev, &devs, list) {
+		dev->irq_cpus = 0;
+		for (i = 0; i < dev->n_irqs; i++)
+			if (dev->irqs[i].cpu >= 0)
+				dev->irq_cpus |= 1ULL << dev->irqs[i].cpu;
+
+		net_irq_cpus |= dev->irq_cpus;
+	}
+}
+
+static uint64_t dev_rps_cpus(struct steer_dev *dev)
+{
+	uint64_t mask, cluster = 0, cand;
+	unsigned int load_max = 0, load_sum = 0;
+	int cpu, cpu_max = -1, n = 0, other;
+
+	if (!dev->rps || !dev->rx_queues)
+		return 0;
+
+	/* Receive side scaling already spreads the load */
+	if (dev->rx_queues > 1 && __builtin_popcountll(dev->irq_cpus) > 1)
+		return 0;
+
+	for_each_cpu(cpu, dev->irq_cpus) {
+		for_each_cpu(other, cpu_online)
+			if (cpus[other].package == cpus[cpu].package)
+				cluster |= 1ULL << other;
+	}
+	if (!cluster)
+		cluster = cpu_online;
+
+	mask = cluster & ~net_irq_cpus;
+	if (!mask)
+		mask = cpu_online & ~dev->irq_cpus;
+	if (!mask)
+		return 0;
+
+	if (dev->drop_hold) {
+		dev->drop_hold--;
+		if (mask & ~dev->drop_cpus)
+			return mask & ~dev->drop_cpus;
+	}
+
+	for_each_cpu(cpu, mask) {
+		if (cpus[cpu].load >= load_max) {
+			load_max = cpus[cpu].load;
+			cpu_max = cpu;
+		}
+		load_sum += cpus[cpu].load;
+		n++;
+	}
+
+	/* Leave out a CPU which is much busier than the others */
+	if (n > 1 && load_max > LOAD_MIN &&
+	    load_max > 2 * (load_sum - load_max) / (n - 1)) {
+		cand = mask & ~(1ULL << cpu_max);
+		ULOG_INFO("%s: leaving out cpu%d for RPS, %u NET_RX/s\n",
+			  dev->name, cpu_max, load_max);
+		dev->drop_cpus = 1ULL << cpu_max;
+		dev->drop_hold = DROP_HOLD;
+		return cand;
+	}
+
+	return mask;
+}
+
+/*
+ * Every CPU transmits on one queue. With fewer queues than CPUs every queue
+ * gets a share of the CPUs, otherwise the queues past the number of CPUs
+ * are left without any.
+ */
+static uint64_t dev_xps_cpus(struct steer_dev *dev, int queue)
+{
+	uint64_t mask = 0;
+	int cpu, i = 0;
+
+	if (dev->tx_queues <= 1)
+		return cpu_online;
+
+	for_each_cpu(cpu, cpu_online) {
+		if (i % dev->tx_queues == queue)
+			mask |= 1ULL << cpu;
+		i++;
+	}
+
+	return mask;
+}
+
+static void dev_apply(struct steer_dev *dev)
+{
+	char path[PATH_MAX], val[32];
+	unsigned int flow_cnt;
+	uint64_t rps;
+	int i;
+
+	rps = dev_rps_cpus(dev);
+	flow_cnt = rps && flows ? flows / dev->rx_queues : 0;
+
+	if (!dev->applied || rps != dev->rps_cpus || flow_cnt != dev->flow_cnt) {
+		if (dev->rps)
+			ULOG_INFO("%s: RPS cpus %llx, IRQ cpus %llx\n", dev->name,
+				  (unsigned long long) rps,
+				  (unsigned long long) dev->irq_cpus);
+
+		for (i = 0; i < dev->rx_queues && dev->rps; i++) {
+			snprintf(path, sizeof(path), SYS_NET "/%s/queues/rx-%d/rps_cpus",
+				 dev->name, i);
+			format_mask(val, sizeof(val), rps);
+			write_file(path, val);
+
+			snprintf(path, sizeof(path), SYS_NET "/%s/queues/rx-%d/rps_flow_cnt",
+				 dev->name, i);
+			snprintf(val, sizeof(val), "%u", flow_cnt);
+			write_file(path, val);
+		}
+
+		dev->rps_cpus = rps;
+		dev->flow_cnt = flow_cnt;
+	}
+
+	if (!dev->applied || dev->xps_online != cpu_online) {
+		for (i = 0; i < dev->tx_queues; i++) {
+			snprintf(path, sizeof(path), SYS_NET "/%s/queues/tx-%d/xps_cpus",
+				 dev->name, i);
+			format_mask(val, sizeof(val), dev_xps_cpus(dev, i));
+			write_file(path, val);
+		}
+
+		dev->xps_online = cpu_online;
+	}
+
+	dev->applied = true;
+}
+
+static void steer_update(void)
+{
+	static uint64_t last_ms;
+	struct steer_dev *dev;
+	struct timespec ts;
+	char val[16];
+	uint64_t now;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	elapsed_ms = now - last_ms;
+	last_ms = now;
+
+	cpus_update();
+	softirqs_update();
+	devs_update();
+	interrupts_update();
+
+	if (sock_flow_entries != (int) flows) {
+		snprintf(val, sizeof(val), "%u", flows);
+		write_file(SOCK_FLOW_ENTRIES, val);
+		sock_flow_entries = flows;
+	}
+
+	list_for_each_entry(dev, &devs, list)
+		dev_apply(dev);
+}
+
+static void steer_timer_cb(struct uloop_timeout *t)
+{
+	steer_update();
+	uloop_timeout_set(t, interval * 1000);
+}
+
+static struct uloop_timeout steer_timer = {
+	.cb = steer_timer_cb,
+};
+
+static void blobmsg_add_cpus(struct blob_buf *buf, const char *name, uint64_t mask)
+{
+	void *c;
+	int cpu;
+
+	c = blobmsg_open_array(buf, name);
+	for_each_cpu(cpu, mask)
+		blobmsg_add_u32(buf, NULL, cpu);
+	blobmsg_close_array(buf, c);
+}
+
+static int
+steer_status(struct ubus_context *ctx, struct ubus_object *obj,
+	     struct ubus_request_data *req, const char *method,
+	     struct blob_attr *msg)
+{
+	struct steer_dev *dev;
+	void *c, *d, *q;
+	int cpu, i;
+
+	blob_buf_init(&b, 0);
+
+	blobmsg_add_u32(&b, "interval", interval);
+	blobmsg_add_u32(&b, "flows", flows);
+
+	c = blobmsg_open_table(&b, "cpus");
+	for_each_cpu(cpu, cpu_online) {
+		char name[8];
+
+		snprintf(name, sizeof(name), "cpu%d", cpu);
+		d = blobmsg_open_table(&b, name);
+		blobmsg_add_u32(&b, "package", cpus[cpu].package);
+		blobmsg_add_u32(&b, "net_rx", cpus[cpu].load);
+		blobmsg_add_u8(&b, "net_irq", !!(net_irq_cpus & (1ULL << cpu)));
+		blobmsg_close_table(&b, d);
+	}
+	blobmsg_close_table(&b, c);
+
+	c = blobmsg_open_table(&b, "devices");
+	list_for_each_entry(dev, &devs, list) {
+		d = blobmsg_open_table(&b, dev->name);
+		blobmsg_add_string(&b, "device", dev->bus_id);
+		blobmsg_add_u32(&b, "rx_pps", dev->rx_rate);
+
+		q = blobmsg_open_array(&b, "irqs");
+		for (i = 0; i < dev->n_irqs; i++)
+			blobmsg_add_u32(&b, NULL, dev->irqs[i].irq);
+		blobmsg_close_array(&b, q);
+		blobmsg_add_cpus(&b, "irq_cpus", dev->irq_cpus);
+
+		blobmsg_add_u32(&b, "rx_queues", dev->rx_queues);
+		if (dev->rps) {
+			blobmsg_add_cpus(&b, "rps_cpus", dev->rps_cpus);
+			blobmsg_add_u32(&b, "rps_flow_cnt", dev->flow_cnt);
+			if (dev->drop_hold)
+				blobmsg_add_cpus(&b, "rps_dropped", dev->drop_cpus);
+		}
+
+		blobmsg_add_u32(&b, "tx_queues", dev->tx_queues);
+		q = blobmsg_open_array(&b, "xps_cpus");
+		for (i = 0; i < dev->tx_queues; i++)
+			blobmsg_add_cpus(&b, NULL, dev_xps_cpus(dev, i));
+		blobmsg_close_array(&b, q);
+
+		blobmsg_close_table(&b, d);
+	}
+	blobmsg_close_table(&b, c);
+
+	ubus_send_reply(ctx, req, b.head);
+
+	return 0;
+}
+
+static int
+steer_update_cb(struct ubus_context *ctx, struct ubus_object *obj,
+		struct ubus_request_data *req, const char *method,
+		struct blob_attr *msg)
+{
+	struct steer_dev *dev;
+
+	/* packet-steering.sh may have overwritten the settings */
+	list_for_each_entry(dev, &devs, list)
+		dev->applied = false;
+	sock_flow_entries = -1;
+
+	steer_timer_cb(&steer_timer);
+
+	return 0;
+}
+
+static const struct ubus_method steer_methods[] = {
+	UBUS_METHOD_NOARG("status", steer_status),
+	UBUS_METHOD_NOARG("update", steer_update_cb),
+};
+
+static struct ubus_object_type steer_object_type =
+	UBUS_OBJECT_TYPE("packet_steering", steer_methods);
+
+static struct ubus_object steer_object = {
+	.name = "packet_steering",
+	.type = &steer_object_type,
+	.methods = steer_methods,
+	.n_methods = ARRAY_SIZE(steer_methods),
+};
+
+static void ubus_connect_handler(struct ubus_context *ctx)
+{
+	if (ubus_add_object(ctx, &steer_object))
+		ULOG_ERR("failed to add ubus object\n");
+}
+
+static int usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [options]\n"
+		"Options:\n"
+		" -i <seconds>:	Update interval (default: %u)\n"
+		" -f <entries>:	RFS flow entries, 0 disables RFS (default: 0)\n"
+		" -s <path>:	Path to the ubus socket\n"
+		" -d:		Log every setting that is written\n"
+		"\n", prog, interval);
+
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	int ch, log_level = LOG_INFO;
+
+	while ((ch = getopt(argc, argv, "i:f:s:d")) != -1) {
+		switch (ch) {
+		case 'i':
+			interval = strtoul(optarg, NULL, 0);
+			if (!interval)
+				interval = 1;
+			break;
+		case 'f':
+			flows = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			conn.path = optarg;
+			break;
+		case 'd':
+			log_level = LOG_DEBUG;
+			break;
+		default:
+			return usage(argv[0]);
+		}
+	}
+
+	ulog_open(ULOG_SYSLOG | ULOG_STDIO, LOG_DAEMON, "packet-steerd");
+	ulog_threshold(log_level);
+
+	uloop_init();
+
+	conn.cb = ubus_connect_handler;
+	ubus_auto_connect(&conn);
+
+	steer_timer_cb(&steer_timer);
+	uloop_run();
+
+	ubus_auto_shutdown(&conn);
+	uloop_done();
+
+	return 0;
+}
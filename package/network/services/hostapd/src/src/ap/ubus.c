@@ -44,6 +44,48 @@ struct ubus_banned_client {
 	u8 addr[ETH_ALEN];
 };
 
+#define HOSTAPD_UBUS_VERDICT_MAX		4096
+#define HOSTAPD_UBUS_VERDICT_TTL		10000
+#define HOSTAPD_UBUS_VERDICT_GC_INTERVAL	10
+#define HOSTAPD_UBUS_VERDICT_REQ_MAX		64
+#define HOSTAPD_UBUS_VERDICT_REQ_TIMEOUT	1
+
+struct ubus_verdict {
+	struct avl_node avl;
+	u8 addr[ETH_ALEN];
+	struct os_reltime expire;
+	int status;
+};
+
+struct ubus_verdict_req {
+	struct ubus_notify_request nreq;
+	struct list_head list;
+	struct hostapd_data *hapd;
+	u8 addr[ETH_ALEN];
+	int resp;
+};
+
+#define HOSTAPD_UBUS_PROBE_BATCH_MAX	256
+
+#define HOSTAPD_UBUS_CLIENTS_REMOVED_MAX	256
+
+struct ubus_client_gen {
+	struct avl_node avl;
+	u8 addr[ETH_ALEN];
+	u32 gen;
+	u32 flags;
+	bool removed;
+};
+
+struct ubus_probe_entry {
+	struct avl_node avl;
+	u8 addr[ETH_ALEN];
+	u8 target[ETH_ALEN];
+	int signal;
+	int freq;
+	unsigned int count;
+};
+
 static void ubus_receive(int sock, void *eloop_ctx, void *sock_ctx)
 {
 	struct ubus_context *ctx = eloop_ctx;
@@ -159,6 +201,16 @@ static void hostapd_send_shared_event(struct ubus_object *obj, char *bssname, ch
 	hostapd_notify_ubus(obj, bssname, event);
 }
 
+static void
+blobmsg_add_macaddr(struct blob_buf *buf, const char *name, const u8 *addr)
+{
+	char *s;
+
+	s = blobmsg_alloc_string_buffer(buf, name, 20);
+	sprintf(s, MACSTR, MAC2STR(addr));
+	blobmsg_add_string_buffer(buf);
+}
+
 static void
 hostapd_bss_del_ban(void *eloop_data, void *user_ctx)
 {
@@ -197,6 +249,326 @@ hostapd_bss_ban_client(struct hostapd_data *hapd, u8 *addr, int time)
 	eloop_register_timeout(0, time * 1000, hostapd_bss_del_ban, ban, hapd);
 }
 
+static void
+hostapd_bss_verdict_del(struct hostapd_data *hapd, struct ubus_verdict *v)
+{
+	avl_delete(&hapd->ubus.verdicts, &v->avl);
+	hapd->ubus.verdict_count--;
+	free(v);
+}
+
+static void
+hostapd_bss_verdict_gc(void *eloop_data, void *user_ctx)
+{
+	struct hostapd_data *hapd = eloop_data;
+	struct ubus_verdict *v, *tmp;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	avl_for_each_element_safe(&hapd->ubus.verdicts, v, avl, tmp)
+		if (os_reltime_before(&v->expire, &now))
+			hostapd_bss_verdict_del(hapd, v);
+
+	if (hapd->ubus.verdict_count)
+		eloop_register_timeout(HOSTAPD_UBUS_VERDICT_GC_INTERVAL, 0,
+				       hostapd_bss_verdict_gc, hapd, NULL);
+}
+
+static void
+hostapd_bss_verdict_set(struct hostapd_data *hapd, const u8 *addr, int status,
+			int ttl)
+{
+	struct ubus_verdict *v;
+
+	v = avl_find_element(&hapd->ubus.verdicts, addr, v, avl);
+	if (ttl <= 0) {
+		if (v)
+			hostapd_bss_verdict_del(hapd, v);
+		return;
+	}
+
+	if (!v) {
+		if (hapd->ubus.verdict_count >= HOSTAPD_UBUS_VERDICT_MAX)
+			return;
+
+		v = os_zalloc(sizeof(*v));
+		if (!v)
+			return;
+
+		memcpy(v->addr, addr, sizeof(v->addr));
+		v->avl.key = v->addr;
+		avl_insert(&hapd->ubus.verdicts, &v->avl);
+		hapd->ubus.verdict_count++;
+	}
+
+	v->status = status;
+	os_get_reltime(&v->expire);
+	v->expire.sec += ttl / 1000;
+	v->expire.usec += (ttl % 1000) * 1000;
+	if (v->expire.usec >= 1000000) {
+		v->expire.sec++;
+		v->expire.usec -= 1000000;
+	}
+
+	if (!eloop_is_timeout_registered(hostapd_bss_verdict_gc, hapd, NULL))
+		eloop_register_timeout(HOSTAPD_UBUS_VERDICT_GC_INTERVAL, 0,
+				       hostapd_bss_verdict_gc, hapd, NULL);
+}
+
+static bool
+hostapd_bss_verdict_get(struct hostapd_data *hapd, const u8 *addr, int *status)
+{
+	struct ubus_verdict *v;
+	struct os_reltime now;
+
+	v = avl_find_element(&hapd->ubus.verdicts, addr, v, avl);
+	if (!v)
+		return false;
+
+	os_get_reltime(&now);
+	if (os_reltime_before(&v->expire, &now)) {
+		hostapd_bss_verdict_del(hapd, v);
+		return false;
+	}
+
+	*status = v->status;
+	return true;
+}
+
+static void hostapd_bss_verdict_req_timeout(void *eloop_data, void *user_ctx);
+
+static void
+hostapd_bss_verdict_req_free(struct ubus_verdict_req *vreq)
+{
+	eloop_cancel_timeout(hostapd_bss_verdict_req_timeout, vreq, NULL);
+	list_del(&vreq->list);
+	vreq->hapd->ubus.verdict_reqs_pending--;
+	free(vreq);
+}
+
+static void
+hostapd_bss_verdict_req_timeout(void *eloop_data, void *user_ctx)
+{
+	struct ubus_verdict_req *vreq = eloop_data;
+
+	/* a verdict arriving after this is dropped by ubus */
+	vreq->hapd->ubus.verdict_stats.timeouts++;
+	ubus_abort_request(ctx, &vreq->nreq.req);
+	hostapd_bss_verdict_req_free(vreq);
+}
+
+static void
+hostapd_bss_verdict_req_status_cb(struct ubus_notify_request *req, int idx, int ret)
+{
+	struct ubus_verdict_req *vreq = container_of(req, struct ubus_verdict_req, nreq);
+
+	if (ret)
+		vreq->resp = ret;
+}
+
+static void
+hostapd_bss_verdict_req_complete_cb(struct ubus_notify_request *req, int idx, int ret)
+{
+	struct ubus_verdict_req *vreq = container_of(req, struct ubus_verdict_req, nreq);
+	struct hostapd_data *hapd = vreq->hapd;
+
+	hapd->ubus.verdict_stats.responses++;
+	hostapd_bss_verdict_set(hapd, vreq->addr, vreq->resp, hapd->ubus.verdict_ttl);
+	hostapd_bss_verdict_req_free(vreq);
+}
+
+static void
+hostapd_bss_probe_batch_flush(void *eloop_data, void *user_ctx)
+{
+	struct hostapd_data *hapd = eloop_data;
+	struct ubus_probe_entry *p, *tmp;
+	void *list, *c;
+
+	eloop_cancel_timeout(hostapd_bss_probe_batch_flush, hapd, NULL);
+	if (!hapd->ubus.probe_batch_count)
+		return;
+
+	blob_buf_init(&b, 0);
+	list = blobmsg_open_array(&b, "probes");
+	avl_for_each_element_safe(&hapd->ubus.probe_batch, p, avl, tmp) {
+		c = blobmsg_open_table(&b, NULL);
+		blobmsg_add_macaddr(&b, "address", p->addr);
+		blobmsg_add_macaddr(&b, "target", p->target);
+		if (p->signal)
+			blobmsg_add_u32(&b, "signal", p->signal);
+		blobmsg_add_u32(&b, "freq", p->freq);
+		blobmsg_add_u32(&b, "count", p->count);
+		blobmsg_close_table(&b, c);
+
+		avl_delete(&hapd->ubus.probe_batch, &p->avl);
+		free(p);
+	}
+	blobmsg_close_array(&b, list);
+	hapd->ubus.probe_batch_count = 0;
+	hapd->ubus.probe_stats.flushes++;
+
+	if (ctx && hapd->ubus.obj.has_subscribers)
+		ubus_notify(ctx, &hapd->ubus.obj, "probe-batch", b.head, -1);
+}
+
+static void
+hostapd_bss_probe_batch_add(struct hostapd_data *hapd,
+			    struct hostapd_ubus_request *req, const u8 *addr)
+{
+	struct ubus_probe_entry *p;
+
+	p = avl_find_element(&hapd->ubus.probe_batch, addr, p, avl);
+	if (p) {
+		hapd->ubus.probe_stats.coalesced++;
+	} else {
+		p = os_zalloc(sizeof(*p));
+		if (!p)
+			return;
+
+		memcpy(p->addr, addr, sizeof(p->addr));
+		p->avl.key = p->addr;
+		avl_insert(&hapd->ubus.probe_batch, &p->avl);
+		hapd->ubus.probe_batch_count++;
+	}
+
+	if (req->mgmt_frame)
+		memcpy(p->target, req->mgmt_frame->da, ETH_ALEN);
+	if (req->ssi_signal)
+		p->signal = req->ssi_signal;
+	p->freq = hapd->iface->freq;
+	p->count++;
+
+	if (hapd->ubus.probe_batch_count >= HOSTAPD_UBUS_PROBE_BATCH_MAX)
+		hostapd_bss_probe_batch_flush(hapd, NULL);
+	else if (!eloop_is_timeout_registered(hostapd_bss_probe_batch_flush, hapd, NULL))
+		eloop_register_timeout(0, hapd->ubus.probe_batch_interval * 1000,
+				       hostapd_bss_probe_batch_flush, hapd, NULL);
+}
+
+/* token bucket in 1/1000 tokens, refilled at probe_rate tokens per second */
+static bool
+hostapd_bss_probe_ratelimit(struct hostapd_data *hapd)
+{
+	struct hostapd_ubus_bss *ubus = &hapd->ubus;
+	unsigned int max = ubus->probe_burst * 1000;
+	struct os_reltime now, age;
+	u64 refill;
+
+	if (!ubus->probe_rate)
+		return false;
+
+	os_get_reltime(&now);
+	os_reltime_sub(&now, &ubus->probe_tokens_update, &age);
+	ubus->probe_tokens_update = now;
+
+	refill = (u64) age.sec * 1000 + age.usec / 1000;
+	refill *= ubus->probe_rate;
+	if (refill > max - ubus->probe_tokens)
+		ubus->probe_tokens = max;
+	else
+		ubus->probe_tokens += refill;
+
+	if (ubus->probe_tokens < 1000) {
+		ubus->probe_stats.dropped++;
+		return true;
+	}
+
+	ubus->probe_tokens -= 1000;
+	return false;
+}
+
+static void
+hostapd_bss_verdict_flush(struct hostapd_data *hapd)
+{
+	struct ubus_verdict_req *vreq, *vtmp;
+	struct ubus_verdict *v, *tmp;
+
+	list_for_each_entry_safe(vreq, vtmp, &hapd->ubus.verdict_reqs, list) {
+		ubus_abort_request(ctx, &vreq->nreq.req);
+		hostapd_bss_verdict_req_free(vreq);
+	}
+
+	eloop_cancel_timeout(hostapd_bss_verdict_gc, hapd, NULL);
+	avl_for_each_element_safe(&hapd->ubus.verdicts, v, avl, tmp)
+		hostapd_bss_verdict_del(hapd, v);
+}
+
+static void
+hostapd_bss_client_changed(struct hostapd_data *hapd, const u8 *addr)
+{
+	struct ubus_client_gen *c;
+
+	if (!hapd->ubus.clients.comp)
+		return;
+
+	c = avl_find_element(&hapd->ubus.clients, addr, c, avl);
+	if (c)
+		c->gen = ++hapd->ubus.client_gen;
+}
+
+static void
+hostapd_bss_clients_prune(struct hostapd_data *hapd)
+{
+	struct ubus_client_gen *c, *tmp;
+
+	avl_for_each_element_safe(&hapd->ubus.clients, c, avl, tmp) {
+		if (!c->removed)
+			continue;
+
+		avl_delete(&hapd->ubus.clients, &c->avl);
+		free(c);
+	}
+
+	hapd->ubus.clients_removed = 0;
+	hapd->ubus.client_gen_min = hapd->ubus.client_gen;
+}
+
+/*
+ * Bring the per-client generation table in sync with the station list.
+ * Walking sta_list is cheap compared to building the reply, and catches
+ * additions, removals and flag changes not covered by the ubus hooks.
+ */
+static void
+hostapd_bss_clients_sync(struct hostapd_data *hapd)
+{
+	struct hostapd_ubus_bss *ubus = &hapd->ubus;
+	struct ubus_client_gen *c;
+	struct sta_info *sta;
+
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		c = avl_find_element(&ubus->clients, sta->addr, c, avl);
+		if (!c) {
+			c = os_zalloc(sizeof(*c));
+			if (!c)
+				continue;
+
+			memcpy(c->addr, sta->addr, sizeof(c->addr));
+			c->avl.key = c->addr;
+			avl_insert(&ubus->clients, &c->avl);
+		} else if (!c->removed && c->flags == sta->flags) {
+			continue;
+		} else if (c->removed) {
+			ubus->clients_removed--;
+		}
+
+		c->flags = sta->flags;
+		c->removed = false;
+		c->gen = ++ubus->client_gen;
+	}
+
+	avl_for_each_element(&ubus->clients, c, avl) {
+		if (c->removed || ap_get_sta(hapd, c->addr))
+			continue;
+
+		c->removed = true;
+		c->gen = ++ubus->client_gen;
+		ubus->clients_removed++;
+	}
+
+	if (ubus->clients_removed > HOSTAPD_UBUS_CLIENTS_REMOVED_MAX)
+		hostapd_bss_clients_prune(hapd);
+}
+
 static int
 hostapd_bss_reload(struct ubus_context *ctx, struct ubus_object *obj,
 		   struct ubus_request_data *req, const char *method,
@@ -278,16 +650,14 @@ hostapd_parse_capab_blobmsg(struct sta_info *sta)
 	blobmsg_close_table(&b, v);
 }
 
-static int
-hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
-			struct ubus_request_data *req, const char *method,
-			struct blob_attr *msg)
+static void
+hostapd_bss_add_client(struct hostapd_data *hapd, struct sta_info *sta,
+		       bool driver_stats)
 {
-	struct hostapd_data *hapd = container_of(obj, struct hostapd_data, ubus.obj);
 	struct hostap_sta_driver_data sta_driver_data;
-	struct sta_info *sta;
-	void *list, *c;
+	void *c, *r;
 	char mac_buf[20];
+	int i;
 	static const struct {
 		const char *name;
 		uint32_t flag;
@@ -305,71 +675,151 @@ hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 		{ "mfp", WLAN_STA_MFP },
 	};
 
-	blob_buf_init(&b, 0);
-	blobmsg_add_u32(&b, "freq", hapd->iface->freq);
-	list = blobmsg_open_table(&b, "clients");
-	for (sta = hapd->sta_list; sta; sta = sta->next) {
-		void *r;
-		int i;
-
-		sprintf(mac_buf, MACSTR, MAC2STR(sta->addr));
-		c = blobmsg_open_table(&b, mac_buf);
-		for (i = 0; i < ARRAY_SIZE(sta_flags); i++)
-			blobmsg_add_u8(&b, sta_flags[i].name,
-				       !!(sta->flags & sta_flags[i].flag));
+	sprintf(mac_buf, MACSTR, MAC2STR(sta->addr));
+	c = blobmsg_open_table(&b, mac_buf);
+	for (i = 0; i < ARRAY_SIZE(sta_flags); i++)
+		blobmsg_add_u8(&b, sta_flags[i].name,
+			       !!(sta->flags & sta_flags[i].flag));
 
 #ifdef CONFIG_MBO
-		blobmsg_add_u8(&b, "mbo", !!(sta->cell_capa));
+	blobmsg_add_u8(&b, "mbo", !!(sta->cell_capa));
 #endif
 
-		r = blobmsg_open_array(&b, "rrm");
-		for (i = 0; i < ARRAY_SIZE(sta->rrm_enabled_capa); i++)
-			blobmsg_add_u32(&b, "", sta->rrm_enabled_capa[i]);
-		blobmsg_close_array(&b, r);
+	r = blobmsg_open_array(&b, "rrm");
+	for (i = 0; i < ARRAY_SIZE(sta->rrm_enabled_capa); i++)
+		blobmsg_add_u32(&b, "", sta->rrm_enabled_capa[i]);
+	blobmsg_close_array(&b, r);
 
-		r = blobmsg_open_array(&b, "extended_capabilities");
-		/* Check if client advertises extended capabilities */
-		if (sta->ext_capability && sta->ext_capability[0] > 0) {
-			for (i = 0; i < sta->ext_capability[0]; i++) {
-				blobmsg_add_u32(&b, "", sta->ext_capability[1 + i]);
-			}
+	r = blobmsg_open_array(&b, "extended_capabilities");
+	/* Check if client advertises extended capabilities */
+	if (sta->ext_capability && sta->ext_capability[0] > 0) {
+		for (i = 0; i < sta->ext_capability[0]; i++) {
+			blobmsg_add_u32(&b, "", sta->ext_capability[1 + i]);
 		}
-		blobmsg_close_array(&b, r);
+	}
+	blobmsg_close_array(&b, r);
 
-		blobmsg_add_u32(&b, "aid", sta->aid);
+	blobmsg_add_u32(&b, "aid", sta->aid);
 #ifdef CONFIG_TAXONOMY
-		r = blobmsg_alloc_string_buffer(&b, "signature", 1024);
-		if (retrieve_sta_taxonomy(hapd, sta, r, 1024) > 0)
-			blobmsg_add_string_buffer(&b);
+	r = blobmsg_alloc_string_buffer(&b, "signature", 1024);
+	if (retrieve_sta_taxonomy(hapd, sta, r, 1024) > 0)
+		blobmsg_add_string_buffer(&b);
 #endif
 
-		/* Driver information */
-		if (hostapd_drv_read_sta_data(hapd, &sta_driver_data, sta->addr) >= 0) {
-			r = blobmsg_open_table(&b, "bytes");
-			blobmsg_add_u64(&b, "rx", sta_driver_data.rx_bytes);
-			blobmsg_add_u64(&b, "tx", sta_driver_data.tx_bytes);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "airtime");
-			blobmsg_add_u64(&b, "rx", sta_driver_data.rx_airtime);
-			blobmsg_add_u64(&b, "tx", sta_driver_data.tx_airtime);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "packets");
-			blobmsg_add_u32(&b, "rx", sta_driver_data.rx_packets);
-			blobmsg_add_u32(&b, "tx", sta_driver_data.tx_packets);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "rate");
-			/* Rate in kbits */
-			blobmsg_add_u32(&b, "rx", sta_driver_data.current_rx_rate * 100);
-			blobmsg_add_u32(&b, "tx", sta_driver_data.current_tx_rate * 100);
-			blobmsg_close_table(&b, r);
-			blobmsg_add_u32(&b, "signal", sta_driver_data.signal);
+	/* Driver information */
+	if (driver_stats &&
+	    hostapd_drv_read_sta_data(hapd, &sta_driver_data, sta->addr) >= 0) {
+		r = blobmsg_open_table(&b, "bytes");
+		blobmsg_add_u64(&b, "rx", sta_driver_data.rx_bytes);
+		blobmsg_add_u64(&b, "tx", sta_driver_data.tx_bytes);
+		blobmsg_close_table(&b, r);
+		r = blobmsg_open_table(&b, "airtime");
+		blobmsg_add_u64(&b, "rx", sta_driver_data.rx_airtime);
+		blobmsg_add_u64(&b, "tx", sta_driver_data.tx_airtime);
+		blobmsg_close_table(&b, r);
+		r = blobmsg_open_table(&b, "packets");
+		blobmsg_add_u32(&b, "rx", sta_driver_data.rx_packets);
+		blobmsg_add_u32(&b, "tx", sta_driver_data.tx_packets);
+		blobmsg_close_table(&b, r);
+		r = blobmsg_open_table(&b, "rate");
+		/* Rate in kbits */
+		blobmsg_add_u32(&b, "rx", sta_driver_data.current_rx_rate * 100);
+		blobmsg_add_u32(&b, "tx", sta_driver_data.current_tx_rate * 100);
+		blobmsg_close_table(&b, r);
+		blobmsg_add_u32(&b, "signal", sta_driver_data.signal);
+	}
+
+	hostapd_parse_capab_blobmsg(sta);
+
+	blobmsg_close_table(&b, c);
+}
+
+enum {
+	GET_CLIENTS_SINCE,
+	GET_CLIENTS_OFFSET,
+	GET_CLIENTS_LIMIT,
+	GET_CLIENTS_DRIVER_STATS,
+	__GET_CLIENTS_MAX
+};
+
+static const struct blobmsg_policy get_clients_policy[__GET_CLIENTS_MAX] = {
+	[GET_CLIENTS_SINCE] = { "since_generation", BLOBMSG_TYPE_INT32 },
+	[GET_CLIENTS_OFFSET] = { "offset", BLOBMSG_TYPE_INT32 },
+	[GET_CLIENTS_LIMIT] = { "limit", BLOBMSG_TYPE_INT32 },
+	[GET_CLIENTS_DRIVER_STATS] = { "driver_stats", BLOBMSG_TYPE_BOOL },
+};
+
+static int
+hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
+			struct ubus_request_data *req, const char *method,
+			struct blob_attr *msg)
+{
+	struct hostapd_data *hapd = container_of(obj, struct hostapd_data, ubus.obj);
+	struct blob_attr *tb[__GET_CLIENTS_MAX];
+	struct ubus_client_gen *c;
+	struct sta_info *sta;
+	bool driver_stats = true;
+	bool full = true;
+	u32 since = 0;
+	u32 offset = 0, limit = 0, idx = 0, count = 0;
+	void *list;
+
+	blobmsg_parse(get_clients_policy, __GET_CLIENTS_MAX, tb, blob_data(msg), blob_len(msg));
+
+	if (tb[GET_CLIENTS_SINCE]) {
+		since = blobmsg_get_u32(tb[GET_CLIENTS_SINCE]);
+		full = since < hapd->ubus.client_gen_min ||
+		       since > hapd->ubus.client_gen;
+	}
+
+	if (tb[GET_CLIENTS_OFFSET])
+		offset = blobmsg_get_u32(tb[GET_CLIENTS_OFFSET]);
+
+	if (tb[GET_CLIENTS_LIMIT])
+		limit = blobmsg_get_u32(tb[GET_CLIENTS_LIMIT]);
+
+	if (tb[GET_CLIENTS_DRIVER_STATS])
+		driver_stats = blobmsg_get_bool(tb[GET_CLIENTS_DRIVER_STATS]);
+
+	hostapd_bss_clients_sync(hapd);
+
+	blob_buf_init(&b, 0);
+	blobmsg_add_u32(&b, "freq", hapd->iface->freq);
+	blobmsg_add_u32(&b, "generation", hapd->ubus.client_gen);
+	blobmsg_add_u8(&b, "full", full);
+	list = blobmsg_open_table(&b, "clients");
+	avl_for_each_element(&hapd->ubus.clients, c, avl) {
+		if (c->removed || (!full && c->gen <= since))
+			continue;
+
+		if (idx++ < offset)
+			continue;
+
+		if (limit && count == limit) {
+			count++;
+			break;
 		}
 
-		hostapd_parse_capab_blobmsg(sta);
+		sta = ap_get_sta(hapd, c->addr);
+		if (!sta)
+			continue;
 
-		blobmsg_close_table(&b, c);
+		hostapd_bss_add_client(hapd, sta, driver_stats);
+		count++;
 	}
-	blobmsg_close_array(&b, list);
+	blobmsg_close_table(&b, list);
+
+	if (limit && count > limit)
+		blobmsg_add_u32(&b, "next_offset", offset + limit);
+
+	if (!full) {
+		list = blobmsg_open_array(&b, "removed");
+		avl_for_each_element(&hapd->ubus.clients, c, avl)
+			if (c->removed && c->gen > since)
+				blobmsg_add_macaddr(&b, NULL, c->addr);
+		blobmsg_close_array(&b, list);
+	}
+
 	ubus_send_reply(ctx, req, b.head);
 
 	return 0;
@@ -396,7 +846,8 @@ hostapd_bss_get_status(struct ubus_context *ctx, struct ubus_object *obj,
 		       struct blob_attr *msg)
 {
 	struct hostapd_data *hapd = container_of(obj, struct hostapd_data, ubus.obj);
-	void *airtime_table, *dfs_table, *rrm_table, *wnm_table;
+	void *airtime_table, *dfs_table, *rrm_table, *wnm_table, *verdict_table;
+	void *probe_table;
 	struct os_reltime now;
 	char ssid[SSID_MAX_LEN + 1];
 	char phy_name[17];
@@ -445,6 +896,27 @@ hostapd_bss_get_status(struct ubus_context *ctx, struct ubus_object *obj,
 	blobmsg_add_u64(&b, "bss_transition_response_rx", hapd->openwrt_stats.wnm.bss_transition_response_rx);
 	blobmsg_close_table(&b, wnm_table);
 
+	/* Verdict cache */
+	verdict_table = blobmsg_open_table(&b, "verdict_cache");
+	blobmsg_add_u8(&b, "async", hapd->ubus.notify_async);
+	blobmsg_add_u32(&b, "entries", hapd->ubus.verdict_count);
+	blobmsg_add_u64(&b, "hits", hapd->ubus.verdict_stats.hits);
+	blobmsg_add_u64(&b, "misses", hapd->ubus.verdict_stats.misses);
+	blobmsg_add_u64(&b, "responses", hapd->ubus.verdict_stats.responses);
+	blobmsg_add_u64(&b, "timeouts", hapd->ubus.verdict_stats.timeouts);
+	blobmsg_close_table(&b, verdict_table);
+
+	/* Probe notifications */
+	probe_table = blobmsg_open_table(&b, "probe_notify");
+	blobmsg_add_u32(&b, "batch_interval", hapd->ubus.probe_batch_interval);
+	blobmsg_add_u32(&b, "rate", hapd->ubus.probe_rate);
+	blobmsg_add_u32(&b, "burst", hapd->ubus.probe_burst);
+	blobmsg_add_u64(&b, "events", hapd->ubus.probe_stats.events);
+	blobmsg_add_u64(&b, "coalesced", hapd->ubus.probe_stats.coalesced);
+	blobmsg_add_u64(&b, "dropped", hapd->ubus.probe_stats.dropped);
+	blobmsg_add_u64(&b, "flushes", hapd->ubus.probe_stats.flushes);
+	blobmsg_close_table(&b, probe_table);
+
 	/* Airtime */
 	airtime_table = blobmsg_open_table(&b, "airtime");
 	blobmsg_add_u64(&b, "time", hapd->iface->last_channel_time);
@@ -468,11 +940,17 @@ hostapd_bss_get_status(struct ubus_context *ctx, struct ubus_object *obj,
 
 enum {
 	NOTIFY_RESPONSE,
+	NOTIFY_ASYNC,
+	NOTIFY_DEFAULT_STATUS,
+	NOTIFY_VERDICT_TTL,
 	__NOTIFY_MAX
 };
 
 static const struct blobmsg_policy notify_policy[__NOTIFY_MAX] = {
 	[NOTIFY_RESPONSE] = { "notify_response", BLOBMSG_TYPE_INT32 },
+	[NOTIFY_ASYNC] = { "async", BLOBMSG_TYPE_BOOL },
+	[NOTIFY_DEFAULT_STATUS] = { "default_status", BLOBMSG_TYPE_INT32 },
+	[NOTIFY_VERDICT_TTL] = { "verdict_ttl", BLOBMSG_TYPE_INT32 },
 };
 
 static int
@@ -493,10 +971,63 @@ hostapd_notify_response(struct ubus_context *ctx, struct ubus_object *obj,
 		return UBUS_STATUS_INVALID_ARGUMENT;
 
 	hapd->ubus.notify_response = blobmsg_get_u32(tb[NOTIFY_RESPONSE]);
+	hapd->ubus.notify_async = tb[NOTIFY_ASYNC] && blobmsg_get_bool(tb[NOTIFY_ASYNC]);
+
+	if (tb[NOTIFY_DEFAULT_STATUS])
+		hapd->ubus.verdict_default = blobmsg_get_u32(tb[NOTIFY_DEFAULT_STATUS]);
+
+	if (tb[NOTIFY_VERDICT_TTL])
+		hapd->ubus.verdict_ttl = blobmsg_get_u32(tb[NOTIFY_VERDICT_TTL]);
+
+	if (!hapd->ubus.notify_response || !hapd->ubus.notify_async)
+		hostapd_bss_verdict_flush(hapd);
 
 	return UBUS_STATUS_OK;
 }
 
+enum {
+	VERDICT_ADDR,
+	VERDICT_STATUS,
+	VERDICT_TTL,
+	__VERDICT_MAX
+};
+
+static const struct blobmsg_policy verdict_policy[__VERDICT_MAX] = {
+	[VERDICT_ADDR] = { "addr", BLOBMSG_TYPE_STRING },
+	[VERDICT_STATUS] = { "status", BLOBMSG_TYPE_INT32 },
+	[VERDICT_TTL] = { "ttl", BLOBMSG_TYPE_INT32 },
+};
+
+static int
+hostapd_bss_set_verdict(struct ubus_context *ctx, struct ubus_object *obj,
+			struct ubus_request_data *req, const char *method,
+			struct blob_attr *msg)
+{
+	struct blob_attr *tb[__VERDICT_MAX];
+	struct hostapd_data *hapd = get_hapd_from_object(obj);
+	int status = WLAN_STATUS_SUCCESS;
+	int ttl = hapd->ubus.verdict_ttl;
+	u8 addr[ETH_ALEN];
+
+	blobmsg_parse(verdict_policy, __VERDICT_MAX, tb, blob_data(msg), blob_len(msg));
+
+	if (!tb[VERDICT_ADDR])
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	if (hwaddr_aton(blobmsg_data(tb[VERDICT_ADDR]), addr))
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	if (tb[VERDICT_STATUS])
+		status = blobmsg_get_u32(tb[VERDICT_STATUS]);
+
+	if (tb[VERDICT_TTL])
+		ttl = blobmsg_get_u32(tb[VERDICT_TTL]);
+
+	hostapd_bss_verdict_set(hapd, addr, status, ttl);
+
+	return 0;
+}
+
 enum {
 	DEL_CLIENT_ADDR,
 	DEL_CLIENT_REASON,
@@ -555,16 +1086,6 @@ hostapd_bss_del_client(struct ubus_context *ctx, struct ubus_object *obj,
 	return 0;
 }
 
-static void
-blobmsg_add_macaddr(struct blob_buf *buf, const char *name, const u8 *addr)
-{
-	char *s;
-
-	s = blobmsg_alloc_string_buffer(buf, name, 20);
-	sprintf(s, MACSTR, MAC2STR(addr));
-	blobmsg_add_string_buffer(buf);
-}
-
 static int
 hostapd_bss_list_bans(struct ubus_context *ctx, struct ubus_object *obj,
 		      struct ubus_request_data *req, const char *method,
@@ -584,6 +1105,91 @@ hostapd_bss_list_bans(struct ubus_context *ctx, struct ubus_object *obj,
 	return 0;
 }
 
+enum {
+	PROBE_BATCH_INTERVAL,
+	PROBE_BATCH_RATE,
+	PROBE_BATCH_BURST,
+	__PROBE_BATCH_MAX
+};
+
+static const struct blobmsg_policy probe_batch_policy[__PROBE_BATCH_MAX] = {
+	[PROBE_BATCH_INTERVAL] = { "interval", BLOBMSG_TYPE_INT32 },
+	[PROBE_BATCH_RATE] = { "rate", BLOBMSG_TYPE_INT32 },
+	[PROBE_BATCH_BURST] = { "burst", BLOBMSG_TYPE_INT32 },
+};
+
+static int
+hostapd_bss_probe_batch(struct ubus_context *ctx, struct ubus_object *obj,
+			struct ubus_request_data *req, const char *method,
+			struct blob_attr *msg)
+{
+	struct blob_attr *tb[__PROBE_BATCH_MAX];
+	struct hostapd_data *hapd = get_hapd_from_object(obj);
+	struct hostapd_ubus_bss *ubus = &hapd->ubus;
+
+	blobmsg_parse(probe_batch_policy, __PROBE_BATCH_MAX, tb, blob_data(msg), blob_len(msg));
+
+	if (tb[PROBE_BATCH_INTERVAL])
+		ubus->probe_batch_interval = blobmsg_get_u32(tb[PROBE_BATCH_INTERVAL]);
+
+	if (tb[PROBE_BATCH_RATE])
+		ubus->probe_rate = blobmsg_get_u32(tb[PROBE_BATCH_RATE]);
+
+	if (tb[PROBE_BATCH_BURST])
+		ubus->probe_burst = blobmsg_get_u32(tb[PROBE_BATCH_BURST]);
+
+	if (ubus->probe_batch_interval < 0 || ubus->probe_rate < 0 ||
+	    ubus->probe_burst < 0) {
+		ubus->probe_batch_interval = 0;
+		ubus->probe_rate = 0;
+		ubus->probe_burst = 0;
+		return UBUS_STATUS_INVALID_ARGUMENT;
+	}
+
+	if (ubus->probe_rate && !ubus->probe_burst)
+		ubus->probe_burst = ubus->probe_rate;
+
+	ubus->probe_tokens = ubus->probe_burst * 1000;
+	os_get_reltime(&ubus->probe_tokens_update);
+
+	if (!ubus->probe_batch_interval)
+		hostapd_bss_probe_batch_flush(hapd, NULL);
+
+	return 0;
+}
+
+static int
+hostapd_bss_list_verdicts(struct ubus_context *ctx, struct ubus_object *obj,
+			  struct ubus_request_data *req, const char *method,
+			  struct blob_attr *msg)
+{
+	struct hostapd_data *hapd = container_of(obj, struct hostapd_data, ubus.obj);
+	struct ubus_verdict *v;
+	struct os_reltime now, left;
+	char mac_buf[20];
+	void *c, *t;
+
+	os_get_reltime(&now);
+
+	blob_buf_init(&b, 0);
+	c = blobmsg_open_table(&b, "clients");
+	avl_for_each_element(&hapd->ubus.verdicts, v, avl) {
+		if (os_reltime_before(&v->expire, &now))
+			continue;
+
+		os_reltime_sub(&v->expire, &now, &left);
+		sprintf(mac_buf, MACSTR, MAC2STR(v->addr));
+		t = blobmsg_open_table(&b, mac_buf);
+		blobmsg_add_u32(&b, "status", v->status);
+		blobmsg_add_u32(&b, "ttl", left.sec * 1000 + left.usec / 1000);
+		blobmsg_close_table(&b, t);
+	}
+	blobmsg_close_table(&b, c);
+	ubus_send_reply(ctx, req, b.head);
+
+	return 0;
+}
+
 #ifdef CONFIG_WPS
 static int
 hostapd_bss_wps_start(struct ubus_context *ctx, struct ubus_object *obj,
@@ -1672,7 +2278,7 @@ hostapd_bss_update_airtime(struct ubus_context *ctx, struct ubus_object *obj,
 
 static const struct ubus_method bss_methods[] = {
 	UBUS_METHOD_NOARG("reload", hostapd_bss_reload),
-	UBUS_METHOD_NOARG("get_clients", hostapd_bss_get_clients),
+	UBUS_METHOD("get_clients", hostapd_bss_get_clients, get_clients_policy),
 	UBUS_METHOD_NOARG("get_status", hostapd_bss_get_status),
 	UBUS_METHOD("del_client", hostapd_bss_del_client, del_policy),
 #ifdef CONFIG_AIRTIME_POLICY
@@ -1691,6 +2297,9 @@ static const struct ubus_method bss_methods[] = {
 #endif
 	UBUS_METHOD("set_vendor_elements", hostapd_vendor_elements, ve_policy),
 	UBUS_METHOD("notify_response", hostapd_notify_response, notify_policy),
+	UBUS_METHOD("set_verdict", hostapd_bss_set_verdict, verdict_policy),
+	UBUS_METHOD_NOARG("list_verdicts", hostapd_bss_list_verdicts),
+	UBUS_METHOD("probe_batch", hostapd_bss_probe_batch, probe_batch_policy),
 	UBUS_METHOD("bss_mgmt_enable", hostapd_bss_mgmt_enable, bss_mgmt_enable_policy),
 	UBUS_METHOD_NOARG("rrm_nr_get_own", hostapd_rrm_nr_get_own),
 	UBUS_METHOD_NOARG("rrm_nr_list", hostapd_rrm_nr_list),
@@ -1728,6 +2337,11 @@ void hostapd_ubus_add_bss(struct hostapd_data *hapd)
 		return;
 
 	avl_init(&hapd->ubus.banned, avl_compare_macaddr, false, NULL);
+	avl_init(&hapd->ubus.verdicts, avl_compare_macaddr, false, NULL);
+	avl_init(&hapd->ubus.probe_batch, avl_compare_macaddr, false, NULL);
+	avl_init(&hapd->ubus.clients, avl_compare_macaddr, false, NULL);
+	INIT_LIST_HEAD(&hapd->ubus.verdict_reqs);
+	hapd->ubus.verdict_ttl = HOSTAPD_UBUS_VERDICT_TTL;
 	obj->name = name;
 	obj->type = &bss_object_type;
 	obj->methods = bss_object_type.methods;
@@ -1753,6 +2367,23 @@ void hostapd_ubus_free_bss(struct hostapd_data *hapd)
 
 	hostapd_send_shared_event(&hapd->iface->interfaces->ubus, hapd->conf->iface, "remove");
 
+	if (hapd->ubus.verdict_reqs.next)
+		hostapd_bss_verdict_flush(hapd);
+
+	if (hapd->ubus.probe_batch.comp) {
+		hapd->ubus.probe_batch_interval = 0;
+		hostapd_bss_probe_batch_flush(hapd, NULL);
+	}
+
+	if (hapd->ubus.clients.comp) {
+		struct ubus_client_gen *c, *tmp;
+
+		avl_for_each_element_safe(&hapd->ubus.clients, c, avl, tmp) {
+			avl_delete(&hapd->ubus.clients, &c->avl);
+			free(c);
+		}
+	}
+
 	if (obj->id) {
 		ubus_remove_object(ctx, obj);
 		hostapd_ubus_ref_dec();
@@ -1862,6 +2493,10 @@ int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_req
 	};
 	const char *type = "mgmt";
 	struct ubus_event_req ureq = {};
+	struct ubus_verdict_req *vreq;
+	bool async = hapd->ubus.notify_response && hapd->ubus.notify_async;
+	bool cached = false;
+	int status = WLAN_STATUS_SUCCESS;
 	const u8 *addr;
 
 	if (req->mgmt_frame)
@@ -1873,8 +2508,42 @@ int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_req
 	if (ban)
 		return WLAN_STATUS_AP_UNABLE_TO_HANDLE_NEW_STA;
 
+	if (req->type != HOSTAPD_UBUS_PROBE_REQ)
+		hostapd_bss_client_changed(hapd, addr);
+
+	if (async) {
+		cached = hostapd_bss_verdict_get(hapd, addr, &status);
+		if (cached)
+			hapd->ubus.verdict_stats.hits++;
+		else
+			hapd->ubus.verdict_stats.misses++;
+	}
+
 	if (!hapd->ubus.obj.has_subscribers)
-		return WLAN_STATUS_SUCCESS;
+		return status;
+
+	/*
+	 * Unknown stations get the configured default right away, the subscriber
+	 * verdict is stored in the cache for the next frame once it arrives.
+	 */
+	if (async && !cached)
+		status = hapd->ubus.verdict_default;
+
+	/*
+	 * Probe requests that do not need a synchronous response can be rate
+	 * limited and coalesced per station into periodic probe-batch events.
+	 */
+	if (req->type == HOSTAPD_UBUS_PROBE_REQ &&
+	    (!hapd->ubus.notify_response || async)) {
+		hapd->ubus.probe_stats.events++;
+		if (hostapd_bss_probe_ratelimit(hapd))
+			return status;
+
+		if (hapd->ubus.probe_batch_interval) {
+			hostapd_bss_probe_batch_add(hapd, req, addr);
+			return status;
+		}
+	}
 
 	if (req->type < ARRAY_SIZE(types))
 		type = types[req->type];
@@ -1928,9 +2597,33 @@ int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_req
 		}
 	}
 
-	if (!hapd->ubus.notify_response) {
+	if (!hapd->ubus.notify_response || cached ||
+	    (async && hapd->ubus.verdict_reqs_pending >= HOSTAPD_UBUS_VERDICT_REQ_MAX)) {
 		ubus_notify(ctx, &hapd->ubus.obj, type, b.head, -1);
-		return WLAN_STATUS_SUCCESS;
+		return status;
+	}
+
+	if (async) {
+		vreq = os_zalloc(sizeof(*vreq));
+		if (!vreq)
+			return status;
+
+		if (ubus_notify_async(ctx, &hapd->ubus.obj, type, b.head, &vreq->nreq)) {
+			free(vreq);
+			return status;
+		}
+
+		vreq->hapd = hapd;
+		memcpy(vreq->addr, addr, ETH_ALEN);
+		vreq->nreq.status_cb = hostapd_bss_verdict_req_status_cb;
+		vreq->nreq.complete_cb = hostapd_bss_verdict_req_complete_cb;
+		list_add(&vreq->list, &hapd->ubus.verdict_reqs);
+		hapd->ubus.verdict_reqs_pending++;
+		eloop_register_timeout(HOSTAPD_UBUS_VERDICT_REQ_TIMEOUT, 0,
+				       hostapd_bss_verdict_req_timeout, vreq, NULL);
+		ubus_complete_request_async(ctx, &vreq->nreq.req);
+
+		return status;
 	}
 
 	if (ubus_notify_async(ctx, &hapd->ubus.obj, type, b.head, &ureq.nreq))
@@ -1947,10 +2640,12 @@ int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_req
 
 void hostapd_ubus_notify(struct hostapd_data *hapd, const char *type, const u8 *addr)
 {
-	if (!hapd->ubus.obj.has_subscribers)
+	if (!addr)
 		return;
 
-	if (!addr)
+	hostapd_bss_client_changed(hapd, addr);
+
+	if (!hapd->ubus.obj.has_subscribers)
 		return;
 
 	blob_buf_init(&b, 0);
@@ -1962,6 +2657,8 @@ void hostapd_ubus_notify(struct hostapd_data *hapd, const char *type, const u8 *
 void hostapd_ubus_notify_authorized(struct hostapd_data *hapd, struct sta_info *sta,
 				    const char *auth_alg)
 {
+	hostapd_bss_client_changed(hapd, sta->addr);
+
 	if (!hapd->ubus.obj.has_subscribers)
 		return;
 
@@ -37,6 +37,42 @@ struct hostapd_ubus_bss {
 	struct ubus_object obj;
 	struct avl_tree banned;
 	int notify_response;
+
+	/* asynchronous notify_response mode: per-STA verdict cache */
+	bool notify_async;
+	int verdict_default;
+	int verdict_ttl;
+	int verdict_count;
+	struct avl_tree verdicts;
+	struct list_head verdict_reqs;
+	int verdict_reqs_pending;
+	struct {
+		u64 hits;
+		u64 misses;
+		u64 responses;
+		u64 timeouts;
+	} verdict_stats;
+
+	/* batched, rate limited probe request notifications */
+	int probe_batch_interval;
+	int probe_rate;
+	int probe_burst;
+	unsigned int probe_tokens;
+	struct os_reltime probe_tokens_update;
+	struct avl_tree probe_batch;
+	int probe_batch_count;
+	struct {
+		u64 events;
+		u64 coalesced;
+		u64 dropped;
+		u64 flushes;
+	} probe_stats;
+
+	/* client table change tracking for incremental get_clients */
+	u32 client_gen;
+	u32 client_gen_min;
+	struct avl_tree clients;
+	int clients_removed;
 };
 
 void hostapd_ubus_add_iface(struct hostapd_iface *iface);
@@ -0,0 +1,193 @@
+/*
+ * hash.c - md5/sha256 hashing for mtd verify
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License v2
+ * as published by the Free Software Foundation.
+ *
+ * The kernel crypto API is used through AF_ALG when it provides an
+ * accelerated (non-generic) driver for the algorithm, the bundled
+ * software implementations are used otherwise.
+ */
+
+#include <sys/socket.h>
+#include <linux/if_alg.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "hash.h"
+
+#ifndef AF_ALG
+#define AF_ALG 38
+#endif
+
+static const struct {
+	const char *name;
+	int len;
+} hash_types[] = {
+	[MTD_HASH_MD5] = { "md5", 16 },
+	[MTD_HASH_SHA256] = { "sha256", SHA256_DIGEST_LEN },
+};
+
+int mtd_hash_lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i < sizeof(hash_types) / sizeof(hash_types[0]); i++)
+		if (!strcmp(hash_types[i].name, name))
+			return i;
+
+	return -1;
+}
+
+const char *mtd_hash_name(enum mtd_hash_type type)
+{
+	return hash_types[type].name;
+}
+
+int mtd_hash_len(enum mtd_hash_type type)
+{
+	return hash_types[type].len;
+}
+
+/* check /proc/crypto for a tested, non-generic driver of the algorithm */
+static bool hash_accel_available(const char *alg)
+{
+	char line[128], name[64] = "", driver[64] = "";
+	bool found = false;
+	FILE *f;
+
+	f = fopen("/proc/crypto", "r");
+	if (!f)
+		return false;
+
+	while (!found && fgets(line, sizeof(line), f)) {
+		char key[32], val[64];
+
+		if (line[0] == '\n') {
+			name[0] = driver[0] = 0;
+			continue;
+		}
+
+		if (sscanf(line, "%31s : %63s", key, val) != 2)
+			continue;
+
+		if (!strcmp(key, "name"))
+			strcpy(name, val);
+		else if (!strcmp(key, "driver"))
+			strcpy(driver, val);
+		else if (!strcmp(key, "selftest") && !strcmp(val, "passed") &&
+			 !strcmp(name, alg) && !strstr(driver, "-generic"))
+			found = true;
+	}
+
+	fclose(f);
+
+	return found;
+}
+
+static int hash_alg_open(const char *alg)
+{
+	struct sockaddr_alg sa = {
+		.salg_family = AF_ALG,
+		.salg_type = "hash",
+	};
+	int tfm, fd;
+
+	if (!hash_accel_available(alg))
+		return -1;
+
+	strncpy((char *) sa.salg_name, alg, sizeof(sa.salg_name) - 1);
+
+	tfm = socket(AF_ALG, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (tfm < 0)
+		return -1;
+
+	if (bind(tfm, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+		close(tfm);
+		return -1;
+	}
+
+	fd = accept(tfm, NULL, 0);
+	close(tfm);
+
+	return fd;
+}
+
+int mtd_hash_begin(struct mtd_hash *h, enum mtd_hash_type type)
+{
+	h->type = type;
+	h->alg_fd = hash_alg_open(hash_types[type].name);
+	if (h->alg_fd >= 0)
+		return 0;
+
+	switch (type) {
+	case MTD_HASH_MD5:
+		md5_begin(&h->md5);
+		break;
+	case MTD_HASH_SHA256:
+		sha256_begin(&h->sha256);
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+int mtd_hash_update(struct mtd_hash *h, const void *data, size_t len)
+{
+	const char *p = data;
+	ssize_t r;
+
+	if (h->alg_fd < 0) {
+		if (h->type == MTD_HASH_MD5)
+			md5_hash(data, len, &h->md5);
+		else
+			sha256_hash(data, len, &h->sha256);
+		return 0;
+	}
+
+	while (len > 0) {
+		r = send(h->alg_fd, p, len, MSG_MORE);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		p += r;
+		len -= r;
+	}
+
+	return 0;
+}
+
+int mtd_hash_end(struct mtd_hash *h, void *digest)
+{
+	int len = hash_types[h->type].len;
+	ssize_t r;
+
+	if (h->alg_fd < 0) {
+		if (h->type == MTD_HASH_MD5)
+			md5_end(digest, &h->md5);
+		else
+			sha256_end(digest, &h->sha256);
+		return len;
+	}
+
+	do {
+		r = read(h->alg_fd, digest, len);
+	} while (r < 0 && errno == EINTR);
+
+	close(h->alg_fd);
+	h->alg_fd = -1;
+
+	return r == len ? len : -1;
+}
+
+bool mtd_hash_offloaded(struct mtd_hash *h)
+{
+	return h->alg_fd >= 0;
+}
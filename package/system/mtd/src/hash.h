@@ -0,0 +1,36 @@
+#ifndef __mtd_hash_h
+#define __mtd_hash_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <libubox/md5.h>
+#include "sha256.h"
+
+#define MTD_HASH_MAX_LEN	SHA256_DIGEST_LEN
+
+enum mtd_hash_type {
+	MTD_HASH_MD5,
+	MTD_HASH_SHA256,
+};
+
+struct mtd_hash {
+	enum mtd_hash_type type;
+
+	/* AF_ALG operation socket, -1 when hashing in software */
+	int alg_fd;
+
+	union {
+		md5_ctx_t md5;
+		struct sha256_ctx sha256;
+	};
+};
+
+extern int mtd_hash_lookup(const char *name);
+extern const char *mtd_hash_name(enum mtd_hash_type type);
+extern int mtd_hash_len(enum mtd_hash_type type);
+extern int mtd_hash_begin(struct mtd_hash *h, enum mtd_hash_type type);
+extern int mtd_hash_update(struct mtd_hash *h, const void *data, size_t len);
+extern int mtd_hash_end(struct mtd_hash *h, void *digest);
+extern bool mtd_hash_offloaded(struct mtd_hash *h);
+
+#endif /* __mtd_hash_h */
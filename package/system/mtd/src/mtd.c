@@ -25,6 +25,7 @@
 #include <byteswap.h>
 #include <endian.h>
 #include <limits.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -46,12 +47,12 @@
 #include <mtd/mtd-user.h>
 #include "crc32.h"
 #include "fis.h"
+#include "hash.h"
 #include "mtd.h"
 
-#include <libubox/md5.h>
-
 #define MAX_ARGS 8
 #define JFFS2_DEFAULT_DIR	"" /* directory name without /, empty means root dir */
+#define VERIFY_BUFSIZE		(1024 * 1024)
 
 #define TRX_MAGIC		0x48445230	/* "HDR0" */
 #define SEAMA_MAGIC		0x5ea3a417
@@ -88,12 +89,15 @@ static enum mtd_image_format imageformat = MTD_IMAGE_FORMAT_UNKNOWN;
 static char *jffs2file = NULL, *jffs2dir = JFFS2_DEFAULT_DIR;
 static char *tpl_uboot_args_part;
 static int buflen = 0;
+static enum mtd_hash_type verify_hash = MTD_HASH_MD5;
 int quiet;
 int no_erase;
+int diff_write;
 int mtdsize = 0;
 int erasesize = 0;
 int jffs2_skip_bytes=0;
 int mtdtype = 0;
+uint32_t mtdflags = 0;
 uint32_t opt_trxmagic = TRX_MAGIC;
 
 int mtd_open(const char *mtd, bool block)
@@ -143,6 +147,7 @@ int mtd_check_open(const char *mtd)
 	mtdsize = mtdInfo.size;
 	erasesize = mtdInfo.erasesize;
 	mtdtype = mtdInfo.type;
+	mtdflags = mtdInfo.flags;
 
 	return fd;
 }
@@ -399,63 +404,353 @@ out:
 	return ret;
 }
 
+struct verify_stream {
+	const char *name;
+	int fd;
+	char *buf;
+	size_t bufsize;
+	size_t len;
+	int err;
+	struct mtd_hash hash;
+	uint8_t digest[MTD_HASH_MAX_LEN];
+};
+
+/* progress of the image reader, the flash is read up to the same length */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	size_t len;
+	bool done;
+	bool abort;
+} verify_state = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static ssize_t
+read_full(int fd, char *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = read(fd, buf + done, len - done);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (!r)
+			break;
+
+		done += r;
+	}
+
+	return done;
+}
+
+static void *
+verify_image_thread(void *arg)
+{
+	struct verify_stream *s = arg;
+	ssize_t r;
+
+	do {
+		r = read_full(s->fd, s->buf, s->bufsize);
+		if (r < 0) {
+			s->err = errno;
+			break;
+		}
+
+		if (r && mtd_hash_update(&s->hash, s->buf, r) < 0) {
+			s->err = errno;
+			break;
+		}
+
+		s->len += r;
+
+		pthread_mutex_lock(&verify_state.lock);
+		verify_state.len = s->len;
+		pthread_cond_signal(&verify_state.cond);
+		r = verify_state.abort ? 0 : r;
+		pthread_mutex_unlock(&verify_state.lock);
+	} while (r == s->bufsize);
+
+	pthread_mutex_lock(&verify_state.lock);
+	verify_state.done = true;
+	pthread_cond_signal(&verify_state.cond);
+	pthread_mutex_unlock(&verify_state.lock);
+
+	return NULL;
+}
+
+static int
+verify_flash(struct verify_stream *s)
+{
+	size_t len;
+	ssize_t r;
+	bool done;
+
+	for (;;) {
+		pthread_mutex_lock(&verify_state.lock);
+		while (!verify_state.done && verify_state.len == s->len)
+			pthread_cond_wait(&verify_state.cond, &verify_state.lock);
+		len = verify_state.len - s->len;
+		done = verify_state.done;
+		pthread_mutex_unlock(&verify_state.lock);
+
+		if (!len) {
+			if (done)
+				return 0;
+			continue;
+		}
+
+		if (len > s->bufsize)
+			len = s->bufsize;
+
+		r = read_full(s->fd, s->buf, len);
+		if (r < 0) {
+			s->err = errno;
+			return -1;
+		}
+		if (r < len) {
+			s->err = ENOSPC;
+			return -1;
+		}
+
+		if (mtd_hash_update(&s->hash, s->buf, r) < 0) {
+			s->err = errno;
+			return -1;
+		}
+
+		s->len += r;
+	}
+}
+
+static void
+verify_print(struct verify_stream *s)
+{
+	int i, len = mtd_hash_len(s->hash.type);
+
+	for (i = 0; i < len; i++)
+		fprintf(stderr, "%02x", s->digest[i]);
+	fprintf(stderr, " - %s\n", s->name);
+}
+
 static int
 mtd_verify(const char *mtd, char *file)
 {
-	uint32_t f_md5[4], m_md5[4];
-	struct stat s;
-	md5_ctx_t ctx;
-	int ret = 0;
-	int fd;
+	struct verify_stream f = { .name = file, .fd = -1 };
+	struct verify_stream m = { .name = mtd, .fd = -1 };
+	struct timespec start, end;
+	pthread_t thread;
+	bool offloaded;
+	uint64_t msec;
+	int ret = -1;
 
 	if (quiet < 2)
 		fprintf(stderr, "Verifying %s against %s ...\n", mtd, file);
 
-	if (stat(file, &s) || md5sum(file, f_md5) < 0) {
-		fprintf(stderr, "Failed to hash %s\n", file);
+	if (!strcmp(file, "-"))
+		f.fd = 0;
+	else
+		f.fd = open(file, O_RDONLY);
+	if (f.fd < 0) {
+		fprintf(stderr, "Failed to open %s\n", file);
 		return -1;
 	}
 
-	fd = mtd_check_open(mtd);
-	if(fd < 0) {
+	m.fd = mtd_check_open(mtd);
+	if(m.fd < 0) {
 		fprintf(stderr, "Could not open mtd device: %s\n", mtd);
-		return -1;
+		goto out;
 	}
 
-	md5_begin(&ctx);
-	do {
-		char buf[256];
-		int len = (s.st_size > sizeof(buf)) ? (sizeof(buf)) : (s.st_size);
-		int rlen = read(fd, buf, len);
+	/* read in multiples of the erase block size, at least VERIFY_BUFSIZE */
+	m.bufsize = (VERIFY_BUFSIZE + erasesize - 1) / erasesize * erasesize;
+	f.bufsize = m.bufsize;
+	if (posix_memalign((void **) &f.buf, getpagesize(), f.bufsize) ||
+	    posix_memalign((void **) &m.buf, getpagesize(), m.bufsize)) {
+		fprintf(stderr, "Out of memory\n");
+		goto out;
+	}
 
-		if (rlen < 0) {
-			if (errno == EINTR)
-				continue;
-			ret = -1;
-			goto out;
-		}
-		if (!rlen)
-			break;
-		md5_hash(buf, rlen, &ctx);
-		s.st_size -= rlen;
-	} while (s.st_size > 0);
+	if (mtd_hash_begin(&f.hash, verify_hash) < 0 ||
+	    mtd_hash_begin(&m.hash, verify_hash) < 0) {
+		fprintf(stderr, "Failed to set up %s hashing\n",
+			mtd_hash_name(verify_hash));
+		goto out;
+	}
+	offloaded = mtd_hash_offloaded(&m.hash);
 
-	md5_end(m_md5, &ctx);
+	clock_gettime(CLOCK_MONOTONIC, &start);
 
-	fprintf(stderr, "%08x%08x%08x%08x - %s\n", m_md5[0], m_md5[1], m_md5[2], m_md5[3], mtd);
-	fprintf(stderr, "%08x%08x%08x%08x - %s\n", f_md5[0], f_md5[1], f_md5[2], f_md5[3], file);
+	if (pthread_create(&thread, NULL, verify_image_thread, &f)) {
+		fprintf(stderr, "Failed to start reader thread\n");
+		goto out;
+	}
 
-	ret = memcmp(f_md5, m_md5, sizeof(m_md5));
+	if (verify_flash(&m) < 0) {
+		pthread_mutex_lock(&verify_state.lock);
+		verify_state.abort = true;
+		pthread_mutex_unlock(&verify_state.lock);
+	}
+
+	pthread_join(thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (f.err) {
+		fprintf(stderr, "Failed to read %s: %s\n", file, strerror(f.err));
+		goto out;
+	}
+
+	if (m.err) {
+		fprintf(stderr, "Failed to read %s: %s\n", mtd,
+			m.err == ENOSPC ? "image is larger than the device" :
+			strerror(m.err));
+		goto out;
+	}
+
+	if (mtd_hash_end(&m.hash, m.digest) < 0 ||
+	    mtd_hash_end(&f.hash, f.digest) < 0) {
+		fprintf(stderr, "Failed to compute %s\n", mtd_hash_name(verify_hash));
+		goto out;
+	}
+
+	verify_print(&m);
+	verify_print(&f);
+
+	ret = memcmp(f.digest, m.digest, mtd_hash_len(verify_hash));
 	if (!ret)
 		fprintf(stderr, "Success\n");
 	else
 		fprintf(stderr, "Failed\n");
 
+	if (quiet < 2) {
+		msec = (end.tv_sec - start.tv_sec) * 1000 +
+		       (end.tv_nsec - start.tv_nsec) / 1000000;
+		fprintf(stderr, "Verified %zu bytes in %llu.%03llus (%llu KiB/s, %s%s)\n",
+			m.len, (unsigned long long) msec / 1000,
+			(unsigned long long) msec % 1000,
+			(unsigned long long) (m.len * 1000 / 1024 / (msec ? msec : 1)),
+			mtd_hash_name(verify_hash), offloaded ? ", kernel crypto" : "");
+	}
+
 out:
-	close(fd);
+	free(f.buf);
+	free(m.buf);
+	if (m.fd >= 0)
+		close(m.fd);
+	if (f.fd > 0)
+		close(f.fd);
 	return ret;
 }
 
+enum diff_result {
+	DIFF_SAME,
+	DIFF_PROGRAM,
+	DIFF_ERASE,
+};
+
+static struct {
+	int unchanged;
+	int programmed;
+	int erased;
+	uint64_t erase_us;
+	uint64_t write_us;
+	uint64_t start_us;
+} diff_stats;
+
+static char *diff_buf;
+
+static uint64_t
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Compare an erase block on flash with the data about to be written to it.
+ * Blocks that only need 1->0 bit transitions can be programmed without an
+ * erase on devices flagged MTD_BIT_WRITEABLE. Others, like NAND or NOR with
+ * ECC pages, must not be programmed twice. Blocks that needed ECC
+ * correction while reading are rewritten to refresh them.
+ */
+static enum diff_result
+mtd_diff_block(int fd, int offset, const char *data, int len)
+{
+	struct mtd_ecc_stats ecc_before, ecc_after;
+	const uint32_t *old, *new;
+	bool program = false;
+	int i;
+
+	if (!diff_buf && posix_memalign((void **) &diff_buf, getpagesize(), erasesize))
+		return DIFF_ERASE;
+
+	if (mtdtype == MTD_NANDFLASH || mtdtype == MTD_MLCNANDFLASH) {
+		if (ioctl(fd, ECCGETSTATS, &ecc_before))
+			return DIFF_ERASE;
+	}
+
+	if (pread(fd, diff_buf, len, offset) != len)
+		return DIFF_ERASE;
+
+	if (mtdtype == MTD_NANDFLASH || mtdtype == MTD_MLCNANDFLASH) {
+		if (ioctl(fd, ECCGETSTATS, &ecc_after) ||
+		    ecc_after.corrected != ecc_before.corrected ||
+		    ecc_after.failed != ecc_before.failed)
+			return DIFF_ERASE;
+	}
+
+	if (!memcmp(diff_buf, data, len))
+		return DIFF_SAME;
+
+	if (!(mtdflags & MTD_BIT_WRITEABLE) || len % sizeof(*old))
+		return DIFF_ERASE;
+
+	old = (const uint32_t *) diff_buf;
+	new = (const uint32_t *) data;
+	for (i = 0; i < len / sizeof(*old); i++) {
+		if (old[i] == new[i])
+			continue;
+
+		/* bits that need to go from 0 to 1 require an erase */
+		if (new[i] & ~old[i])
+			return DIFF_ERASE;
+
+		program = true;
+	}
+
+	return program ? DIFF_PROGRAM : DIFF_SAME;
+}
+
+static void
+diff_report(void)
+{
+	int written = diff_stats.programmed + diff_stats.erased;
+	uint64_t elapsed = now_us() - diff_stats.start_us;
+	uint64_t saved = 0;
+
+	/* estimate the time saved from the average cost of the operations
+	 * that did happen */
+	if (diff_stats.erased)
+		saved += (diff_stats.erase_us / diff_stats.erased) *
+			 (diff_stats.unchanged + diff_stats.programmed);
+	if (written)
+		saved += (diff_stats.write_us / written) * diff_stats.unchanged;
+
+	fprintf(stderr, "Differential write: %d blocks unchanged, %d written "
+		"(%d without erase), %d erased\n",
+		diff_stats.unchanged, written, diff_stats.programmed,
+		diff_stats.erased);
+	fprintf(stderr, "Elapsed %llu ms, estimated %llu ms saved\n",
+		(unsigned long long) elapsed / 1000,
+		(unsigned long long) saved / 1000);
+}
+
 static void
 indicate_writing(const char *mtd)
 {
@@ -478,6 +773,8 @@ mtd_write(int imagefd, const char *mtd, char *fis_layout, size_t part_offset)
 	int buflen_raw = 0;
 	int jffs2_replaced = 0;
 	int skip_bad_blocks = 0;
+	bool unchanged;
+	uint64_t t;
 
 #ifdef FIS_SUPPORT
 	static struct fis_part new_parts[MAX_ARGS];
@@ -574,6 +871,9 @@ resume:
 
 	indicate_writing(mtd);
 
+	if (diff_write && !diff_stats.start_us)
+		diff_stats.start_us = now_us();
+
 	w = e = 0;
 	for (;;) {
 		/* buffer may contain data already (from trx check or last mtd partition write attempt) */
@@ -643,6 +943,7 @@ resume:
 		}
 
 		/* need to erase the next block before writing data to it */
+		unchanged = false;
 		if(!no_erase)
 		{
 			while (w + buflen > e - skip_bad_blocks) {
@@ -661,6 +962,24 @@ resume:
 					continue;
 				}
 
+				if (diff_write && !offset && buflen == erasesize &&
+				    w == e - skip_bad_blocks) {
+					switch (mtd_diff_block(fd, e + part_offset, buf, buflen)) {
+					case DIFF_SAME:
+						unchanged = true;
+						diff_stats.unchanged++;
+						e += erasesize;
+						continue;
+					case DIFF_PROGRAM:
+						diff_stats.programmed++;
+						e += erasesize;
+						continue;
+					default:
+						break;
+					}
+				}
+
+				t = now_us();
 				if (mtd_erase_block(fd, e + part_offset) < 0) {
 					if (next) {
 						if (w < e) {
@@ -680,21 +999,32 @@ resume:
 				}
 
 				/* erase the chunk */
+				diff_stats.erase_us += now_us() - t;
+				diff_stats.erased++;
 				e += erasesize;
 			}
 		}
 
-		if (!quiet)
-			fprintf(stderr, "\b\b\b[w]");
+		if (unchanged) {
+			if (!quiet)
+				fprintf(stderr, "\b\b\b[s]");
 
-		if ((result = write(fd, buf + offset, buflen)) < buflen) {
-			if (result < 0) {
-				fprintf(stderr, "Error writing image.\n");
-				exit(1);
-			} else {
-				fprintf(stderr, "Insufficient space.\n");
-				exit(1);
+			lseek(fd, buflen, SEEK_CUR);
+		} else {
+			if (!quiet)
+				fprintf(stderr, "\b\b\b[w]");
+
+			t = now_us();
+			if ((result = write(fd, buf + offset, buflen)) < buflen) {
+				if (result < 0) {
+					fprintf(stderr, "Error writing image.\n");
+					exit(1);
+				} else {
+					fprintf(stderr, "Insufficient space.\n");
+					exit(1);
+				}
 			}
+			diff_stats.write_us += now_us() - t;
 		}
 		w += buflen;
 
@@ -742,6 +1072,9 @@ resume:
 	if (quiet < 2)
 		fprintf(stderr, "\n");
 
+	if (diff_write && quiet < 2)
+		diff_report();
+
 #ifdef FIS_SUPPORT
 	if (fis_layout) {
 		if (fis_remap(old_parts, n_old, new_parts, n_new) < 0)
@@ -801,6 +1134,8 @@ static void usage(void)
 	"        -q                      quiet mode (once: no [w] on writing,\n"
 	"                                           twice: no status messages)\n"
 	"        -n                      write without first erasing the blocks\n"
+	"        -D                      differential write: skip blocks that are already\n"
+	"                                up to date, avoid erasing where possible\n"
 	"        -r                      reboot after successful command\n"
 	"        -f                      force write without trx checks\n"
 	"        -e <device>             erase <device> before executing the command\n"
@@ -808,7 +1143,8 @@ static void usage(void)
 	"        -j <name>               integrate <file> into jffs2 data when writing an image\n"
 	"        -s <number>             skip the first n bytes when appending data to the jffs2 partiton, defaults to \"0\"\n"
 	"        -p <number>             write beginning at partition offset\n"
-	"        -l <length>             the length of data that we want to dump\n");
+	"        -l <length>             the length of data that we want to dump\n"
+	"        -H <hash>               hash used by verify: md5 (default) or sha256\n");
 	if (mtd_fixtrx) {
 	    fprintf(stderr,
 	"        -M <magic>              magic number of the image header in the partition (for fixtrx)\n"
@@ -874,12 +1210,13 @@ int main (int argc, char **argv)
 	buflen = 0;
 	quiet = 0;
 	no_erase = 0;
+	diff_write = 0;
 
 	while ((ch = getopt(argc, argv,
 #ifdef FIS_SUPPORT
 			"F:"
 #endif
-			"frnqe:d:s:j:p:o:c:t:l:M:")) != -1)
+			"frnDqe:d:s:j:p:o:c:t:l:M:H:")) != -1)
 		switch (ch) {
 			case 'f':
 				force = 1;
@@ -890,6 +1227,9 @@ int main (int argc, char **argv)
 			case 'n':
 				no_erase = 1;
 				break;
+			case 'D':
+				diff_write = 1;
+				break;
 			case 'j':
 				jffs2file = optarg;
 				break;
@@ -958,6 +1298,14 @@ int main (int argc, char **argv)
 			case 't':
 				tpl_uboot_args_part = optarg;
 				break;
+			case 'H':
+				i = mtd_hash_lookup(optarg);
+				if (i < 0) {
+					fprintf(stderr, "-H: unsupported hash %s\n", optarg);
+					usage();
+				}
+				verify_hash = i;
+				break;
 #ifdef FIS_SUPPORT
 			case 'F':
 				fis_layout = optarg;
@@ -0,0 +1,19 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_LEN	32
+
+struct sha256_ctx {
+	uint32_t state[8];
+	uint64_t len;
+	uint8_t buf[64];
+};
+
+void sha256_begin(struct sha256_ctx *ctx);
+void sha256_hash(const void *data, size_t len, struct sha256_ctx *ctx);
+void sha256_end(void *digest, struct sha256_ctx *ctx);
+
+#endif
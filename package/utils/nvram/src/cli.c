@@ -22,6 +22,8 @@
  *
  */
 
+#include <signal.h>
+
 #include "nvram.h"
 
 
@@ -83,6 +85,77 @@ static int do_get(nvram_handle_t *nvram, const char *var)
 	return stat;
 }
 
+/* Answer "get" commands from the daemon snapshot, -1 if unavailable. */
+static int do_get_snapshot(int argc, const char *argv[])
+{
+	nvram_snapshot_t *snap;
+	const char *val;
+	int stat = 1;
+	int i;
+
+	for( i = 1; i < argc; i += 2 )
+		if( strcmp(argv[i], "get") || (i+1) >= argc )
+			return -1;
+
+	if( (snap = nvram_snapshot_open()) == NULL )
+		return -1;
+
+	for( i = 2; i < argc; i += 2 )
+	{
+		if( (val = nvram_snapshot_get(snap, argv[i])) != NULL )
+		{
+			printf("%s\n", val);
+			stat = 0;
+		}
+		else
+		{
+			stat = 1;
+		}
+	}
+
+	nvram_snapshot_close(snap);
+	return stat;
+}
+
+static void daemon_exit(int sig)
+{
+	nvram_snapshot_remove();
+	_exit(0);
+}
+
+static int do_daemon(void)
+{
+	nvram_handle_t *nvram;
+	uint32_t *gen, generation;
+
+	if( (gen = nvram_snapshot_generation(1)) == NULL )
+	{
+		fprintf(stderr, "Could not create %s\n", NVRAM_SNAPSHOT_GEN);
+		return 1;
+	}
+
+	signal(SIGTERM, daemon_exit);
+	signal(SIGINT, daemon_exit);
+
+	for( ;; )
+	{
+		/* Commits after this point bump the counter and trigger a rebuild */
+		generation = __atomic_load_n(gen, __ATOMIC_SEQ_CST);
+
+		if( (nvram = nvram_open_rdonly()) != NULL )
+		{
+			if( nvram_snapshot_write(nvram, generation) )
+				fprintf(stderr, "Could not write %s\n", NVRAM_SNAPSHOT);
+
+			nvram_close(nvram);
+		}
+
+		nvram_snapshot_wait(gen, generation);
+	}
+
+	return 0;
+}
+
 static int do_unset(nvram_handle_t *nvram, const char *var)
 {
 	return nvram_unset(nvram, var);
@@ -104,6 +177,54 @@ static int do_set(nvram_handle_t *nvram, const char *pair)
 	return stat;
 }
 
+static int do_batch(nvram_handle_t *nvram, FILE *in)
+{
+	char *line = NULL, *cmd, *arg;
+	size_t size = 0;
+	ssize_t len;
+	int lineno = 0;
+	int stat = 0;
+
+	/* One "set variable=value" or "unset variable" per line */
+	while( (len = getline(&line, &size, in)) >= 0 )
+	{
+		lineno++;
+
+		while( len > 0 && (line[len-1] == '\n' || line[len-1] == '\r') )
+			line[--len] = '\0';
+
+		cmd = line + strspn(line, " \t");
+		if( !*cmd || *cmd == '#' )
+			continue;
+
+		arg = cmd + strcspn(cmd, " \t");
+		if( *arg )
+			*arg++ = '\0';
+		arg += strspn(arg, " \t");
+
+		if( !strcmp(cmd, "set") && strchr(arg, '=') )
+		{
+			if( do_set(nvram, arg) )
+			{
+				fprintf(stderr, "Line %i: failed to set '%s'\n", lineno, arg);
+				stat = 1;
+			}
+		}
+		else if( !strcmp(cmd, "unset") && *arg )
+		{
+			do_unset(nvram, arg);
+		}
+		else
+		{
+			fprintf(stderr, "Line %i: invalid command '%s'\n", lineno, cmd);
+			stat = 1;
+		}
+	}
+
+	free(line);
+	return stat;
+}
+
 static int do_info(nvram_handle_t *nvram)
 {
 	nvram_header_t *hdr = nvram_header(nvram);
@@ -142,13 +263,16 @@ static void usage(void)
 		"	nvram get variable\n"
 		"	nvram set variable=value [set ...]\n"
 		"	nvram unset variable [unset ...]\n"
+		"	nvram batch < file (\"set variable=value\" or \"unset variable\" per line)\n"
 		"	nvram commit\n"
+		"	nvram daemon (keep a snapshot in shared memory for get)\n"
 	);
 }
 
 int main( int argc, const char *argv[] )
 {
 	nvram_handle_t *nvram;
+	int batch_stat = 0;
 	int commit = 0;
 	int write = 0;
 	int stat = 1;
@@ -160,9 +284,16 @@ int main( int argc, const char *argv[] )
 		return 1;
 	}
 
+	if( !strcmp(argv[1], "daemon") )
+		return do_daemon();
+
+	if( !strcmp(argv[1], "get") && (stat = do_get_snapshot(argc, argv)) >= 0 )
+		return stat;
+
 	/* Ugly... iterate over arguments to see whether we can expect a write */
 	if( ( !strcmp(argv[1], "set")  && 2 < argc ) ||
 		( !strcmp(argv[1], "unset") && 2 < argc ) ||
+		!strcmp(argv[1], "batch") ||
 		!strcmp(argv[1], "commit") )
 		write = 1;
 
@@ -210,6 +341,11 @@ int main( int argc, const char *argv[] )
 					break;
 				}
 			}
+			else if( !strcmp(argv[i], "batch") )
+			{
+				stat = batch_stat = do_batch(nvram, stdin);
+				done++;
+			}
 			else if( !strcmp(argv[i], "commit") )
 			{
 				commit = 1;
@@ -224,7 +360,7 @@ int main( int argc, const char *argv[] )
 		}
 
 		if( write )
-			stat = nvram_commit(nvram);
+			stat = nvram_commit(nvram) || batch_stat;
 
 		nvram_close(nvram);
 
@@ -26,95 +26,228 @@ size_t nvram_part_size = 0;
  * -- Helper functions --
  */
 
+/* Minimum size of an arena chunk */
+#define NVRAM_ARENA_CHUNK	4096
+
+/* Index slot of an unset variable */
+#define NVRAM_INDEX_DELETED	((uint32_t) -1)
+
+struct nvram_arena {
+	struct nvram_arena *next;
+	size_t len;
+	size_t size;
+	char data[];
+};
+
 /* String hash */
-static uint32_t hash(const char *s)
+static uint32_t hash(const char *s, size_t len)
 {
 	uint32_t hash = 0;
 
-	while (*s)
+	while (len--)
 		hash = 31 * hash + *s++;
 
 	return hash;
 }
 
-/* Free all tuples. */
+/* Free all variables. */
 static void _nvram_free(nvram_handle_t *h)
 {
-	uint32_t i;
-	nvram_tuple_t *t, *next;
-
-	/* Free hash table */
-	for (i = 0; i < NVRAM_ARRAYSIZE(h->nvram_hash); i++) {
-		for (t = h->nvram_hash[i]; t; t = next) {
-			next = t->next;
-			if (t->value)
-				free(t->value);
-			free(t);
-		}
-		h->nvram_hash[i] = NULL;
+	struct nvram_arena *a, *next;
+
+	for (a = h->arena; a; a = next) {
+		next = a->next;
+		free(a);
 	}
 
-	/* Free dead table */
-	for (t = h->nvram_dead; t; t = next) {
-		next = t->next;
-		if (t->value)
-			free(t->value);
-		free(t);
+	free(h->entries);
+	free(h->index);
+
+	h->arena = NULL;
+	h->entries = NULL;
+	h->index = NULL;
+	h->n_entries = h->max_entries = 0;
+	h->index_size = h->index_used = 0;
+}
+
+/* Copy a string into the arena, strings are never moved or freed. */
+static char * _nvram_strdup(nvram_handle_t *h, const char *s, size_t len)
+{
+	struct nvram_arena *a = h->arena;
+	char *p;
+
+	if (!a || a->size - a->len < len + 1) {
+		size_t size = len + 1;
+
+		if (size < NVRAM_ARENA_CHUNK)
+			size = NVRAM_ARENA_CHUNK;
+
+		if (!(a = malloc(sizeof(*a) + size)))
+			return NULL;
+
+		a->len = 0;
+		a->size = size;
+		a->next = h->arena;
+		h->arena = a;
 	}
 
-	h->nvram_dead = NULL;
+	p = &a->data[a->len];
+	memcpy(p, s, len);
+	p[len] = '\0';
+	a->len += len + 1;
+
+	return p;
 }
 
-/* (Re)allocate NVRAM tuples. */
-static nvram_tuple_t * _nvram_realloc( nvram_handle_t *h, nvram_tuple_t *t,
-	const char *name, const char *value )
+/* Look up a variable, return its entry or NULL. If slot is given, it is set
+ * to the index slot of the variable or the slot to insert it at. */
+static struct nvram_entry * _nvram_find(nvram_handle_t *h, const char *name,
+	size_t len, uint32_t hv, uint32_t *slot)
 {
-	if ((strlen(value) + 1) > h->length - h->offset)
+	uint32_t mask = h->index_size - 1;
+	uint32_t i, free_slot = (uint32_t) -1;
+	struct nvram_entry *e;
+
+	if (!h->index_size)
 		return NULL;
 
-	if (!t) {
-		if (!(t = malloc(sizeof(nvram_tuple_t) + strlen(name) + 1)))
-			return NULL;
+	for (i = hv & mask; h->index[i]; i = (i + 1) & mask) {
+		if (h->index[i] == NVRAM_INDEX_DELETED) {
+			if (free_slot == (uint32_t) -1)
+				free_slot = i;
+			continue;
+		}
+
+		e = &h->entries[h->index[i] - 1];
+		if (e->hash == hv && !strncmp(e->name, name, len) && !e->name[len]) {
+			if (slot)
+				*slot = i;
+			return e;
+		}
+	}
+
+	if (slot)
+		*slot = (free_slot != (uint32_t) -1) ? free_slot : i;
+
+	return NULL;
+}
+
+/* Resize the index, dropping deleted slots. */
+static int _nvram_resize(nvram_handle_t *h, uint32_t size)
+{
+	uint32_t *index, i, j, mask = size - 1;
 
-		/* Copy name */
-		t->name = (char *) &t[1];
-		strcpy(t->name, name);
+	if (!(index = calloc(size, sizeof(*index))))
+		return -1;
 
-		t->value = NULL;
+	for (i = 0; i < h->n_entries; i++) {
+		if (!h->entries[i].name)
+			continue;
+
+		for (j = h->entries[i].hash & mask; index[j]; j = (j + 1) & mask);
+		index[j] = i + 1;
 	}
 
-	/* Copy value */
-	if (!t->value || strcmp(t->value, value))
-	{
-		if(!(t->value = (char *) realloc(t->value, strlen(value)+1)))
-			return NULL;
+	free(h->index);
+	h->index = index;
+	h->index_size = size;
+	h->index_used = 0;
+
+	for (i = 0; i < size; i++)
+		if (index[i])
+			h->index_used++;
+
+	return 0;
+}
 
-		strcpy(t->value, value);
-		t->value[strlen(value)] = '\0';
+/* Set a variable from a name of given length. */
+static int _nvram_set(nvram_handle_t *h, const char *name, size_t nlen,
+	const char *value, size_t vlen)
+{
+	struct nvram_entry *e;
+	uint32_t hv = hash(name, nlen);
+	uint32_t slot, size;
+
+	if (vlen + 1 > h->length - h->offset)
+		return -12; /* -ENOMEM */
+
+	if ((e = _nvram_find(h, name, nlen, hv, &slot)) != NULL) {
+		if (!strcmp(e->value, value))
+			return 0;
+
+		if (!(value = _nvram_strdup(h, value, vlen)))
+			return -12;
+
+		e->value = (char *) value;
+		return 0;
 	}
 
-	return t;
+	/* Keep the load factor (including deleted slots) below 3/4 */
+	if ((h->index_used + 1) * 4 > h->index_size * 3) {
+		for (size = h->index_size ? h->index_size : 64;
+		     (h->n_entries + 1) * 2 > size; size *= 2);
+
+		if (_nvram_resize(h, size) < 0)
+			return -12;
+
+		_nvram_find(h, name, nlen, hv, &slot);
+	}
+
+	if (h->n_entries == h->max_entries) {
+		uint32_t max = h->max_entries ? h->max_entries * 2 : 64;
+
+		if (!(e = realloc(h->entries, max * sizeof(*e))))
+			return -12;
+
+		h->entries = e;
+		h->max_entries = max;
+	}
+
+	e = &h->entries[h->n_entries];
+	if (!(e->name = _nvram_strdup(h, name, nlen)) ||
+	    !(e->value = _nvram_strdup(h, value, vlen)))
+		return -12;
+
+	e->hash = hv;
+
+	if (!h->index[slot])
+		h->index_used++;
+	h->index[slot] = ++h->n_entries;
+
+	return 0;
 }
 
-/* (Re)initialize the hash table. */
-static int _nvram_rehash(nvram_handle_t *h)
+/* Parse the variables from flash. */
+static int _nvram_load(nvram_handle_t *h)
 {
 	nvram_header_t *header = nvram_header(h);
-	char buf[] = "0xXXXXXXXX", *name, *value, *eq;
+	char buf[] = "0xXXXXXXXX", *name, *value, *eq, *end;
+	size_t len;
 
 	/* (Re)initialize hash table */
 	_nvram_free(h);
 
-	/* Parse and set "name=value\0 ... \0\0" */
+	/* Size the arena to hold all variables at once */
+	len = header->len;
+	if (len > h->length - h->offset)
+		len = h->length - h->offset;
+
+	if (!(h->arena = malloc(sizeof(*h->arena) + len + NVRAM_ARENA_CHUNK)))
+		return -12;
+
+	h->arena->next = NULL;
+	h->arena->len = 0;
+	h->arena->size = len + NVRAM_ARENA_CHUNK;
+
+	/* Parse "name=value\0 ... \0\0" */
 	name = (char *) &header[1];
+	end = (char *) header + len;
 
-	for (; *name; name = value + strlen(value) + 1) {
+	for (; name < end && *name; name = value + strlen(value) + 1) {
 		if (!(eq = strchr(name, '=')))
 			break;
-		*eq = '\0';
 		value = eq + 1;
-		nvram_set(h, name, value);
-		*eq = '=';
+		_nvram_set(h, name, eq - name, value, strlen(value));
 	}
 
 	/* Set special SDRAM parameters */
@@ -153,80 +286,38 @@ nvram_header_t * nvram_header(nvram_handle_t *h)
 /* Get the value of an NVRAM variable. */
 char * nvram_get(nvram_handle_t *h, const char *name)
 {
-	uint32_t i;
-	nvram_tuple_t *t;
-	char *value;
+	struct nvram_entry *e;
+	size_t len;
 
 	if (!name)
 		return NULL;
 
-	/* Hash the name */
-	i = hash(name) % NVRAM_ARRAYSIZE(h->nvram_hash);
-
-	/* Find the associated tuple in the hash table */
-	for (t = h->nvram_hash[i]; t && strcmp(t->name, name); t = t->next);
+	len = strlen(name);
+	e = _nvram_find(h, name, len, hash(name, len), NULL);
 
-	value = t ? t->value : NULL;
-
-	return value;
+	return e ? e->value : NULL;
 }
 
 /* Set the value of an NVRAM variable. */
 int nvram_set(nvram_handle_t *h, const char *name, const char *value)
 {
-	uint32_t i;
-	nvram_tuple_t *t, *u, **prev;
-
-	/* Hash the name */
-	i = hash(name) % NVRAM_ARRAYSIZE(h->nvram_hash);
-
-	/* Find the associated tuple in the hash table */
-	for (prev = &h->nvram_hash[i], t = *prev;
-		 t && strcmp(t->name, name); prev = &t->next, t = *prev);
-
-	/* (Re)allocate tuple */
-	if (!(u = _nvram_realloc(h, t, name, value)))
-		return -12; /* -ENOMEM */
-
-	/* Value reallocated */
-	if (t && t == u)
-		return 0;
-
-	/* Move old tuple to the dead table */
-	if (t) {
-		*prev = t->next;
-		t->next = h->nvram_dead;
-		h->nvram_dead = t;
-	}
-
-	/* Add new tuple to the hash table */
-	u->next = h->nvram_hash[i];
-	h->nvram_hash[i] = u;
-
-	return 0;
+	return _nvram_set(h, name, strlen(name), value, strlen(value));
 }
 
 /* Unset the value of an NVRAM variable. */
 int nvram_unset(nvram_handle_t *h, const char *name)
 {
-	uint32_t i;
-	nvram_tuple_t *t, **prev;
+	struct nvram_entry *e;
+	uint32_t slot;
+	size_t len;
 
 	if (!name)
 		return 0;
 
-	/* Hash the name */
-	i = hash(name) % NVRAM_ARRAYSIZE(h->nvram_hash);
-
-	/* Find the associated tuple in the hash table */
-	for (prev = &h->nvram_hash[i], t = *prev;
-		 t && strcmp(t->name, name); prev = &t->next, t = *prev);
-
-	/* Move it to the dead table */
-	if (t) {
-		*prev = t->next;
-		t->next = h->nvram_dead;
-		h->nvram_dead = t;
+	len = strlen(name);
+	if ((e = _nvram_find(h, name, len, hash(name, len), &slot)) != NULL) {
+		e->name = NULL;
+		h->index[slot] = NVRAM_INDEX_DELETED;
 	}
 
 	return 0;
@@ -235,24 +326,26 @@ int nvram_unset(nvram_handle_t *h, const char *name)
 /* Get all NVRAM variables. */
 nvram_tuple_t * nvram_getall(nvram_handle_t *h)
 {
-	int i;
-	nvram_tuple_t *t, *l, *x;
+	uint32_t i;
+	nvram_tuple_t *l, *x;
 
 	l = NULL;
 
-	for (i = 0; i < NVRAM_ARRAYSIZE(h->nvram_hash); i++) {
-		for (t = h->nvram_hash[i]; t; t = t->next) {
-			if( (x = (nvram_tuple_t *) malloc(sizeof(nvram_tuple_t))) != NULL )
-			{
-				x->name  = t->name;
-				x->value = t->value;
-				x->next  = l;
-				l = x;
-			}
-			else
-			{
-				break;
-			}
+	/* Build the list backwards to return the variables in file order */
+	for (i = h->n_entries; i-- > 0; ) {
+		if (!h->entries[i].name)
+			continue;
+
+		if( (x = (nvram_tuple_t *) malloc(sizeof(nvram_tuple_t))) != NULL )
+		{
+			x->name  = h->entries[i].name;
+			x->value = h->entries[i].value;
+			x->next  = l;
+			l = x;
+		}
+		else
+		{
+			break;
 		}
 	}
 
@@ -264,9 +357,10 @@ int nvram_commit(nvram_handle_t *h)
 {
 	nvram_header_t *header = nvram_header(h);
 	char *init, *config, *refresh, *ncdl;
-	char *ptr, *end;
-	int i;
-	nvram_tuple_t *t;
+	char *start, *ptr, *end;
+	size_t nlen, vlen;
+	uint32_t i;
+	struct nvram_entry *e;
 	nvram_header_t tmp;
 	uint8_t crc;
 
@@ -288,23 +382,41 @@ int nvram_commit(nvram_handle_t *h)
 		header->config_ncdl = strtoul(ncdl, NULL, 0);
 	}
 
-	/* Clear data area */
-	ptr = (char *) header + sizeof(nvram_header_t);
-	memset(ptr, 0xFF, nvram_part_size - h->offset - sizeof(nvram_header_t));
 	memset(&tmp, 0, sizeof(nvram_header_t));
 
+	/* Little-endian CRC8 over the last 11 bytes of the header */
+	tmp.crc_ver_init   = header->crc_ver_init;
+	tmp.config_refresh = header->config_refresh;
+	tmp.config_ncdl    = header->config_ncdl;
+	crc = hndcrc8((unsigned char *) &tmp + NVRAM_CRC_START_POSITION,
+		sizeof(nvram_header_t) - NVRAM_CRC_START_POSITION, 0xff);
+
 	/* Leave space for a double NUL at the end */
+	start = ptr = (char *) header + sizeof(nvram_header_t);
 	end = (char *) header + nvram_part_size - h->offset - 2;
 
-	/* Write out all tuples */
-	for (i = 0; i < NVRAM_ARRAYSIZE(h->nvram_hash); i++) {
-		for (t = h->nvram_hash[i]; t; t = t->next) {
-			if ((ptr + strlen(t->name) + 1 + strlen(t->value) + 1) > end)
-				break;
-			ptr += sprintf(ptr, "%s=%s", t->name, t->value) + 1;
-		}
+	/* Write out all variables, continuing the CRC8 over the data bytes */
+	for (i = 0; i < h->n_entries; i++) {
+		e = &h->entries[i];
+		if (!e->name)
+			continue;
+
+		nlen = strlen(e->name);
+		vlen = strlen(e->value);
+		if ((ptr + nlen + 1 + vlen + 1) > end)
+			continue;
+
+		memcpy(ptr, e->name, nlen);
+		ptr[nlen] = '=';
+		memcpy(ptr + nlen + 1, e->value, vlen + 1);
+
+		crc = hndcrc8((unsigned char *) ptr, nlen + 1 + vlen + 1, crc);
+		ptr += nlen + 1 + vlen + 1;
 	}
 
+	/* Clear the rest of the data area */
+	memset(ptr, 0xFF, nvram_part_size - h->offset - (ptr - (char *) header));
+
 	/* End with a double NULL and pad to 4 bytes */
 	*ptr = '\0';
 	ptr++;
@@ -317,16 +429,9 @@ int nvram_commit(nvram_handle_t *h)
 	/* Set new length */
 	header->len = NVRAM_ROUNDUP(ptr - (char *) header, 4);
 
-	/* Little-endian CRC8 over the last 11 bytes of the header */
-	tmp.crc_ver_init   = header->crc_ver_init;
-	tmp.config_refresh = header->config_refresh;
-	tmp.config_ncdl    = header->config_ncdl;
-	crc = hndcrc8((unsigned char *) &tmp + NVRAM_CRC_START_POSITION,
-		sizeof(nvram_header_t) - NVRAM_CRC_START_POSITION, 0xff);
-
-	/* Continue CRC8 over data bytes */
-	crc = hndcrc8((unsigned char *) &header[0] + sizeof(nvram_header_t),
-		header->len - sizeof(nvram_header_t), crc);
+	/* Finish the CRC8 over the terminator and padding */
+	crc = hndcrc8((unsigned char *) ptr - 2,
+		header->len - sizeof(nvram_header_t) - (ptr - 2 - start), crc);
 
 	/* Set new CRC8 */
 	header->crc_ver_init |= crc;
@@ -335,8 +440,10 @@ int nvram_commit(nvram_handle_t *h)
 	msync(h->mmap, h->length, MS_SYNC);
 	fsync(h->fd);
 
-	/* Reinitialize hash table */
-	return _nvram_rehash(h);
+	nvram_snapshot_invalidate();
+
+	/* The variables are kept outside of the mapping, no need to reparse */
+	return 0;
 }
 
 /* Open NVRAM and obtain a handle. */
@@ -402,7 +509,7 @@ nvram_handle_t * nvram_open(const char *file, int rdonly)
 
 				if (header->magic == NVRAM_MAGIC &&
 				    (rdonly || header->len < h->length - h->offset)) {
-					_nvram_rehash(h);
+					_nvram_load(h);
 					free(mtd);
 					return h;
 				}
@@ -539,6 +646,8 @@ int staging_to_nvram(void)
 
 			if( !stat )
 				stat = unlink(NVRAM_STAGING) ? 1 : 0;
+
+			nvram_snapshot_invalidate();
 		}
 	}
 
@@ -43,18 +43,38 @@ struct nvram_tuple {
 	struct nvram_tuple *next;
 };
 
+struct nvram_arena;
+
+struct nvram_entry {
+	char *name;		/* NULL if the variable was unset */
+	char *value;
+	uint32_t hash;
+};
+
 struct nvram_handle {
 	int fd;
 	char *mmap;
 	unsigned int length;
 	unsigned int offset;
-	struct nvram_tuple *nvram_hash[257];
-	struct nvram_tuple *nvram_dead;
+
+	/* Strings, never moved until the handle is closed */
+	struct nvram_arena *arena;
+
+	/* Variables in file order, followed by newly set ones */
+	struct nvram_entry *entries;
+	uint32_t n_entries;
+	uint32_t max_entries;
+
+	/* Open addressing index into entries (index + 1, 0 = free) */
+	uint32_t *index;
+	uint32_t index_size;
+	uint32_t index_used;
 };
 
 typedef struct nvram_handle nvram_handle_t;
 typedef struct nvram_header nvram_header_t;
 typedef struct nvram_tuple  nvram_tuple_t;
+typedef struct nvram_snapshot nvram_snapshot_t;
 
 
 /* Get nvram header. */
@@ -102,9 +122,37 @@ int staging_to_nvram(void);
 /* Check NVRAM staging file. */
 char * nvram_find_staging(void);
 
+/* Map the snapshot generation counter, optionally creating it. */
+uint32_t * nvram_snapshot_generation(int create);
+
+/* Invalidate the snapshot after variables were changed. */
+void nvram_snapshot_invalidate(void);
+
+/* Wait until the generation counter differs from the given value. */
+void nvram_snapshot_wait(uint32_t *gen, uint32_t generation);
+
+/* Write a snapshot of all variables for the given generation. */
+int nvram_snapshot_write(nvram_handle_t *h, uint32_t generation);
+
+/* Remove the snapshot and the generation counter. */
+void nvram_snapshot_remove(void);
+
+/* Map the snapshot if it is up to date. */
+nvram_snapshot_t * nvram_snapshot_open(void);
+
+/* Look up a variable in the snapshot. */
+const char * nvram_snapshot_get(nvram_snapshot_t *snap, const char *name);
+
+/* Unmap the snapshot. */
+void nvram_snapshot_close(nvram_snapshot_t *snap);
+
 
 /* Staging file for NVRAM */
 #define NVRAM_STAGING		"/tmp/.nvram"
+
+/* Shared memory snapshot maintained by "nvram daemon" */
+#define NVRAM_SNAPSHOT		"/dev/shm/nvram"
+#define NVRAM_SNAPSHOT_GEN	"/dev/shm/nvram.gen"
 #define NVRAM_RO			1
 #define NVRAM_RW			0
 
@@ -0,0 +1,252 @@
+/*
+ * Shared memory snapshot of NVRAM variables
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * "nvram daemon" keeps a parsed copy of all variables, sorted by name, in
+ * NVRAM_SNAPSHOT. Readers look up variables with a binary search on the
+ * mapping instead of parsing the partition.
+ *
+ * NVRAM_SNAPSHOT_GEN holds a generation counter which is incremented on
+ * every commit. A snapshot is only used if it was built from the current
+ * generation, otherwise readers fall back to parsing NVRAM. The daemon waits
+ * on the counter with a futex and rebuilds the snapshot when it changes.
+ */
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "nvram.h"
+
+#define NVRAM_SNAPSHOT_MAGIC	0x5353564e	/* 'NVSS' */
+
+struct nvram_snapshot_entry {
+	uint32_t name;
+	uint32_t value;
+};
+
+struct nvram_snapshot {
+	uint32_t magic;
+	uint32_t generation;
+	uint32_t count;
+	uint32_t size;
+	struct nvram_snapshot_entry entries[];
+};
+
+static int snapshot_cmp(const void *a, const void *b)
+{
+	const struct nvram_entry *ea = *(const struct nvram_entry **) a;
+	const struct nvram_entry *eb = *(const struct nvram_entry **) b;
+
+	return strcmp(ea->name, eb->name);
+}
+
+static void snapshot_futex(uint32_t *addr, int op, uint32_t val)
+{
+	syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+/* Map the generation counter, optionally creating it. */
+uint32_t * nvram_snapshot_generation(int create)
+{
+	uint32_t *gen;
+	int fd;
+
+	fd = open(NVRAM_SNAPSHOT_GEN, O_RDWR | (create ? O_CREAT : 0), 0644);
+	if (fd < 0)
+		return NULL;
+
+	if (create && ftruncate(fd, sizeof(*gen)) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	gen = mmap(NULL, sizeof(*gen), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	return (gen == MAP_FAILED) ? NULL : gen;
+}
+
+/* Invalidate the snapshot after variables were changed. */
+void nvram_snapshot_invalidate(void)
+{
+	uint32_t *gen = nvram_snapshot_generation(0);
+
+	if (!gen)
+		return;
+
+	__atomic_add_fetch(gen, 1, __ATOMIC_SEQ_CST);
+	snapshot_futex(gen, FUTEX_WAKE, INT_MAX);
+	munmap(gen, sizeof(*gen));
+}
+
+/* Wait until the generation counter differs from the given value. */
+void nvram_snapshot_wait(uint32_t *gen, uint32_t generation)
+{
+	while (__atomic_load_n(gen, __ATOMIC_SEQ_CST) == generation)
+		snapshot_futex(gen, FUTEX_WAIT, generation);
+}
+
+/* Write a snapshot of all variables for the given generation. */
+int nvram_snapshot_write(nvram_handle_t *h, uint32_t generation)
+{
+	struct nvram_entry **sorted;
+	struct nvram_snapshot *snap;
+	char tmp[] = NVRAM_SNAPSHOT ".XXXXXX";
+	uint32_t i, count = 0, size, ofs;
+	size_t nlen, vlen;
+	char *data;
+	int fd, ret = -1;
+
+	if (!(sorted = malloc(h->n_entries * sizeof(*sorted) + 1)))
+		return -1;
+
+	size = sizeof(*snap);
+	for (i = 0; i < h->n_entries; i++) {
+		if (!h->entries[i].name)
+			continue;
+
+		sorted[count++] = &h->entries[i];
+		size += sizeof(struct nvram_snapshot_entry) +
+			strlen(h->entries[i].name) + 1 +
+			strlen(h->entries[i].value) + 1;
+	}
+
+	qsort(sorted, count, sizeof(*sorted), snapshot_cmp);
+
+	if (!(data = malloc(size)))
+		goto out;
+
+	snap = (struct nvram_snapshot *) data;
+	snap->magic = NVRAM_SNAPSHOT_MAGIC;
+	snap->generation = generation;
+	snap->count = count;
+	snap->size = size;
+
+	ofs = sizeof(*snap) + count * sizeof(struct nvram_snapshot_entry);
+	for (i = 0; i < count; i++) {
+		nlen = strlen(sorted[i]->name) + 1;
+		vlen = strlen(sorted[i]->value) + 1;
+
+		snap->entries[i].name = ofs;
+		memcpy(data + ofs, sorted[i]->name, nlen);
+		ofs += nlen;
+
+		snap->entries[i].value = ofs;
+		memcpy(data + ofs, sorted[i]->value, vlen);
+		ofs += vlen;
+	}
+
+	/* Replace the snapshot atomically, readers keep their old mapping */
+	if ((fd = mkstemp(tmp)) < 0)
+		goto out_data;
+
+	if (fchmod(fd, 0644) || write(fd, data, size) != size) {
+		close(fd);
+		unlink(tmp);
+		goto out_data;
+	}
+
+	close(fd);
+
+	if (rename(tmp, NVRAM_SNAPSHOT)) {
+		unlink(tmp);
+		goto out_data;
+	}
+
+	ret = 0;
+
+out_data:
+	free(data);
+out:
+	free(sorted);
+	return ret;
+}
+
+/* Remove the snapshot and the generation counter. */
+void nvram_snapshot_remove(void)
+{
+	unlink(NVRAM_SNAPSHOT);
+	unlink(NVRAM_SNAPSHOT_GEN);
+}
+
+/* Map the snapshot if it is up to date. */
+nvram_snapshot_t * nvram_snapshot_open(void)
+{
+	struct nvram_snapshot *snap;
+	uint32_t generation;
+	struct stat s;
+	int fd, gen_fd;
+
+	if ((gen_fd = open(NVRAM_SNAPSHOT_GEN, O_RDONLY)) < 0)
+		return NULL;
+
+	if (read(gen_fd, &generation, sizeof(generation)) != sizeof(generation)) {
+		close(gen_fd);
+		return NULL;
+	}
+
+	close(gen_fd);
+
+	if ((fd = open(NVRAM_SNAPSHOT, O_RDONLY)) < 0)
+		return NULL;
+
+	if (fstat(fd, &s) || s.st_size < sizeof(*snap)) {
+		close(fd);
+		return NULL;
+	}
+
+	snap = mmap(NULL, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (snap == MAP_FAILED)
+		return NULL;
+
+	if (snap->magic != NVRAM_SNAPSHOT_MAGIC ||
+	    snap->generation != generation ||
+	    snap->size != s.st_size ||
+	    snap->count > (snap->size - sizeof(*snap)) / sizeof(snap->entries[0]) ||
+	    (snap->count && ((char *) snap)[snap->size - 1] != '\0')) {
+		munmap(snap, s.st_size);
+		return NULL;
+	}
+
+	return snap;
+}
+
+/* Look up a variable in the snapshot. */
+const char * nvram_snapshot_get(nvram_snapshot_t *snap, const char *name)
+{
+	const char *data = (const char *) snap;
+	uint32_t lo = 0, hi = snap->count, mid;
+	int cmp;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (snap->entries[mid].name >= snap->size ||
+		    snap->entries[mid].value >= snap->size)
+			return NULL;
+
+		cmp = strcmp(name, data + snap->entries[mid].name);
+		if (!cmp)
+			return data + snap->entries[mid].value;
+
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return NULL;
+}
+
+/* Unmap the snapshot. */
+void nvram_snapshot_close(nvram_snapshot_t *snap)
+{
+	munmap(snap, snap->size);
+}
@@ -0,0 +1,87 @@
+#!/usr/bin/env ucode
+// Compare per-key and batched map operations on a pinned hash map.
+//
+// usage: ucode map-batch.uc <pinned map> <key size> <value size> [entries]
+
+'use strict';
+
+import * as bpf from "bpf";
+import * as struct from "struct";
+
+function usage() {
+	warn("usage: ucode map-batch.uc <pinned map> <key size> <value size> [entries]\n");
+	exit(1);
+}
+
+function now() {
+	let t = clock(true);
+	return t[0] + t[1] / 1000000000.0;
+}
+
+function pad(data, size) {
+	return data + struct.pack(`${size - length(data)}x`);
+}
+
+function report(name, count, start) {
+	let t = now() - start;
+	printf("%-24s %8d entries %10.3f ms %12.0f entries/s\n",
+	       name, count, t * 1000, t > 0 ? count / t : 0);
+}
+
+if (length(ARGV) < 3)
+	usage();
+
+let m = bpf.open_map(ARGV[0]);
+if (!m) {
+	warn(`Failed to open map ${ARGV[0]}: ${bpf.error()}\n`);
+	exit(1);
+}
+
+let key_size = +ARGV[1], val_size = +ARGV[2];
+let n = +(ARGV[3] ?? 10000);
+if (key_size < 4 || val_size < 4 || n <= 0)
+	usage();
+
+let entries = [];
+for (let i = 0; i < n; i++)
+	push(entries, [ pad(struct.pack("<I", i), key_size), pad(struct.pack("<I", i), val_size) ]);
+
+let start;
+
+/* per-key path */
+start = now();
+for (let e in entries)
+	m.set(e[0], e[1]);
+report("set (per key)", n, start);
+
+start = now();
+let count = 0;
+let iter = m.iterator();
+for (let key = iter.next(); key != null; key = iter.next())
+	if (m.get(key) != null)
+		count++;
+report("get (per key)", count, start);
+
+start = now();
+for (let e in entries)
+	m.delete(e[0]);
+report("delete (per key)", n, start);
+
+/* batch path */
+start = now();
+count = m.set_batch(entries);
+report("set_batch", count, start);
+
+start = now();
+count = length(m.get_batch());
+report("get_batch", count, start);
+
+start = now();
+count = m.delete_batch(map(entries, (e) => e[0]));
+report("delete_batch", count, start);
+
+/* delete_all, uses batches transparently */
+m.set_batch(entries);
+start = now();
+m.delete_all();
+report("delete_all", n, start);
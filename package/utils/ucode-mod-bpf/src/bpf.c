@@ -2,6 +2,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <net/if.h>
+#include <linux/if_link.h>
 
 #include <stdint.h>
 #include <stdio.h>
@@ -11,13 +12,25 @@
 #include <bpf/bpf.h>
 #include <bpf/libbpf.h>
 
+#include <libubox/uloop.h>
+
 #include "ucode/module.h"
 
 #define err_return_int(err, ...) do { set_error(err, __VA_ARGS__); return -1; } while(0)
 #define err_return(err, ...) do { set_error(err, __VA_ARGS__); return NULL; } while(0)
 #define TRUE ucv_boolean_new(true)
 
+#ifndef ENOTSUPP
+#define ENOTSUPP 524
+#endif
+
+#define UC_BPF_BATCH_SIZE 256
+#define UC_BPF_BATCH_SIZE_MAX 65536
+#define UC_BPF_RINGBUF_BATCH 64
+#define UC_BPF_PERFBUF_PAGES 8
+
 static uc_resource_type_t *module_type, *map_type, *map_iter_type, *program_type;
+static uc_resource_type_t *ringbuf_type;
 static uc_value_t *registry;
 static uc_vm_t *debug_vm;
 
@@ -31,14 +44,66 @@ struct uc_bpf_fd {
 	bool close;
 };
 
+enum uc_bpf_field_order {
+	FIELD_ORDER_LE,
+	FIELD_ORDER_BE,
+};
+
+struct uc_bpf_field {
+	char *name;
+	unsigned int offset, size;
+	enum uc_bpf_field_order order;
+	bool is_signed;
+	bool raw;
+};
+
+struct uc_bpf_layout {
+	unsigned int refcount;
+	unsigned int size;
+	bool scalar;
+	unsigned int n_fields;
+	struct uc_bpf_field fields[];
+};
+
 struct uc_bpf_map {
 	struct uc_bpf_fd fd; /* must be first */
 	unsigned int key_size, val_size;
+	unsigned int val_stride; /* value size in batch buffers */
+	unsigned int ncpus;
+	enum bpf_map_type type;
+	bool percpu_array;
+	bool no_batch;
+	struct uc_bpf_layout *key_layout, *val_layout;
+};
+
+struct uc_bpf_map_batch {
+	struct uc_bpf_map *map;
+	uint64_t token;
+	__u32 count, size;
+	bool started;
+	bool done;
+	uint8_t *keys;
+	uint8_t *values;
+};
+
+struct uc_bpf_ringbuf {
+	struct uloop_fd fd;
+	uc_vm_t *vm;
+	uc_value_t *res; /* not referenced, only held during consume */
+	struct ring_buffer *rb;
+	struct perf_buffer *pb;
+	struct uc_bpf_layout *layout;
+	uc_value_t *batch;
+	size_t cb_idx;
+	unsigned int batch_size;
+	bool busy, closed, failed;
+	uint64_t records, batches, lost;
 };
 
 struct uc_bpf_map_iter {
 	int fd;
 	unsigned int key_size;
+	struct uc_bpf_layout *key_layout;
 	bool has_next;
 	uint8_t key[];
 };
@@ -187,25 +252,382 @@ uc_bpf_open_module(uc_vm_t *vm, size_t nargs)
 	return uc_resource_new(module_type, obj);
 }
 
+static void uc_bpf_fd_free(void *ptr);
+
+static bool
+uc_bpf_map_type_percpu(enum bpf_map_type type)
+{
+	switch (type) {
+	case BPF_MAP_TYPE_PERCPU_HASH:
+	case BPF_MAP_TYPE_PERCPU_ARRAY:
+	case BPF_MAP_TYPE_LRU_PERCPU_HASH:
+	case BPF_MAP_TYPE_PERCPU_CGROUP_STORAGE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void
+uc_bpf_layout_put(struct uc_bpf_layout *layout)
+{
+	unsigned int i;
+
+	if (!layout || --layout->refcount)
+		return;
+
+	for (i = 0; i < layout->n_fields; i++)
+		free(layout->fields[i].name);
+	free(layout);
+}
+
+static struct uc_bpf_layout *
+uc_bpf_layout_get(struct uc_bpf_layout *layout)
+{
+	if (layout)
+		layout->refcount++;
+
+	return layout;
+}
+
+/*
+ * Field types: u8, u16, u32, u64, s8, s16, s32, s64 in host byte order,
+ * optionally followed by "le" or "be", or raw:<len> for opaque bytes.
+ */
+static bool
+uc_bpf_field_parse(struct uc_bpf_field *field, const char *type)
+{
+	unsigned long len;
+	char *end;
+
+	if (!strncmp(type, "raw:", 4)) {
+		len = strtoul(type + 4, &end, 0);
+		if (*end || !len || len > 0xffff)
+			return false;
+
+		field->raw = true;
+		field->size = len;
+		return true;
+	}
+
+	if (type[0] != 'u' && type[0] != 's')
+		return false;
+
+	field->is_signed = type[0] == 's';
+	len = strtoul(type + 1, &end, 10);
+	if (len != 8 && len != 16 && len != 32 && len != 64)
+		return false;
+
+	field->size = len / 8;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	field->order = FIELD_ORDER_BE;
+#else
+	field->order = FIELD_ORDER_LE;
+#endif
+	if (!strcmp(end, "le"))
+		field->order = FIELD_ORDER_LE;
+	else if (!strcmp(end, "be"))
+		field->order = FIELD_ORDER_BE;
+	else if (*end)
+		return false;
+
+	return true;
+}
+
+static struct uc_bpf_layout *
+uc_bpf_layout_parse(uc_value_t *val, const char *kind, unsigned int size)
+{
+	struct uc_bpf_layout *layout;
+	struct uc_bpf_field *field;
+	unsigned int offset = 0, align = 1, n = 1;
+
+	if (ucv_type(val) == UC_OBJECT)
+		n = ucv_object_length(val);
+	else if (ucv_type(val) != UC_STRING)
+		err_return(EINVAL, "%s layout type", kind);
+
+	layout = xalloc(sizeof(*layout) + n * sizeof(layout->fields[0]));
+	layout->refcount = 1;
+
+	if (ucv_type(val) == UC_STRING) {
+		layout->scalar = true;
+		layout->n_fields = 1;
+		if (!uc_bpf_field_parse(&layout->fields[0], ucv_string_get(val)))
+			goto error;
+
+		offset = layout->fields[0].size;
+		goto out;
+	}
+
+	ucv_object_foreach(val, name, type) {
+		field = &layout->fields[layout->n_fields++];
+		field->name = xstrdup(name);
+
+		if (ucv_type(type) != UC_STRING ||
+		    !uc_bpf_field_parse(field, ucv_string_get(type)))
+			goto error;
+
+		/* natural alignment, as in a C struct */
+		if (!field->raw) {
+			offset = (offset + field->size - 1) & ~(field->size - 1);
+			if (field->size > align)
+				align = field->size;
+		}
+
+		field->offset = offset;
+		offset += field->size;
+	}
+
+	/* accept both packed and tail-padded structs */
+	if (size && offset != size)
+		offset = (offset + align - 1) & ~(align - 1);
+
+out:
+	layout->size = offset;
+	if (size && offset != size) {
+		uc_bpf_layout_put(layout);
+		err_return(EINVAL, "%s layout size %u does not match %u", kind, offset, size);
+	}
+
+	return layout;
+
+error:
+	uc_bpf_layout_put(layout);
+	err_return(EINVAL, "%s layout field type", kind);
+}
+
+static uint64_t
+uc_bpf_field_load(const struct uc_bpf_field *field, const uint8_t *data)
+{
+	uint64_t val = 0;
+	unsigned int i;
+
+	data += field->offset;
+	for (i = 0; i < field->size; i++) {
+		if (field->order == FIELD_ORDER_BE)
+			val = (val << 8) | data[i];
+		else
+			val |= (uint64_t)data[i] << (8 * i);
+	}
+
+	/* sign extend */
+	if (field->is_signed && field->size < 8 &&
+	    (val & (1ULL << (field->size * 8 - 1))))
+		val |= ~0ULL << (field->size * 8);
+
+	return val;
+}
+
+static void
+uc_bpf_field_store(const struct uc_bpf_field *field, uint8_t *data, uint64_t val)
+{
+	unsigned int i;
+
+	data += field->offset;
+	for (i = 0; i < field->size; i++) {
+		if (field->order == FIELD_ORDER_BE)
+			data[field->size - 1 - i] = val >> (8 * i);
+		else
+			data[i] = val >> (8 * i);
+	}
+}
+
+/*
+ * Decode n copies of a layout spaced stride bytes apart (per-CPU values).
+ * Integer fields are summed, raw fields are taken from the first copy.
+ */
+static uc_value_t *
+uc_bpf_layout_decode(uc_vm_t *vm, const struct uc_bpf_layout *layout,
+		     const uint8_t *data, unsigned int stride, unsigned int n)
+{
+	const struct uc_bpf_field *field;
+	uc_value_t *rv = NULL, *fval;
+	unsigned int i, cpu;
+	uint64_t sum;
+
+	if (!layout->scalar)
+		rv = ucv_object_new(vm);
+
+	for (i = 0; i < layout->n_fields; i++) {
+		field = &layout->fields[i];
+
+		if (field->raw) {
+			fval = ucv_string_new_length((const char *)data + field->offset,
+						     field->size);
+		} else {
+			for (cpu = 0, sum = 0; cpu < n; cpu++)
+				sum += uc_bpf_field_load(field, data + cpu * stride);
+
+			if (field->is_signed)
+				fval = ucv_int64_new((int64_t)sum);
+			else
+				fval = ucv_uint64_new(sum);
+		}
+
+		if (layout->scalar)
+			return fval;
+
+		ucv_object_add(rv, field->name, fval);
+	}
+
+	return rv;
+}
+
+static bool
+uc_bpf_layout_encode(const struct uc_bpf_layout *layout, uc_value_t *val,
+		     const char *kind, uint8_t *data)
+{
+	const struct uc_bpf_field *field;
+	uc_value_t *fval;
+	unsigned int i;
+
+	if (layout->scalar ? ucv_type(val) == UC_OBJECT : ucv_type(val) != UC_OBJECT) {
+		set_error(EINVAL, "%s type", kind);
+		return false;
+	}
+
+	memset(data, 0, layout->size);
+	for (i = 0; i < layout->n_fields; i++) {
+		field = &layout->fields[i];
+		fval = layout->scalar ? val : ucv_object_get(val, field->name, NULL);
+		if (!fval)
+			continue;
+
+		if (field->raw) {
+			if (ucv_type(fval) != UC_STRING ||
+			    ucv_string_length(fval) != field->size) {
+				set_error(EINVAL, "%s field %s", kind,
+					  field->name ? field->name : "value");
+				return false;
+			}
+
+			memcpy(data + field->offset, ucv_string_get(fval), field->size);
+			continue;
+		}
+
+		if (ucv_type(fval) != UC_INTEGER) {
+			set_error(EINVAL, "%s field %s", kind,
+				  field->name ? field->name : "value");
+			return false;
+		}
+
+		uc_bpf_field_store(field, data,
+				   field->is_signed ? (uint64_t)ucv_int64_get(fval) :
+						      ucv_uint64_get(fval));
+	}
+
+	return true;
+}
+
+static int
+uc_bpf_map_set_layout(struct uc_bpf_map *map, uc_value_t *layout)
+{
+	struct uc_bpf_layout *key = NULL, *val = NULL;
+	uc_value_t *l_key, *l_val, *percpu;
+
+	if (!layout)
+		return 0;
+
+	if (ucv_type(layout) != UC_OBJECT)
+		err_return_int(EINVAL, "layout argument");
+
+	l_key = ucv_object_get(layout, "key", NULL);
+	l_val = ucv_object_get(layout, "value", NULL);
+	percpu = ucv_object_get(layout, "percpu", NULL);
+
+	if (percpu && (ucv_type(percpu) != UC_STRING ||
+		       (strcmp(ucv_string_get(percpu), "sum") &&
+			strcmp(ucv_string_get(percpu), "array"))))
+		err_return_int(EINVAL, "percpu mode");
+
+	if (l_key && !(key = uc_bpf_layout_parse(l_key, "key", map->key_size)))
+		return -1;
+
+	if (l_val && !(val = uc_bpf_layout_parse(l_val, "value", map->val_size))) {
+		uc_bpf_layout_put(key);
+		return -1;
+	}
+
+	uc_bpf_layout_put(map->key_layout);
+	uc_bpf_layout_put(map->val_layout);
+	map->key_layout = key;
+	map->val_layout = val;
+	map->percpu_array = percpu && !strcmp(ucv_string_get(percpu), "array");
+
+	return 0;
+}
+
+static uc_value_t *
+uc_bpf_map_key_value(uc_vm_t *vm, struct uc_bpf_map *map, const void *key)
+{
+	if (map->key_layout)
+		return uc_bpf_layout_decode(vm, map->key_layout, key, 0, 1);
+
+	return ucv_string_new_length(key, map->key_size);
+}
+
+static uc_value_t *
+uc_bpf_map_val_value(uc_vm_t *vm, struct uc_bpf_map *map, const void *val)
+{
+	unsigned int stride = (map->val_size + 7) & ~7;
+	unsigned int cpu;
+	uc_value_t *rv;
+
+	if (!map->val_layout)
+		return ucv_string_new_length(val, map->val_stride);
+
+	if (map->ncpus <= 1)
+		return uc_bpf_layout_decode(vm, map->val_layout, val, 0, 1);
+
+	if (!map->percpu_array)
+		return uc_bpf_layout_decode(vm, map->val_layout, val, stride,
+					    map->ncpus);
+
+	rv = ucv_array_new_length(vm, map->ncpus);
+	for (cpu = 0; cpu < map->ncpus; cpu++)
+		ucv_array_push(rv, uc_bpf_layout_decode(vm, map->val_layout,
+						       (const uint8_t *)val + cpu * stride,
+						       0, 1));
+
+	return rv;
+}
+
 static uc_value_t *
-uc_bpf_map_create(int fd, unsigned int key_size, unsigned int val_size, bool close)
+uc_bpf_map_create(int fd, enum bpf_map_type type, unsigned int key_size,
+		  unsigned int val_size, bool close, uc_value_t *layout)
 {
 	struct uc_bpf_map *uc_map;
+	int ncpus;
 
 	uc_map = xalloc(sizeof(*uc_map));
 	uc_map->fd.fd = fd;
 	uc_map->key_size = key_size;
 	uc_map->val_size = val_size;
+	uc_map->val_stride = val_size;
+	uc_map->ncpus = 1;
+	uc_map->type = type;
 	uc_map->fd.close = close;
 
+	ncpus = libbpf_num_possible_cpus();
+	if (uc_bpf_map_type_percpu(type) && ncpus > 0) {
+		uc_map->ncpus = ncpus;
+		uc_map->val_stride = ((val_size + 7) & ~7) * ncpus;
+	}
+
+	if (uc_bpf_map_set_layout(uc_map, layout)) {
+		uc_bpf_fd_free(uc_map);
+		return NULL;
+	}
+
 	return uc_resource_new(map_type, uc_map);
 }
 
 static uc_value_t *
 uc_bpf_open_map(uc_vm_t *vm, size_t nargs)
 {
-	struct bpf_map_info info;
+	struct bpf_map_info info = {};
 	uc_value_t *path = uc_fn_arg(0);
+	uc_value_t *layout = uc_fn_arg(1);
 	__u32 len = sizeof(info);
 	int err;
 	int fd;
@@ -223,7 +645,8 @@ uc_bpf_open_map(uc_vm_t *vm, size_t nargs)
 		err_return(errno, NULL);
 	}
 
-	return uc_bpf_map_create(fd, info.key_size, info.value_size, true);
+	return uc_bpf_map_create(fd, info.type, info.key_size, info.value_size,
+				 true, layout);
 }
 
 static uc_value_t *
@@ -271,6 +694,7 @@ uc_bpf_module_get_map(uc_vm_t *vm, size_t nargs)
 	struct bpf_object *obj = uc_fn_thisval("bpf.module");
 	struct bpf_map *map;
 	uc_value_t *name = uc_fn_arg(0);
+	uc_value_t *layout = uc_fn_arg(1);
 	int fd;
 
 	if (!obj || ucv_type(name) != UC_STRING)
@@ -284,7 +708,8 @@ uc_bpf_module_get_map(uc_vm_t *vm, size_t nargs)
 	if (fd < 0)
 		err_return(EINVAL, NULL);
 
-	return uc_bpf_map_create(fd, bpf_map__key_size(map), bpf_map__value_size(map), false);
+	return uc_bpf_map_create(fd, bpf_map__type(map), bpf_map__key_size(map),
+				 bpf_map__value_size(map), false, layout);
 }
 
 static uc_value_t *
@@ -361,6 +786,173 @@ uc_bpf_map_arg(uc_value_t *val, const char *kind, unsigned int size)
 	err_return(EINVAL, "%s size mismatch (expected: %d)", kind, size);
 }
 
+static void *
+uc_bpf_map_key_arg(struct uc_bpf_map *map, uc_value_t *val, void *buf)
+{
+	void *data;
+
+	if (map->key_layout && ucv_type(val) != UC_STRING)
+		return uc_bpf_layout_encode(map->key_layout, val, "key", buf) ? buf : NULL;
+
+	data = uc_bpf_map_arg(val, "key", map->key_size);
+	if (!data)
+		return NULL;
+
+	memcpy(buf, data, map->key_size);
+
+	return buf;
+}
+
+/*
+ * buf must hold val_stride bytes. For per-CPU maps, a single value is
+ * stored for the first CPU and the remaining CPUs are cleared.
+ */
+static void *
+uc_bpf_map_val_arg(struct uc_bpf_map *map, uc_value_t *val, void *buf)
+{
+	void *data;
+
+	memset(buf, 0, map->val_stride);
+
+	if (map->val_layout && ucv_type(val) != UC_STRING)
+		return uc_bpf_layout_encode(map->val_layout, val, "value", buf) ? buf : NULL;
+
+	if (ucv_type(val) == UC_STRING && ucv_string_length(val) == map->val_stride) {
+		memcpy(buf, ucv_string_get(val), map->val_stride);
+		return buf;
+	}
+
+	data = uc_bpf_map_arg(val, "value", map->val_size);
+	if (!data)
+		return NULL;
+
+	memcpy(buf, data, map->val_size);
+
+	return buf;
+}
+
+static bool
+uc_bpf_batch_unsupported(int err)
+{
+	return err == EINVAL || err == ENOTSUPP || err == EOPNOTSUPP;
+}
+
+static void
+uc_bpf_map_batch_init(struct uc_bpf_map_batch *batch, struct uc_bpf_map *map)
+{
+	memset(batch, 0, sizeof(*batch));
+	batch->map = map;
+	batch->size = UC_BPF_BATCH_SIZE;
+	batch->keys = xalloc(batch->size * map->key_size);
+	batch->values = xalloc(batch->size * map->val_stride);
+}
+
+static void
+uc_bpf_map_batch_free(struct uc_bpf_map_batch *batch)
+{
+	free(batch->keys);
+	free(batch->values);
+}
+
+/* Make room for a hash bucket with more entries than the chunk size */
+static bool
+uc_bpf_map_batch_grow(struct uc_bpf_map_batch *batch)
+{
+	struct uc_bpf_map *map = batch->map;
+
+	if (batch->size >= UC_BPF_BATCH_SIZE_MAX)
+		return false;
+
+	batch->size *= 2;
+	batch->keys = xrealloc(batch->keys, batch->size * map->key_size);
+	batch->values = xrealloc(batch->values, batch->size * map->val_stride);
+
+	return true;
+}
+
+/*
+ * Fetch the next chunk of keys/values using BPF_MAP_LOOKUP_BATCH.
+ * Returns the number of entries fetched, 0 at the end of the map, -1 if
+ * the kernel or map type does not support batch operations, or -2 with
+ * the error set if the walk failed part way.
+ */
+static int
+uc_bpf_map_batch_next(struct uc_bpf_map_batch *batch)
+{
+	struct uc_bpf_map *map = batch->map;
+	int ret;
+
+	if (batch->done || map->no_batch)
+		return map->no_batch ? -1 : 0;
+
+	do {
+		batch->count = batch->size;
+		ret = bpf_map_lookup_batch(map->fd.fd,
+					   batch->started ? &batch->token : NULL,
+					   &batch->token, batch->keys, batch->values,
+					   &batch->count, NULL);
+	} while (ret < 0 && ((errno == ENOSPC && uc_bpf_map_batch_grow(batch)) ||
+			     errno == EINTR));
+
+	if (ret < 0) {
+		if (errno != ENOENT) {
+			batch->done = true;
+
+			if (!batch->started && uc_bpf_batch_unsupported(errno)) {
+				map->no_batch = true;
+				return -1;
+			}
+
+			set_error(errno, NULL);
+			return -2;
+		}
+
+		batch->done = true;
+	}
+
+	batch->started = true;
+
+	return batch->count;
+}
+
+/*
+ * Delete the given keys, returns the number of keys deleted or -1 with the
+ * error set. Keys which are already gone are skipped.
+ */
+static int
+uc_bpf_map_delete_keys(struct uc_bpf_map *map, const uint8_t *keys, __u32 count)
+{
+	__u32 i = 0, n = count;
+
+	if (!count)
+		return 0;
+
+	if (!map->no_batch) {
+		if (!bpf_map_delete_batch(map->fd.fd, keys, &n, NULL))
+			return n;
+
+		if (uc_bpf_batch_unsupported(errno)) {
+			/* older kernels without batch support: retry per key */
+			map->no_batch = true;
+			n = 0;
+		} else {
+			/* the kernel stops at the first failing key */
+			i = n;
+		}
+	} else {
+		n = 0;
+	}
+
+	for (; i < count; i++) {
+		if (!bpf_map_delete_elem(map->fd.fd, keys + i * map->key_size))
+			n++;
+		else if (errno != ENOENT)
+			err_return_int(errno, NULL);
+	}
+
+	return n;
+}
+
 static uc_value_t *
 uc_bpf_map_get(uc_vm_t *vm, size_t nargs)
 {
@@ -371,15 +963,15 @@ uc_bpf_map_get(uc_vm_t *vm, size_t nargs)
 	if (!map)
 		err_return(EINVAL, NULL);
 
-	key = uc_bpf_map_arg(a_key, "key", map->key_size);
+	key = uc_bpf_map_key_arg(map, a_key, alloca(map->key_size));
 	if (!key)
 		return NULL;
 
-	val = alloca(map->val_size);
+	val = alloca(map->val_stride);
 	if (bpf_map_lookup_elem(map->fd.fd, key, val))
 		return NULL;
 
-	return ucv_string_new_length(val, map->val_size);
+	return uc_bpf_map_val_value(vm, map, val);
 }
 
 static uc_value_t *
@@ -395,11 +987,11 @@ uc_bpf_map_set(uc_vm_t *vm, size_t nargs)
 	if (!map)
 		err_return(EINVAL, NULL);
 
-	key = uc_bpf_map_arg(a_key, "key", map->key_size);
+	key = uc_bpf_map_key_arg(map, a_key, alloca(map->key_size));
 	if (!key)
 		return NULL;
 
-	val = uc_bpf_map_arg(a_val, "value", map->val_size);
+	val = uc_bpf_map_val_arg(map, a_val, alloca(map->val_stride));
 	if (!val)
 		return NULL;
 
@@ -413,7 +1005,7 @@ uc_bpf_map_set(uc_vm_t *vm, size_t nargs)
 	if (bpf_map_update_elem(map->fd.fd, key, val, flags))
 		return NULL;
 
-	return ucv_string_new_length(val, map->val_size);
+	return uc_bpf_map_val_value(vm, map, val);
 }
 
 static uc_value_t *
@@ -428,7 +1020,7 @@ uc_bpf_map_delete(uc_vm_t *vm, size_t nargs)
 	if (!map)
 		err_return(EINVAL, NULL);
 
-	key = uc_bpf_map_arg(a_key, "key", map->key_size);
+	key = uc_bpf_map_key_arg(map, a_key, alloca(map->key_size));
 	if (!key)
 		return NULL;
 
@@ -438,11 +1030,36 @@ uc_bpf_map_delete(uc_vm_t *vm, size_t nargs)
 		return ucv_boolean_new(ret == 0);
 	}
 
-	val = alloca(map->val_size);
+	val = alloca(map->val_stride);
 	if (bpf_map_lookup_and_delete_elem(map->fd.fd, key, val))
 		return NULL;
 
-	return ucv_string_new_length(val, map->val_size);
+	return uc_bpf_map_val_value(vm, map, val);
+}
+
+static bool
+uc_bpf_map_filter(uc_vm_t *vm, uc_value_t *filter, struct uc_bpf_map *map,
+		  const void *key, bool *skip)
+{
+	uc_value_t *rv;
+
+	*skip = false;
+	if (!ucv_is_callable(filter))
+		return true;
+
+	uc_value_push(ucv_get(filter));
+	uc_value_push(uc_bpf_map_key_value(vm, map, key));
+	if (uc_call(1) != EXCEPTION_NONE)
+		return false;
+
+	rv = uc_vm_stack_pop(vm);
+	if (!rv)
+		return false;
+
+	*skip = !ucv_is_truish(rv);
+	ucv_put(rv);
+
+	return true;
 }
 
 static uc_value_t *
@@ -450,83 +1067,575 @@ uc_bpf_map_delete_all(uc_vm_t *vm, size_t nargs)
 {
 	struct uc_bpf_map *map = uc_fn_thisval("bpf.map");
 	uc_value_t *filter = uc_fn_arg(0);
-	bool has_next;
+	struct uc_bpf_map_batch batch;
+	bool has_next, skip;
 	void *key, *next;
+	int i, n, count;
 
 	if (!map)
 		err_return(EINVAL, NULL);
 
+	uc_bpf_map_batch_init(&batch, map);
+	while ((count = uc_bpf_map_batch_next(&batch)) > 0) {
+		for (i = 0, n = 0; i < count; i++) {
+			key = batch.keys + i * map->key_size;
+			if (!uc_bpf_map_filter(vm, filter, map, key, &skip)) {
+				uc_bpf_map_batch_free(&batch);
+				return TRUE;
+			}
+
+			if (skip)
+				continue;
+
+			if (n != i)
+				memcpy(batch.keys + n * map->key_size, key, map->key_size);
+			n++;
+		}
+
+		if (uc_bpf_map_delete_keys(map, batch.keys, n) < 0) {
+			uc_bpf_map_batch_free(&batch);
+			return NULL;
+		}
+	}
+	uc_bpf_map_batch_free(&batch);
+
+	if (count == 0)
+		return TRUE;
+	else if (count < -1)
+		return NULL;
+
 	key = alloca(map->key_size);
 	next = alloca(map->key_size);
 	has_next = !bpf_map_get_next_key(map->fd.fd, NULL, next);
 	while (has_next) {
-		bool skip = false;
-
 		memcpy(key, next, map->key_size);
 		has_next = !bpf_map_get_next_key(map->fd.fd, next, next);
 
-		if (ucv_is_callable(filter)) {
-			uc_value_t *rv;
-
-			uc_value_push(ucv_get(filter));
-			uc_value_push(ucv_string_new_length((const char *)key, map->key_size));
-			if (uc_call(1) != EXCEPTION_NONE)
-				break;
-
-			rv = uc_vm_stack_pop(vm);
-			if (!rv)
-				break;
-
-			skip = !ucv_is_truish(rv);
-			ucv_put(rv);
-		}
+		if (!uc_bpf_map_filter(vm, filter, map, key, &skip))
+			break;
 
-		if (!skip)
-			bpf_map_delete_elem(map->fd.fd, key);
+		if (!skip && bpf_map_delete_elem(map->fd.fd, key) && errno != ENOENT)
+			err_return(errno, NULL);
 	}
 
 	return TRUE;
 }
 
 static uc_value_t *
-uc_bpf_map_iterator(uc_vm_t *vm, size_t nargs)
+uc_bpf_map_get_batch(uc_vm_t *vm, size_t nargs)
 {
 	struct uc_bpf_map *map = uc_fn_thisval("bpf.map");
-	struct uc_bpf_map_iter *iter;
+	uc_value_t *a_max = uc_fn_arg(0);
+	struct uc_bpf_map_batch batch;
+	uc_value_t *rv, *entry;
+	size_t max = 0, len = 0;
+	bool has_next;
+	void *key, *val;
+	int i, count;
 
 	if (!map)
 		err_return(EINVAL, NULL);
 
-	iter = xalloc(sizeof(*iter) + map->key_size);
-	iter->fd = map->fd.fd;
-	iter->key_size = map->key_size;
-	iter->has_next = !bpf_map_get_next_key(iter->fd, NULL, &iter->key);
+	if (a_max) {
+		if (ucv_type(a_max) != UC_INTEGER || ucv_int64_get(a_max) < 0)
+			err_return(EINVAL, "max");
 
-	return uc_resource_new(map_iter_type, iter);
-}
+		max = ucv_int64_get(a_max);
+	}
 
-static uc_value_t *
-uc_bpf_map_iter_next(uc_vm_t *vm, size_t nargs)
-{
-	struct uc_bpf_map_iter *iter = uc_fn_thisval("bpf.map_iter");
-	uc_value_t *rv;
+	rv = ucv_array_new(vm);
 
-	if (!iter->has_next)
+	uc_bpf_map_batch_init(&batch, map);
+	while ((count = uc_bpf_map_batch_next(&batch)) > 0) {
+		for (i = 0; i < count && (!max || len < max); i++) {
+			entry = ucv_array_new_length(vm, 2);
+			ucv_array_push(entry, uc_bpf_map_key_value(vm, map,
+				batch.keys + i * map->key_size));
+			ucv_array_push(entry, uc_bpf_map_val_value(vm, map,
+				batch.values + i * map->val_stride));
+			ucv_array_set(rv, len++, entry);
+		}
+
+		if (max && len >= max)
+			break;
+	}
+	uc_bpf_map_batch_free(&batch);
+
+	if (count < -1) {
+		ucv_put(rv);
 		return NULL;
+	}
 
-	rv = ucv_string_new_length((const char *)iter->key, iter->key_size);
-	iter->has_next = !bpf_map_get_next_key(iter->fd, &iter->key, &iter->key);
+	if (count >= 0)
+		return rv;
+
+	key = alloca(map->key_size);
+	val = alloca(map->val_stride);
+	has_next = !bpf_map_get_next_key(map->fd.fd, NULL, key);
+	while (has_next && (!max || len < max)) {
+		if (!bpf_map_lookup_elem(map->fd.fd, key, val)) {
+			entry = ucv_array_new_length(vm, 2);
+			ucv_array_push(entry, uc_bpf_map_key_value(vm, map, key));
+			ucv_array_push(entry, uc_bpf_map_val_value(vm, map, val));
+			ucv_array_set(rv, len++, entry);
+		}
+
+		has_next = !bpf_map_get_next_key(map->fd.fd, key, key);
+	}
 
 	return rv;
 }
 
 static uc_value_t *
-uc_bpf_map_iter_next_int(uc_vm_t *vm, size_t nargs)
+uc_bpf_map_set_batch(uc_vm_t *vm, size_t nargs)
 {
-	struct uc_bpf_map_iter *iter = uc_fn_thisval("bpf.map_iter");
-	uint64_t intval;
-	uc_value_t *rv;
-
+	struct uc_bpf_map *map = uc_fn_thisval("bpf.map");
+	uc_value_t *entries = uc_fn_arg(0);
+	uc_value_t *a_flags = uc_fn_arg(1);
+	DECLARE_LIBBPF_OPTS(bpf_map_batch_opts, opts);
+	uint8_t *keys, *values;
+	size_t i, len, done = 0;
+	__u32 count;
+
+	if (!map || ucv_type(entries) != UC_ARRAY)
+		err_return(EINVAL, NULL);
+
+	if (!a_flags)
+		opts.elem_flags = BPF_ANY;
+	else if (ucv_type(a_flags) != UC_INTEGER)
+		err_return(EINVAL, "flags");
+	else
+		opts.elem_flags = ucv_int64_get(a_flags);
+
+	len = ucv_array_length(entries);
+	keys = xalloc(len * map->key_size + 1);
+	values = xalloc(len * map->val_stride + 1);
+	for (i = 0; i < len; i++) {
+		uc_value_t *entry = ucv_array_get(entries, i);
+
+		if (ucv_type(entry) != UC_ARRAY || ucv_array_length(entry) != 2) {
+			set_error(EINVAL, "entry %zu", i);
+			goto out;
+		}
+
+		if (!uc_bpf_map_key_arg(map, ucv_array_get(entry, 0),
+					keys + i * map->key_size) ||
+		    !uc_bpf_map_val_arg(map, ucv_array_get(entry, 1),
+					values + i * map->val_stride))
+			goto out;
+	}
+
+	if (!map->no_batch && len) {
+		count = len;
+		if (!bpf_map_update_batch(map->fd.fd, keys, values, &count, &opts)) {
+			done = count;
+			goto out;
+		}
+
+		if (!uc_bpf_batch_unsupported(errno)) {
+			set_error(errno, "entry %u", count);
+			goto out;
+		}
+
+		map->no_batch = true;
+	}
+
+	for (i = 0; i < len; i++) {
+		if (bpf_map_update_elem(map->fd.fd, keys + i * map->key_size,
+					values + i * map->val_stride, opts.elem_flags)) {
+			set_error(errno, "entry %zu", i);
+			goto out;
+		}
+	}
+	done = len;
+
+out:
+	free(keys);
+	free(values);
+
+	/* a partial update is an error, entries before it were written */
+	if (done < len)
+		return NULL;
+
+	return ucv_int64_new(done);
+}
+
+static uc_value_t *
+uc_bpf_map_delete_batch(uc_vm_t *vm, size_t nargs)
+{
+	struct uc_bpf_map *map = uc_fn_thisval("bpf.map");
+	uc_value_t *a_keys = uc_fn_arg(0);
+	uint8_t *keys;
+	size_t i, len;
+	int ret;
+
+	if (!map || ucv_type(a_keys) != UC_ARRAY)
+		err_return(EINVAL, NULL);
+
+	len = ucv_array_length(a_keys);
+	keys = xalloc(len * map->key_size + 1);
+	for (i = 0; i < len; i++) {
+		if (!uc_bpf_map_key_arg(map, ucv_array_get(a_keys, i),
+					keys + i * map->key_size)) {
+			free(keys);
+			return NULL;
+		}
+	}
+
+	ret = uc_bpf_map_delete_keys(map, keys, len);
+	free(keys);
+
+	if (ret < 0)
+		return NULL;
+
+	return ucv_int64_new(ret);
+}
+
+static uc_value_t *
+uc_bpf_map_layout(uc_vm_t *vm, size_t nargs)
+{
+	struct uc_bpf_map *map = uc_fn_thisval("bpf.map");
+	uc_value_t *layout = uc_fn_arg(0);
+
+	if (!map)
+		err_return(EINVAL, NULL);
+
+	if (uc_bpf_map_set_layout(map, layout))
+		return NULL;
+
+	return TRUE;
+}
+
+static size_t
+uc_bpf_registry_add(uc_value_t *val)
+{
+	size_t i, len = ucv_array_length(registry);
+
+	/* slot 0 is reserved for the debug handler */
+	for (i = 1; i < len; i++)
+		if (!ucv_array_get(registry, i))
+			break;
+
+	ucv_array_set(registry, i, ucv_get(val));
+
+	return i;
+}
+
+static void
+uc_bpf_ringbuf_flush(struct uc_bpf_ringbuf *rb)
+{
+	uc_vm_t *vm = rb->vm;
+	uc_value_t *batch = rb->batch;
+
+	if (!batch)
+		return;
+
+	rb->batch = NULL;
+	rb->batches++;
+
+	uc_vm_stack_push(vm, ucv_get(ucv_array_get(registry, rb->cb_idx)));
+	uc_vm_stack_push(vm, batch);
+	if (uc_vm_call(vm, false, 1) != EXCEPTION_NONE) {
+		/* leave the exception pending, no more callbacks until it is raised */
+		rb->failed = true;
+		return;
+	}
+
+	ucv_put(uc_vm_stack_pop(vm));
+}
+
+static void
+uc_bpf_ringbuf_add(struct uc_bpf_ringbuf *rb, const void *data, size_t size)
+{
+	uc_value_t *rec;
+
+	if (rb->closed)
+		return;
+
+	if (rb->failed) {
+		rb->lost++;
+		return;
+	}
+
+	if (rb->layout && size >= rb->layout->size)
+		rec = uc_bpf_layout_decode(rb->vm, rb->layout, data, 0, 1);
+	else
+		rec = ucv_string_new_length(data, size);
+
+	if (!rb->batch)
+		rb->batch = ucv_array_new(rb->vm);
+
+	ucv_array_push(rb->batch, rec);
+	rb->records++;
+
+	if (ucv_array_length(rb->batch) >= rb->batch_size)
+		uc_bpf_ringbuf_flush(rb);
+}
+
+static int
+uc_bpf_ringbuf_sample(void *ctx, void *data, size_t size)
+{
+	struct uc_bpf_ringbuf *rb = ctx;
+
+	uc_bpf_ringbuf_add(rb, data, size);
+
+	/* stop consuming once the callback threw */
+	return rb->failed ? -ECANCELED : 0;
+}
+
+static void
+uc_bpf_perfbuf_sample(void *ctx, int cpu, void *data, __u32 size)
+{
+	uc_bpf_ringbuf_add(ctx, data, size);
+}
+
+static void
+uc_bpf_perfbuf_lost(void *ctx, int cpu, __u64 cnt)
+{
+	struct uc_bpf_ringbuf *rb = ctx;
+
+	rb->lost += cnt;
+}
+
+static void uc_bpf_ringbuf_close(struct uc_bpf_ringbuf *rb);
+
+/*
+ * Returns the number of records consumed, a negative error, or -ECANCELED
+ * if the callback threw an exception, which is left pending in the VM.
+ */
+static int
+uc_bpf_ringbuf_consume(struct uc_bpf_ringbuf *rb)
+{
+	uint64_t records = rb->records;
+	int ret;
+
+	/* the script may drop its last reference from within the callback */
+	ucv_get(rb->res);
+
+	rb->busy = true;
+	rb->failed = false;
+	if (rb->rb)
+		ret = ring_buffer__consume(rb->rb);
+	else
+		ret = perf_buffer__consume(rb->pb);
+
+	if (!rb->closed && !rb->failed)
+		uc_bpf_ringbuf_flush(rb);
+	rb->busy = false;
+
+	/* closed from within the callback */
+	if (rb->closed)
+		uc_bpf_ringbuf_close(rb);
+
+	if (rb->failed)
+		ret = -ECANCELED;
+	else if (ret >= 0)
+		ret = rb->records - records;
+
+	/* may free rb */
+	ucv_put(rb->res);
+
+	return ret;
+}
+
+static void
+uc_bpf_ringbuf_fd_cb(struct uloop_fd *fd, unsigned int events)
+{
+	struct uc_bpf_ringbuf *rb = container_of(fd, struct uc_bpf_ringbuf, fd);
+
+	/* like the uloop module: stop the loop, uloop.run() raises the exception */
+	if (uc_bpf_ringbuf_consume(rb) == -ECANCELED)
+		uloop_end();
+}
+
+static void
+uc_bpf_ringbuf_close(struct uc_bpf_ringbuf *rb)
+{
+	if (!rb->rb && !rb->pb)
+		return;
+
+	rb->closed = true;
+	if (rb->busy)
+		return;
+
+	uloop_fd_delete(&rb->fd);
+	ring_buffer__free(rb->rb);
+	perf_buffer__free(rb->pb);
+	rb->rb = NULL;
+	rb->pb = NULL;
+
+	ucv_put(rb->batch);
+	rb->batch = NULL;
+	ucv_array_set(registry, rb->cb_idx, NULL);
+	uc_bpf_layout_put(rb->layout);
+	rb->layout = NULL;
+}
+
+static uc_value_t *
+uc_bpf_map_ringbuf_consumer(uc_vm_t *vm, size_t nargs)
+{
+	struct uc_bpf_map *map = uc_fn_thisval("bpf.map");
+	uc_value_t *cb = uc_fn_arg(0);
+	uc_value_t *opts = uc_fn_arg(1);
+	uc_value_t *layout = NULL, *batch = NULL, *pages = NULL;
+	struct uc_bpf_ringbuf *rb;
+	size_t page_cnt = UC_BPF_PERFBUF_PAGES;
+	int fd;
+
+	if (!map || !ucv_is_callable(cb))
+		err_return(EINVAL, NULL);
+
+	if (map->type != BPF_MAP_TYPE_RINGBUF &&
+	    map->type != BPF_MAP_TYPE_PERF_EVENT_ARRAY)
+		err_return(EINVAL, "map type");
+
+	if (opts) {
+		if (ucv_type(opts) != UC_OBJECT)
+			err_return(EINVAL, "options argument");
+
+		layout = ucv_object_get(opts, "layout", NULL);
+		batch = ucv_object_get(opts, "batch", NULL);
+		pages = ucv_object_get(opts, "pages", NULL);
+	}
+
+	if ((batch && (ucv_type(batch) != UC_INTEGER || ucv_int64_get(batch) <= 0)) ||
+	    (pages && (ucv_type(pages) != UC_INTEGER || ucv_int64_get(pages) <= 0)))
+		err_return(EINVAL, "options argument");
+
+	if (pages)
+		page_cnt = ucv_int64_get(pages);
+
+	rb = xalloc(sizeof(*rb));
+	rb->vm = vm;
+	rb->batch_size = batch ? ucv_int64_get(batch) : UC_BPF_RINGBUF_BATCH;
+
+	if (layout && !(rb->layout = uc_bpf_layout_parse(layout, "record", 0))) {
+		free(rb);
+		return NULL;
+	}
+
+	if (map->type == BPF_MAP_TYPE_RINGBUF) {
+		rb->rb = ring_buffer__new(map->fd.fd, uc_bpf_ringbuf_sample, rb, NULL);
+		if (!rb->rb)
+			goto error;
+
+		fd = ring_buffer__epoll_fd(rb->rb);
+	} else {
+		rb->pb = perf_buffer__new(map->fd.fd, page_cnt, uc_bpf_perfbuf_sample,
+					  uc_bpf_perfbuf_lost, rb, NULL);
+		if (!rb->pb)
+			goto error;
+
+		fd = perf_buffer__epoll_fd(rb->pb);
+	}
+
+	rb->cb_idx = uc_bpf_registry_add(cb);
+	rb->fd.fd = fd;
+	rb->fd.cb = uc_bpf_ringbuf_fd_cb;
+	uloop_fd_add(&rb->fd, ULOOP_READ);
+
+	rb->res = uc_resource_new(ringbuf_type, rb);
+
+	return rb->res;
+
+error:
+	uc_bpf_layout_put(rb->layout);
+	free(rb);
+	err_return(errno, NULL);
+}
+
+static uc_value_t *
+uc_bpf_ringbuf_consume_fn(uc_vm_t *vm, size_t nargs)
+{
+	struct uc_bpf_ringbuf *rb = uc_fn_thisval("bpf.ringbuf");
+	int ret;
+
+	if (!rb || rb->closed || rb->busy)
+		err_return(EINVAL, NULL);
+
+	ret = uc_bpf_ringbuf_consume(rb);
+	if (ret == -ECANCELED)
+		return NULL;
+
+	if (ret < 0)
+		err_return(-ret, NULL);
+
+	return ucv_int64_new(ret);
+}
+
+static uc_value_t *
+uc_bpf_ringbuf_stats(uc_vm_t *vm, size_t nargs)
+{
+	struct uc_bpf_ringbuf *rb = uc_fn_thisval("bpf.ringbuf");
+	uc_value_t *rv;
+
+	if (!rb)
+		err_return(EINVAL, NULL);
+
+	rv = ucv_object_new(vm);
+	ucv_object_add(rv, "records", ucv_uint64_new(rb->records));
+	ucv_object_add(rv, "batches", ucv_uint64_new(rb->batches));
+	ucv_object_add(rv, "lost", ucv_uint64_new(rb->lost));
+
+	return rv;
+}
+
+static uc_value_t *
+uc_bpf_ringbuf_close_fn(uc_vm_t *vm, size_t nargs)
+{
+	struct uc_bpf_ringbuf *rb = uc_fn_thisval("bpf.ringbuf");
+
+	if (!rb)
+		err_return(EINVAL, NULL);
+
+	uc_bpf_ringbuf_close(rb);
+
+	return TRUE;
+}
+
+static uc_value_t *
+uc_bpf_map_iterator(uc_vm_t *vm, size_t nargs)
+{
+	struct uc_bpf_map *map = uc_fn_thisval("bpf.map");
+	struct uc_bpf_map_iter *iter;
+
+	if (!map)
+		err_return(EINVAL, NULL);
+
+	iter = xalloc(sizeof(*iter) + map->key_size);
+	iter->fd = map->fd.fd;
+	iter->key_size = map->key_size;
+	iter->key_layout = uc_bpf_layout_get(map->key_layout);
+	iter->has_next = !bpf_map_get_next_key(iter->fd, NULL, &iter->key);
+
+	return uc_resource_new(map_iter_type, iter);
+}
+
+static uc_value_t *
+uc_bpf_map_iter_next(uc_vm_t *vm, size_t nargs)
+{
+	struct uc_bpf_map_iter *iter = uc_fn_thisval("bpf.map_iter");
+	uc_value_t *rv;
+
+	if (!iter->has_next)
+		return NULL;
+
+	if (iter->key_layout)
+		rv = uc_bpf_layout_decode(vm, iter->key_layout, iter->key, 0, 1);
+	else
+		rv = ucv_string_new_length((const char *)iter->key, iter->key_size);
+	iter->has_next = !bpf_map_get_next_key(iter->fd, &iter->key, &iter->key);
+
+	return rv;
+}
+
+static uc_value_t *
+uc_bpf_map_iter_next_int(uc_vm_t *vm, size_t nargs)
+{
+	struct uc_bpf_map_iter *iter = uc_fn_thisval("bpf.map_iter");
+	uint64_t intval;
+	uc_value_t *rv;
+
 	if (!iter->has_next)
 		return NULL;
 
@@ -543,37 +1652,65 @@ uc_bpf_map_iter_next_int(uc_vm_t *vm, size_t nargs)
 	return rv;
 }
 
+static int
+uc_bpf_map_foreach_call(uc_vm_t *vm, uc_value_t *func, struct uc_bpf_map *map,
+			const void *key)
+{
+	uc_value_t *rv;
+	bool stop;
+
+	uc_value_push(ucv_get(func));
+	uc_value_push(uc_bpf_map_key_value(vm, map, key));
+
+	if (uc_call(1) != EXCEPTION_NONE)
+		return -1;
+
+	rv = uc_vm_stack_pop(vm);
+	stop = (ucv_type(rv) == UC_BOOLEAN && !ucv_boolean_get(rv));
+	ucv_put(rv);
+
+	return stop ? -1 : 0;
+}
+
 static uc_value_t *
 uc_bpf_map_foreach(uc_vm_t *vm, size_t nargs)
 {
 	struct uc_bpf_map *map = uc_fn_thisval("bpf.map");
 	uc_value_t *func = uc_fn_arg(0);
+	struct uc_bpf_map_batch batch;
 	bool has_next;
 	void *key, *next;
 	bool ret = false;
+	int i, count;
+
+	uc_bpf_map_batch_init(&batch, map);
+	while ((count = uc_bpf_map_batch_next(&batch)) > 0) {
+		for (i = 0; i < count; i++) {
+			if (uc_bpf_map_foreach_call(vm, func, map,
+						    batch.keys + i * map->key_size))
+				goto out;
+
+			ret = true;
+		}
+	}
+
+out:
+	uc_bpf_map_batch_free(&batch);
+	if (count < -1)
+		return NULL;
+
+	if (count >= 0)
+		return ucv_boolean_new(ret);
 
 	key = alloca(map->key_size);
 	next = alloca(map->key_size);
 	has_next = !bpf_map_get_next_key(map->fd.fd, NULL, next);
 
 	while (has_next) {
-		uc_value_t *rv;
-		bool stop;
-
 		memcpy(key, next, map->key_size);
 		has_next = !bpf_map_get_next_key(map->fd.fd, next, next);
 
-		uc_value_push(ucv_get(func));
-		uc_value_push(ucv_string_new_length((const char *)key, map->key_size));
-
-		if (uc_call(1) != EXCEPTION_NONE)
-			break;
-
-		rv = uc_vm_stack_pop(vm);
-		stop = (ucv_type(rv) == UC_BOOLEAN && !ucv_boolean_get(rv));
-		ucv_put(rv);
-
-		if (stop)
+		if (uc_bpf_map_foreach_call(vm, func, map, key))
 			break;
 
 		ret = true;
@@ -674,6 +1811,136 @@ uc_bpf_program_tc_attach(uc_vm_t *vm, size_t nargs)
 	return uc_bpf_set_tc_hook(ifname, type, prio, f->fd);
 }
 
+static int
+uc_bpf_xdp_args(uc_value_t *ifname, uc_value_t *mode, uc_value_t *expected,
+		int *ifindex, __u32 *flags, struct bpf_xdp_attach_opts *opts)
+{
+	struct uc_bpf_fd *old;
+	const char *mode_str;
+
+	if (ucv_type(ifname) != UC_STRING)
+		err_return_int(EINVAL, "ifname");
+
+	if (!mode) {
+		*flags = 0;
+	} else if (ucv_type(mode) != UC_STRING) {
+		err_return_int(EINVAL, "mode");
+	} else {
+		mode_str = ucv_string_get(mode);
+		if (!strcmp(mode_str, "native") || !strcmp(mode_str, "drv"))
+			*flags = XDP_FLAGS_DRV_MODE;
+		else if (!strcmp(mode_str, "generic") || !strcmp(mode_str, "skb"))
+			*flags = XDP_FLAGS_SKB_MODE;
+		else if (!strcmp(mode_str, "offload") || !strcmp(mode_str, "hw"))
+			*flags = XDP_FLAGS_HW_MODE;
+		else
+			err_return_int(EINVAL, "mode");
+	}
+
+	/* only replace/detach if the expected program is currently attached */
+	if (expected) {
+		old = ucv_resource_data(expected, "bpf.program");
+		if (!old)
+			err_return_int(EINVAL, "expected program");
+
+		*flags |= XDP_FLAGS_REPLACE;
+		opts->old_prog_fd = old->fd;
+	}
+
+	*ifindex = if_nametoindex(ucv_string_get(ifname));
+	if (!*ifindex)
+		err_return_int(ENOENT, NULL);
+
+	return 0;
+}
+
+static uc_value_t *
+uc_bpf_program_xdp_attach(uc_vm_t *vm, size_t nargs)
+{
+	struct uc_bpf_fd *f = uc_fn_thisval("bpf.program");
+	uc_value_t *ifname = uc_fn_arg(0);
+	uc_value_t *mode = uc_fn_arg(1);
+	uc_value_t *expected = uc_fn_arg(2);
+	DECLARE_LIBBPF_OPTS(bpf_xdp_attach_opts, opts);
+	int ifindex;
+	__u32 flags;
+
+	if (!f)
+		err_return(EINVAL, NULL);
+
+	if (uc_bpf_xdp_args(ifname, mode, expected, &ifindex, &flags, &opts))
+		return NULL;
+
+	if (bpf_xdp_attach(ifindex, f->fd, flags, &opts) < 0)
+		err_return(errno, NULL);
+
+	return TRUE;
+}
+
+static uc_value_t *
+uc_bpf_xdp_detach(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *ifname = uc_fn_arg(0);
+	uc_value_t *mode = uc_fn_arg(1);
+	uc_value_t *expected = uc_fn_arg(2);
+	DECLARE_LIBBPF_OPTS(bpf_xdp_attach_opts, opts);
+	int ifindex;
+	__u32 flags;
+
+	if (uc_bpf_xdp_args(ifname, mode, expected, &ifindex, &flags, &opts))
+		return NULL;
+
+	if (bpf_xdp_detach(ifindex, flags, &opts) < 0)
+		err_return(errno, NULL);
+
+	return TRUE;
+}
+
+static uc_value_t *
+uc_bpf_xdp_query(uc_vm_t *vm, size_t nargs)
+{
+	DECLARE_LIBBPF_OPTS(bpf_xdp_query_opts, opts);
+	uc_value_t *ifname = uc_fn_arg(0);
+	const char *mode = NULL;
+	uc_value_t *rv;
+	int ifindex;
+
+	if (ucv_type(ifname) != UC_STRING)
+		err_return(EINVAL, "ifname");
+
+	ifindex = if_nametoindex(ucv_string_get(ifname));
+	if (!ifindex)
+		err_return(ENOENT, NULL);
+
+	if (bpf_xdp_query(ifindex, 0, &opts) < 0)
+		err_return(errno, NULL);
+
+	switch (opts.attach_mode) {
+	case XDP_ATTACHED_DRV:
+		mode = "native";
+		break;
+	case XDP_ATTACHED_SKB:
+		mode = "generic";
+		break;
+	case XDP_ATTACHED_HW:
+		mode = "offload";
+		break;
+	case XDP_ATTACHED_MULTI:
+		mode = "multi";
+		break;
+	}
+
+	rv = ucv_object_new(vm);
+	if (mode)
+		ucv_object_add(rv, "mode", ucv_string_new(mode));
+	ucv_object_add(rv, "prog_id", ucv_int64_new(opts.prog_id));
+	ucv_object_add(rv, "native", ucv_int64_new(opts.drv_prog_id));
+	ucv_object_add(rv, "generic", ucv_int64_new(opts.skb_prog_id));
+	ucv_object_add(rv, "offload", ucv_int64_new(opts.hw_prog_id));
+
+	return rv;
+}
+
 static uc_value_t *
 uc_bpf_tc_detach(uc_vm_t *vm, size_t nargs)
 {
@@ -740,6 +2007,7 @@ register_constants(uc_vm_t *vm, uc_value_t *scope)
 #define ADD_CONST(x) ucv_object_add(scope, #x, ucv_int64_new(x))
 	ADD_CONST(BPF_PROG_TYPE_SCHED_CLS);
 	ADD_CONST(BPF_PROG_TYPE_SCHED_ACT);
+	ADD_CONST(BPF_PROG_TYPE_XDP);
 
 	ADD_CONST(BPF_ANY);
 	ADD_CONST(BPF_NOEXIST);
@@ -767,8 +2035,13 @@ static const uc_function_list_t map_fns[] = {
 	{ "set",			uc_bpf_map_set },
 	{ "delete",			uc_bpf_map_delete },
 	{ "delete_all",			uc_bpf_map_delete_all },
+	{ "get_batch",			uc_bpf_map_get_batch },
+	{ "set_batch",			uc_bpf_map_set_batch },
+	{ "delete_batch",		uc_bpf_map_delete_batch },
 	{ "foreach",			uc_bpf_map_foreach },
 	{ "iterator",			uc_bpf_map_iterator },
+	{ "set_layout",			uc_bpf_map_layout },
+	{ "ringbuf_consumer",		uc_bpf_map_ringbuf_consumer },
 };
 
 static void uc_bpf_fd_free(void *ptr)
@@ -780,6 +2053,39 @@ static void uc_bpf_fd_free(void *ptr)
 	free(f);
 }
 
+static void uc_bpf_map_free(void *ptr)
+{
+	struct uc_bpf_map *map = ptr;
+
+	uc_bpf_layout_put(map->key_layout);
+	uc_bpf_layout_put(map->val_layout);
+	uc_bpf_fd_free(ptr);
+}
+
+static void uc_bpf_map_iter_free(void *ptr)
+{
+	struct uc_bpf_map_iter *iter = ptr;
+
+	uc_bpf_layout_put(iter->key_layout);
+	free(iter);
+}
+
+static void uc_bpf_ringbuf_free(void *ptr)
+{
+	struct uc_bpf_ringbuf *rb = ptr;
+
+	/* consume holds a reference, so this never runs while busy */
+	rb->busy = false;
+	uc_bpf_ringbuf_close(rb);
+	free(rb);
+}
+
+static const uc_function_list_t ringbuf_fns[] = {
+	{ "consume",			uc_bpf_ringbuf_consume_fn },
+	{ "stats",			uc_bpf_ringbuf_stats },
+	{ "close",			uc_bpf_ringbuf_close_fn },
+};
+
 static const uc_function_list_t map_iter_fns[] = {
 	{ "next",			uc_bpf_map_iter_next },
 	{ "next_int",			uc_bpf_map_iter_next_int },
@@ -788,6 +2094,7 @@ static const uc_function_list_t map_iter_fns[] = {
 static const uc_function_list_t prog_fns[] = {
 	{ "pin",			uc_bpf_program_pin },
 	{ "tc_attach",			uc_bpf_program_tc_attach },
+	{ "xdp_attach",			uc_bpf_program_xdp_attach },
 };
 
 static const uc_function_list_t global_fns[] = {
@@ -797,6 +2104,8 @@ static const uc_function_list_t global_fns[] = {
 	{ "open_map",			uc_bpf_open_map },
 	{ "open_program",		uc_bpf_open_program },
 	{ "tc_detach",			uc_bpf_tc_detach },
+	{ "xdp_detach",			uc_bpf_xdp_detach },
+	{ "xdp_query",			uc_bpf_xdp_query },
 };
 
 void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
@@ -808,7 +2117,8 @@ void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
 	uc_vm_registry_set(vm, "bpf.registry", registry);
 
 	module_type = uc_type_declare(vm, "bpf.module", module_fns, module_free);
-	map_type = uc_type_declare(vm, "bpf.map", map_fns, uc_bpf_fd_free);
-	map_iter_type = uc_type_declare(vm, "bpf.map_iter", map_iter_fns, free);
+	map_type = uc_type_declare(vm, "bpf.map", map_fns, uc_bpf_map_free);
+	map_iter_type = uc_type_declare(vm, "bpf.map_iter", map_iter_fns, uc_bpf_map_iter_free);
 	program_type = uc_type_declare(vm, "bpf.program", prog_fns, uc_bpf_fd_free);
+	ringbuf_type = uc_type_declare(vm, "bpf.ringbuf", ringbuf_fns, uc_bpf_ringbuf_free);
 }
@@ -0,0 +1,51 @@
+// XDP attach/replace/detach selftest, run by xdp-selftest.sh inside a
+// network namespace.
+//
+// usage: ucode xdp-attach.uc <bpf object> <ifname> <mode>
+
+'use strict';
+
+import * as bpf from "bpf";
+
+let obj = ARGV[0], ifname = ARGV[1], mode = ARGV[2];
+let failed = 0;
+
+function check(name, cond) {
+	printf("%s: %s\n", cond ? "PASS" : "FAIL", name);
+	if (!cond)
+		failed++;
+}
+
+let mod = bpf.open_module(obj, {
+	"program-type": {
+		xdp_pass: bpf.BPF_PROG_TYPE_XDP,
+		xdp_drop: bpf.BPF_PROG_TYPE_XDP,
+	}
+});
+if (!mod) {
+	warn(`Failed to load ${obj}: ${bpf.error()}\n`);
+	exit(1);
+}
+
+let pass = mod.get_program("xdp_pass");
+let drop = mod.get_program("xdp_drop");
+
+check("attach", pass.xdp_attach(ifname, mode));
+
+let info = bpf.xdp_query(ifname);
+check("query mode", info?.mode == mode);
+check("query id", info?.prog_id > 0);
+let pass_id = info?.prog_id;
+
+check("replace with wrong expected program fails", !drop.xdp_attach(ifname, mode, drop));
+check("program unchanged", bpf.xdp_query(ifname)?.prog_id == pass_id);
+
+check("replace with expected program", drop.xdp_attach(ifname, mode, pass));
+info = bpf.xdp_query(ifname);
+check("replaced id", info?.prog_id > 0 && info?.prog_id != pass_id);
+
+check("detach with wrong expected program fails", !bpf.xdp_detach(ifname, mode, pass));
+check("detach", bpf.xdp_detach(ifname, mode, drop));
+check("detached", bpf.xdp_query(ifname)?.prog_id == 0);
+
+exit(failed ? 1 : 0);
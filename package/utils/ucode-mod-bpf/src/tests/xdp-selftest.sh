@@ -0,0 +1,31 @@
+#!/bin/sh
+# Run the XDP attach selftest on a veth pair in a private network namespace.
+# Requires root, iproute2, clang with the bpf target and ucode with bpf.so.
+
+set -e
+
+dir="$(cd "$(dirname "$0")" && pwd)"
+ns="ucode-bpf-xdp-$$"
+tmp="$(mktemp -d)"
+
+cleanup() {
+	ip netns del "$ns" 2>/dev/null || true
+	rm -rf "$tmp"
+}
+trap cleanup EXIT
+
+clang -O2 -g -target bpf ${BPF_CFLAGS} -c "$dir/xdp_pass.c" -o "$tmp/xdp_pass.o"
+
+ip netns add "$ns"
+ip -n "$ns" link add veth0 type veth peer name veth1
+ip -n "$ns" link set veth0 up
+ip -n "$ns" link set veth1 up
+
+ret=0
+for mode in generic native; do
+	echo "== $mode"
+	ip netns exec "$ns" ucode ${UCODE_FLAGS} "$dir/xdp-attach.uc" \
+		"$tmp/xdp_pass.o" veth0 "$mode" || ret=1
+done
+
+exit $ret
@@ -36,6 +36,7 @@ enum input_mode {
 	yes2modconfig,
 	mod2yesconfig,
 	fatalrecursive,
+	timing,
 };
 static enum input_mode input_mode = oldaskconfig;
 static int input_mode_opt;
@@ -43,9 +44,24 @@ static int indent = 1;
 static int tty_stdio;
 static int sync_kconfig;
 static int conf_cnt;
+static int show_timing;
 static char line[PATH_MAX];
 static struct menu *rootEntry;
 
+/* Print the time spent since the last call, for --timing */
+static void print_timing(const char *phase)
+{
+	static struct timespec last;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (show_timing && phase)
+		fprintf(stderr, "%-10s %8.1f ms\n", phase,
+			(now.tv_sec - last.tv_sec) * 1000.0 +
+			(now.tv_nsec - last.tv_nsec) / 1000000.0);
+	last = now;
+}
+
 static void print_help(struct menu *menu)
 {
 	struct gstr help = str_new();
@@ -698,6 +714,7 @@ static const struct option long_opts[] = {
 	{"yes2modconfig", no_argument,       &input_mode_opt, yes2modconfig},
 	{"mod2yesconfig", no_argument,       &input_mode_opt, mod2yesconfig},
 	{"fatalrecursive",no_argument,       NULL, fatalrecursive},
+	{"timing",        no_argument,       NULL, timing},
 	{NULL, 0, NULL, 0}
 };
 
@@ -709,6 +726,8 @@ static void conf_usage(const char *progname)
 	printf("  -h, --help              Print this message and exit.\n");
 	printf("  -s, --silent            Do not print log.\n");
 	printf("      --fatalrecursive    Treat recursive depenendencies as a fatal error\n");
+	printf("      --timing            Print the time spent parsing, reading, evaluating\n"
+	       "                          and writing the configuration to stderr\n");
 	printf("\n");
 	printf("Mode options:\n");
 	printf("  --listnewconfig         List new options\n");
@@ -752,6 +771,9 @@ int main(int ac, char **av)
 		case fatalrecursive:
 			recursive_is_error = 1;
 			continue;
+		case timing:
+			show_timing = 1;
+			continue;
 		case 'r':
 			input_file = optarg;
 			break;
@@ -789,7 +811,9 @@ int main(int ac, char **av)
 		conf_usage(progname);
 		exit(1);
 	}
+	print_timing(NULL);
 	conf_parse(av[optind]);
+	print_timing("parse");
 	//zconfdump(stdout);
 
 	switch (input_mode) {
@@ -822,6 +846,7 @@ int main(int ac, char **av)
 	default:
 		break;
 	}
+	print_timing("read");
 
 	if (sync_kconfig) {
 		name = getenv("KCONFIG_NOSILENTUPDATE");
@@ -883,6 +908,16 @@ int main(int ac, char **av)
 		break;
 	}
 
+	if (show_timing) {
+		struct symbol *sym;
+		int i;
+
+		/* the writers would calculate them anyway, keep that out of "write" */
+		for_all_symbols(i, sym)
+			sym_calc_value(sym);
+	}
+	print_timing("evaluate");
+
 	if (input_mode == savedefconfig) {
 		if (conf_write_defconfig(defconfig_file)) {
 			fprintf(stderr, "n*** Error while saving defconfig to: %s\n\n",
@@ -911,5 +946,7 @@ int main(int ac, char **av)
 			return 1;
 		}
 	}
+	print_timing("write");
+
 	return 0;
 }
@@ -129,6 +129,13 @@ struct symbol {
 	 * "Weak" reverse dependencies through being implied by other symbols
 	 */
 	struct expr_value implied;
+
+	/*
+	 * Symbols calculated from this symbol, invalidated when its value
+	 * is changed. Built on demand by symbol.c.
+	 */
+	struct symbol **dependents;
+	int nr_dependents;
 };
 
 #define for_all_symbols(i, sym) for (i = 0; i < SYMBOL_HASHSIZE; i++) for (sym = symbol_hash[i]; sym; sym = sym->next)
@@ -156,6 +163,9 @@ struct symbol {
 /* choice values need to be set before calculating this symbol value */
 #define SYMBOL_NEED_SET_CHOICE_VALUES  0x100000
 
+/* used while invalidating the symbols calculated from a changed symbol */
+#define SYMBOL_DEP_MARK  0x200000
+
 #define SYMBOL_MAXLENGTH	256
 #define SYMBOL_HASHSIZE		9973
 
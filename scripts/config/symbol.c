@@ -456,6 +456,136 @@ void sym_clear_all_valid(void)
 	sym_calc_value(modules_sym);
 }
 
+/*
+ * Reverse dependency index: sym->dependents lists the symbols whose value or
+ * visibility is calculated from sym. It is built from the properties and the
+ * dir_dep, rev_dep and implied expressions of every symbol the first time a
+ * single value is changed, so a change only invalidates the symbols that can
+ * be affected by it instead of all of them.
+ */
+static bool dep_index_built;
+
+static void sym_add_dependent(struct symbol *sym, struct symbol *dep)
+{
+	int n = sym->nr_dependents;
+
+	if (sym->flags & SYMBOL_CONST)
+		return;
+
+	/* all references of one symbol are added in a row */
+	if (n && sym->dependents[n - 1] == dep)
+		return;
+
+	if (!(n & (n - 1)))
+		sym->dependents = xrealloc(sym->dependents,
+					   (n ? 2 * n : 1) * sizeof(dep));
+	sym->dependents[n] = dep;
+	sym->nr_dependents = n + 1;
+}
+
+static void sym_index_expr(struct expr *e, struct symbol *dep)
+{
+	for (; e; e = e->left.expr) {
+		switch (e->type) {
+		case E_OR:
+		case E_AND:
+			sym_index_expr(e->right.expr, dep);
+			/* fall through */
+		case E_NOT:
+			continue;
+		case E_EQUAL:
+		case E_GEQ:
+		case E_GTH:
+		case E_LEQ:
+		case E_LTH:
+		case E_UNEQUAL:
+		case E_RANGE:
+			sym_add_dependent(e->left.sym, dep);
+			sym_add_dependent(e->right.sym, dep);
+			break;
+		case E_SYMBOL:
+			sym_add_dependent(e->left.sym, dep);
+			break;
+		case E_LIST:
+			/* choice values, chained through left.expr */
+			if (e->right.sym)
+				sym_add_dependent(e->right.sym, dep);
+			continue;
+		default:
+			break;
+		}
+		return;
+	}
+}
+
+static void sym_build_dep_index(void)
+{
+	struct property *prop;
+	struct symbol *sym;
+	int i;
+
+	for_all_symbols(i, sym) {
+		for (prop = sym->prop; prop; prop = prop->next) {
+			/* these affect the target, which has them in rev_dep/implied */
+			if (prop->type == P_SELECT || prop->type == P_IMPLY)
+				continue;
+			sym_index_expr(prop->expr, sym);
+			sym_index_expr(prop->visible.expr, sym);
+		}
+		sym_index_expr(sym->dir_dep.expr, sym);
+		sym_index_expr(sym->rev_dep.expr, sym);
+		sym_index_expr(sym->implied.expr, sym);
+	}
+	dep_index_built = true;
+}
+
+/*
+ * Invalidate sym and everything calculated from it. Falls back to
+ * sym_clear_all_valid() if the modules symbol is affected, as it changes the
+ * type of all tristate symbols.
+ */
+static void sym_clear_dependents_valid(struct symbol *sym)
+{
+	static struct symbol **list;
+	static int list_size;
+	struct symbol *dep;
+	bool all = false;
+	int i, j, n = 0;
+
+	if (!dep_index_built)
+		sym_build_dep_index();
+
+	/* breadth first walk, list doubles as the queue */
+	if (!list)
+		list = xmalloc((list_size = 64) * sizeof(sym));
+	sym->flags |= SYMBOL_DEP_MARK;
+	list[n++] = sym;
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < list[i]->nr_dependents; j++) {
+			dep = list[i]->dependents[j];
+			if (dep->flags & SYMBOL_DEP_MARK)
+				continue;
+			if (n == list_size)
+				list = xrealloc(list, (list_size *= 2) * sizeof(sym));
+			dep->flags |= SYMBOL_DEP_MARK;
+			list[n++] = dep;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		list[i]->flags &= ~(SYMBOL_DEP_MARK | SYMBOL_VALID);
+		if (list[i] == modules_sym)
+			all = true;
+	}
+
+	if (all) {
+		sym_clear_all_valid();
+		return;
+	}
+
+	conf_set_changed(true);
+}
+
 bool sym_tristate_within_range(struct symbol *sym, tristate val)
 {
 	int type = sym_get_type(sym);
@@ -506,7 +636,7 @@ bool sym_set_tristate_value(struct symbol *sym, tristate val)
 
 	sym->def[S_DEF_USER].tri = val;
 	if (oldval != val)
-		sym_clear_all_valid();
+		sym_clear_dependents_valid(sym);
 
 	return true;
 }
@@ -663,7 +793,7 @@ bool sym_set_string_value(struct symbol *sym, const char *newval)
 
 	strcpy(val, newval);
 	free((void *)oldval);
-	sym_clear_all_valid();
+	sym_clear_dependents_valid(sym);
 
 	return true;
 }
@@ -1,4 +1,16 @@
 #!/usr/bin/env bash
+#
+# Generate an opkg Packages index of all packages below a directory.
+#
+# The index entry of every package is kept in a cache, named after the path,
+# size, mtime and inode of the package, so only new or changed packages are
+# hashed and unpacked. Those are processed in parallel.
+#
+# Environment:
+#   MKHASH            mkhash command
+#   IPKG_INDEX_CACHE  directory to keep the index entries in, if set
+#   IPKG_INDEX_JOBS   number of packages to unpack in parallel
+#
 set -e
 
 pkg_dir=$1
@@ -8,7 +20,52 @@ if [ -z $pkg_dir ] || [ ! -d $pkg_dir ]; then
 	exit 1
 fi
 
+jobs="${IPKG_INDEX_JOBS:-$(nproc 2>/dev/null || echo 1)}"
+
+# Write the index entry of one package: its control file with Filename,
+# Size and SHA256sum inserted before Description, and an empty line
+make_entry() {
+	local pkg="$1" entry="$2" file_size="$3" sha256sum="$4" old
+	local tmp="${entry%/*}/.new.$$"
+
+	set -o pipefail
+
+	# Take pains to make variable value sed-safe
+	local sed_safe_pkg="${pkg#./}"
+	sed_safe_pkg="${sed_safe_pkg//\//\\/}"
+	if { tar -xzOf $pkg ./control.tar.gz | tar xzOf - ./control | sed -e "s/^Description:/Filename: $sed_safe_pkg\\
+Size: $file_size\\
+SHA256sum: $sha256sum\\
+Description:/"; echo ""; } > "$tmp"; then
+		# Drop the entries of older versions of the file
+		for old in "${entry%@*}"@*; do
+			[ -e "$old" ] && rm -f "$old"
+		done
+		mv "$tmp" "$entry"
+	else
+		# Use the output once, but do not cache it
+		mv "$tmp" "$entry.failed"
+	fi
+}
+
+make_entries() {
+	while [ $# -ge 4 ]; do
+		make_entry "$1" "$2" "$3" "$4"
+		shift 4
+	done
+}
+export -f make_entry make_entries
+
+if [ -n "$IPKG_INDEX_CACHE" ]; then
+	cache="$IPKG_INDEX_CACHE"
+	mkdir -p "$cache"
+else
+	cache="$(mktemp -d)"
+	trap 'rm -rf "$cache"' EXIT
+fi
+
 empty=1
+pkgs=()
 
 for pkg in `find $pkg_dir -name '*.ipk' | sort`; do
 	empty=
@@ -16,16 +73,61 @@ for pkg in `find $pkg_dir -name '*.ipk' | sort`; do
 	name="${name%%_*}"
 	[[ "$name" = "kernel" ]] && continue
 	[[ "$name" = "libc" ]] && continue
-	echo "Generating index for package $pkg" >&2
-	file_size=$(stat -L -c%s $pkg)
-	sha256sum=$($MKHASH sha256 $pkg)
-	# Take pains to make variable value sed-safe
-	sed_safe_pkg=`echo $pkg | sed -e 's/^\.\///g' -e 's/\\//\\\\\\//g'`
-	tar -xzOf $pkg ./control.tar.gz | tar xzOf - ./control | sed -e "s/^Description:/Filename: $sed_safe_pkg\\
-Size: $file_size\\
-SHA256sum: $sha256sum\\
-Description:/"
-	echo ""
+	pkgs+=("$pkg")
+done
+
+if [ ${#pkgs[@]} -gt 0 ]; then
+	mapfile -t stats < <(stat -L -c '%s %.9Y %i %d' "${pkgs[@]}")
+	[ ${#stats[@]} -eq ${#pkgs[@]} ]
+fi
+
+entries=()
+sizes=()
+todo=()
+
+for i in "${!pkgs[@]}"; do
+	pkg="${pkgs[$i]}"
+	read -r size mtime inode dev <<< "${stats[$i]}"
+	entry="${pkg#./}"
+	entry="$cache/${entry//\//_}@$size-$mtime-$inode-$dev"
+
+	entries+=("$entry")
+	sizes+=("$size")
+	[ -f "$entry" ] || todo+=("$i")
 done
+
+if [ ${#todo[@]} -gt 0 ]; then
+	for i in "${todo[@]}"; do
+		echo "Generating index for package ${pkgs[$i]}" >&2
+	done
+
+	# Hash all changed packages in one go, in the order of todo
+	mapfile -t hashes < <(
+		for i in "${todo[@]}"; do
+			echo "${pkgs[$i]}"
+		done | $MKHASH -j "$jobs" -f - sha256
+	)
+	[ ${#hashes[@]} -eq ${#todo[@]} ]
+
+	# Split the packages evenly between the jobs, in batches of up to 64
+	batch=$(( (${#todo[@]} + jobs - 1) / jobs ))
+	[ $batch -le 64 ] || batch=64
+
+	for n in "${!todo[@]}"; do
+		i="${todo[$n]}"
+		echo "${pkgs[$i]} ${entries[$i]} ${sizes[$i]} ${hashes[$n]}"
+	done | xargs -n $((batch * 4)) -P "$jobs" bash -c 'make_entries "$@"' make_entries
+
+	for n in "${!todo[@]}"; do
+		i="${todo[$n]}"
+		[ -f "${entries[$i]}" ] || entries[$i]="${entries[$i]}.failed"
+	done
+fi
+
+if [ ${#entries[@]} -gt 0 ]; then
+	printf '%s\0' "${entries[@]}" | xargs -0 cat
+	rm -f "$cache"/*.failed
+fi
+
 [ -n "$empty" ] && echo
 exit 0
@@ -2,7 +2,7 @@ package metadata;
 use base 'Exporter';
 use strict;
 use warnings;
-our @EXPORT = qw(%package %vpackage %srcpackage %category %overrides clear_packages parse_package_metadata parse_target_metadata get_multiline @ignore %usernames %groupnames);
+our @EXPORT = qw(%package %vpackage %srcpackage %category %overrides %pkgdeps clear_packages parse_package_metadata parse_target_metadata get_multiline @ignore %usernames %groupnames);
 
 our %package;
 our %vpackage;
@@ -11,11 +11,17 @@ our %category;
 our %overrides;
 our @ignore;
 
+# Names of all packages each package depends on, directly or indirectly
+our %pkgdeps;
+
 our %usernames;
 our %groupnames;
 our %userids;
 our %groupids;
 
+# Bump when the parsed data structures change
+my $index_version = 1;
+
 sub get_multiline {
 	my $fh = shift;
 	my $prefix = shift;
@@ -192,11 +198,104 @@ sub clear_packages() {
 	%srcpackage = ();
 	%category = ();
 	%overrides = ();
+	%pkgdeps = ();
 	%usernames = ();
 	%groupnames = ();
 }
 
+sub build_package_deps() {
+	%pkgdeps = ();
+
+	foreach my $name (keys %package) {
+		my %deps;
+		my @queue = ($package{$name});
+
+		while (my $pkg = shift @queue) {
+			foreach my $vpkg (@{$pkg->{depends}}) {
+				foreach my $dep (@{$vpackage{$vpkg} || []}) {
+					next if $deps{$dep->{name}};
+					$deps{$dep->{name}} = 1;
+					push @queue, $dep;
+				}
+			}
+		}
+		$pkgdeps{$name} = \%deps;
+	}
+}
+
+# The index is a Storable image of the parsed metadata next to the text
+# file, valid as long as the file, the ignore list and this parser are
+# unchanged. Storable is optional, without it the file is always parsed.
+sub package_index_key($) {
+	my $file = shift;
+	my @st = eval { require Time::HiRes; Time::HiRes::stat($file) };
+	@st or @st = stat($file) or return undef;
+	my $self = (stat($INC{"metadata.pm"} || __FILE__))[9] || 0;
+
+	return join(":", $index_version, @st[1, 7, 9], $self, sort @ignore);
+}
+
+sub load_package_index($) {
+	my $file = shift;
+	my $key = package_index_key($file) or return 0;
+	my $index;
+
+	eval { require Storable } or return 0;
+	$index = eval { Storable::retrieve("$file.idx") };
+	$index and ref($index) eq "HASH" and ($index->{key} // "") eq $key or return 0;
+
+	%package = %{$index->{package}};
+	%vpackage = %{$index->{vpackage}};
+	%srcpackage = %{$index->{srcpackage}};
+	%category = %{$index->{category}};
+	%overrides = %{$index->{overrides}};
+	%pkgdeps = %{$index->{pkgdeps}};
+	%usernames = %{$index->{usernames}};
+	%groupnames = %{$index->{groupnames}};
+	%userids = %{$index->{userids}};
+	%groupids = %{$index->{groupids}};
+	return 1;
+}
+
+sub save_package_index($) {
+	my $file = shift;
+	my $key = package_index_key($file) or return;
+
+	eval { require Storable } or return;
+	eval {
+		Storable::nstore({
+			key => $key,
+			package => \%package,
+			vpackage => \%vpackage,
+			srcpackage => \%srcpackage,
+			category => \%category,
+			overrides => \%overrides,
+			pkgdeps => \%pkgdeps,
+			usernames => \%usernames,
+			groupnames => \%groupnames,
+			userids => \%userids,
+			groupids => \%groupids,
+		}, "$file.idx.$$");
+		rename("$file.idx.$$", "$file.idx") or die;
+	} or unlink("$file.idx.$$");
+}
+
 sub parse_package_metadata($) {
+	my $file = shift;
+	my $ret;
+
+	my $first = !%package;
+
+	# Only a first parse can be replaced with the index
+	$first and load_package_index($file) and return 1;
+
+	$ret = parse_package_metadata_file($file) or return $ret;
+	build_package_deps();
+	$first and save_package_index($file);
+	return 1;
+}
+
+sub parse_package_metadata_file($) {
 	my $file = shift;
 	my $pkg;
 	my $src;
@@ -85,13 +85,38 @@
 #include <sys/endian.h>
 #endif
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA256_X86
+#elif defined(__aarch64__) && \
+      (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#include <arm_neon.h>
+#ifdef __linux__
+#include <sys/auxv.h>
+#endif
+#define SHA256_ARM
+#define SHA256_ARM_ATTR
+#elif defined(__aarch64__) && defined(__linux__) && \
+      defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 8
+/* generic build, enable the extensions for the accelerated function only */
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#define SHA256_ARM
+#define SHA256_ARM_ATTR __attribute__((target("+crypto")))
+#endif
+
 #define ARRAY_SIZE(_n) (sizeof(_n) / sizeof((_n)[0]))
 
 #ifndef __FreeBSD__
@@ -131,6 +156,37 @@ be32dec(const void *buf)
 
 	return (((uint32_t) be16dec(p)) << 16) | be16dec(p + 2);
 }
+
+static uint64_t
+be64dec(const void *buf)
+{
+	const uint8_t *p = buf;
+
+	return (((uint64_t) be32dec(p)) << 32) | be32dec(p + 4);
+}
+
+static uint64_t
+le64dec(const void *buf)
+{
+	const uint8_t *p = buf;
+	uint64_t u = 0;
+	int i;
+
+	for (i = 7; i >= 0; i--)
+		u = (u << 8) | p[i];
+
+	return u;
+}
+
+static void
+le64enc(void *buf, uint64_t u)
+{
+	uint8_t *p = buf;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		p[i] = (uint8_t) (u >> (i * 8));
+}
 #endif
 
 #define MD5_DIGEST_LENGTH	16
@@ -451,6 +507,26 @@ be32dec_vect(uint32_t *dst, const unsigned char *src, size_t len)
 #define Maj(x, y, z)	((x & (y | z)) | (y & z))
 #define ROTR(x, n)	((x >> n) | (x << (32 - n)))
 
+/* SHA256 round constants. */
+static const uint32_t SHA256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
 /*
  * SHA256 block compression function.  The 256-bit state is transformed via
  * the 512-bit input block to produce a new state.
@@ -458,25 +534,6 @@ be32dec_vect(uint32_t *dst, const unsigned char *src, size_t len)
 static void
 SHA256_Transform(uint32_t * state, const unsigned char block[64])
 {
-	/* SHA256 round constants. */
-	static const uint32_t K[64] = {
-		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
-		0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-		0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-		0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
-		0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-		0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
-		0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
-		0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-		0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-	};
 	uint32_t W[64];
 	uint32_t S[8];
 	int i;
@@ -498,7 +555,7 @@ SHA256_Transform(uint32_t * state, const unsigned char block[64])
 	    S[(66 - i) % 8], S[(67 - i) % 8],	\
 	    S[(68 - i) % 8], S[(69 - i) % 8],	\
 	    S[(70 - i) % 8], S[(71 - i) % 8],	\
-	    W[i + ii] + K[i + ii])
+	    W[i + ii] + SHA256_K[i + ii])
 
 /* Message schedule computation */
 #define MSCH(W, ii, i)				\
@@ -562,6 +619,153 @@ SHA256_Transform(uint32_t * state, const unsigned char block[64])
 		state[i] += S[i];
 }
 
+static void
+SHA256_Blocks_generic(uint32_t *state, const unsigned char *data, size_t blocks)
+{
+	while (blocks--) {
+		SHA256_Transform(state, data);
+		data += SHA256_BLOCK_LENGTH;
+	}
+}
+
+#ifdef SHA256_X86
+/*
+ * SHA256 using the x86 SHA extensions. The state is kept as ABEF/CDGH
+ * vectors as expected by sha256rnds2.
+ */
+__attribute__((target("sha,ssse3,sse4.1")))
+static void
+SHA256_Blocks_hw(uint32_t *state, const unsigned char *data, size_t blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					    0x0405060700010203ULL);
+	__m128i state0, state1, abef, cdgh, msg, tmp, w[4];
+	int i;
+
+	tmp = _mm_loadu_si128((const __m128i *) &state[0]);
+	state1 = _mm_loadu_si128((const __m128i *) &state[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xb1);			/* CDAB */
+	state1 = _mm_shuffle_epi32(state1, 0x1b);		/* EFGH */
+	state0 = _mm_alignr_epi8(tmp, state1, 8);		/* ABEF */
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0);		/* CDGH */
+
+	while (blocks--) {
+		abef = state0;
+		cdgh = state1;
+
+		for (i = 0; i < 16; i++) {
+			if (i < 4) {
+				msg = _mm_loadu_si128((const __m128i *) (data + i * 16));
+				w[i] = _mm_shuffle_epi8(msg, mask);
+			} else {
+				/* W[i..i+3] from W[i-16..i-1] */
+				tmp = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+				tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(w[(i + 3) & 3],
+									 w[(i + 2) & 3], 4));
+				w[i & 3] = _mm_sha256msg2_epu32(tmp, w[(i + 3) & 3]);
+			}
+
+			msg = _mm_add_epi32(w[i & 3],
+				_mm_loadu_si128((const __m128i *) &SHA256_K[i * 4]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+		data += SHA256_BLOCK_LENGTH;
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1b);			/* FEBA */
+	state1 = _mm_shuffle_epi32(state1, 0xb1);		/* DCHG */
+	state0 = _mm_blend_epi16(tmp, state1, 0xf0);		/* DCBA */
+	state1 = _mm_alignr_epi8(state1, tmp, 8);		/* HGFE */
+	_mm_storeu_si128((__m128i *) &state[0], state0);
+	_mm_storeu_si128((__m128i *) &state[4], state1);
+}
+
+static bool
+SHA256_hw_supported(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+	    !(ecx & (1 << 9)) || !(ecx & (1 << 19)))	/* SSSE3, SSE4.1 */
+		return false;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return false;
+
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return ebx & (1 << 29);				/* SHA */
+}
+#endif
+
+#ifdef SHA256_ARM
+/* SHA256 using the ARMv8 cryptography extensions. */
+SHA256_ARM_ATTR
+static void
+SHA256_Blocks_hw(uint32_t *state, const unsigned char *data, size_t blocks)
+{
+	uint32x4_t state0, state1, abcd, efgh, msg, tmp, w[4];
+	int i;
+
+	state0 = vld1q_u32(&state[0]);
+	state1 = vld1q_u32(&state[4]);
+
+	while (blocks--) {
+		abcd = state0;
+		efgh = state1;
+
+		for (i = 0; i < 16; i++) {
+			if (i < 4)
+				w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+			else
+				/* W[i..i+3] from W[i-16..i-1] */
+				w[i & 3] = vsha256su1q_u32(vsha256su0q_u32(w[i & 3], w[(i + 1) & 3]),
+							   w[(i + 2) & 3], w[(i + 3) & 3]);
+
+			msg = vaddq_u32(w[i & 3], vld1q_u32(&SHA256_K[i * 4]));
+			tmp = state0;
+			state0 = vsha256hq_u32(state0, state1, msg);
+			state1 = vsha256h2q_u32(state1, tmp, msg);
+		}
+
+		state0 = vaddq_u32(state0, abcd);
+		state1 = vaddq_u32(state1, efgh);
+		data += SHA256_BLOCK_LENGTH;
+	}
+
+	vst1q_u32(&state[0], state0);
+	vst1q_u32(&state[4], state1);
+}
+
+static bool
+SHA256_hw_supported(void)
+{
+#if defined(__linux__) && defined(HWCAP_SHA2)
+	return getauxval(AT_HWCAP) & HWCAP_SHA2;
+#else
+	/* built for a CPU with the extensions */
+	return true;
+#endif
+}
+#endif
+
+static void (*SHA256_Blocks)(uint32_t *state, const unsigned char *data,
+			     size_t blocks) = SHA256_Blocks_generic;
+
+/* Select the fastest block function, before any threads are started. */
+static void
+SHA256_Select(void)
+{
+#if defined(SHA256_X86) || defined(SHA256_ARM)
+	if (!getenv("MKHASH_NO_HWACCEL") && SHA256_hw_supported())
+		SHA256_Blocks = SHA256_Blocks_hw;
+#endif
+}
+
 static unsigned char PAD[64] = {
 	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -585,7 +789,7 @@ SHA256_Pad(SHA256_CTX * ctx)
 	} else {
 		/* Finish the current block and mix. */
 		memcpy(&ctx->buf[r], PAD, 64 - r);
-		SHA256_Transform(ctx->state, ctx->buf);
+		SHA256_Blocks(ctx->state, ctx->buf, 1);
 
 		/* The start of the final block is all zeroes. */
 		memset(&ctx->buf[0], 0, 56);
@@ -595,7 +799,7 @@ SHA256_Pad(SHA256_CTX * ctx)
 	be64enc(&ctx->buf[56], ctx->count);
 
 	/* Mix in the final block. */
-	SHA256_Transform(ctx->state, ctx->buf);
+	SHA256_Blocks(ctx->state, ctx->buf, 1);
 }
 
 /* SHA-256 initialization.  Begins a SHA-256 operation. */
@@ -642,16 +846,14 @@ SHA256_Update(SHA256_CTX * ctx, const void *in, size_t len)
 
 	/* Finish the current block */
 	memcpy(&ctx->buf[r], src, 64 - r);
-	SHA256_Transform(ctx->state, ctx->buf);
+	SHA256_Blocks(ctx->state, ctx->buf, 1);
 	src += 64 - r;
 	len -= 64 - r;
 
 	/* Perform complete blocks */
-	while (len >= 64) {
-		SHA256_Transform(ctx->state, src);
-		src += 64;
-		len -= 64;
-	}
+	SHA256_Blocks(ctx->state, src, len / 64);
+	src += len & ~(size_t) 63;
+	len &= 63;
 
 	/* Copy left over data into buffer */
 	memcpy(ctx->buf, src, len);
@@ -674,69 +876,406 @@ SHA256_Final(unsigned char digest[static SHA256_DIGEST_LENGTH], SHA256_CTX *ctx)
 	memset(ctx, 0, sizeof(*ctx));
 }
 
-static void *hash_buf(FILE *f, int *len)
+#define SHA512_BLOCK_LENGTH		128
+#define SHA512_DIGEST_LENGTH		64
+
+typedef struct SHA512Context {
+	uint64_t state[8];
+	uint64_t count;
+	uint8_t buf[SHA512_BLOCK_LENGTH];
+} SHA512_CTX;
+
+/* SHA512 initial hash value, also used as the BLAKE2b IV */
+static const uint64_t SHA512_H0[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+	0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+	0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+/* SHA512 round constants. */
+static const uint64_t SHA512_K[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+	0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+	0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+	0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+	0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+	0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+	0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+	0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+	0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+	0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+	0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+	0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+	0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+#define ROTR64(x, n)	((x >> n) | (x << (64 - n)))
+
+/*
+ * SHA512 block compression function.  The 512-bit state is transformed via
+ * the 1024-bit input block to produce a new state.
+ */
+static void
+SHA512_Transform(uint64_t *state, const unsigned char block[128])
+{
+	uint64_t W[80];
+	uint64_t S[8];
+	uint64_t t1, t2;
+	int i;
+
+#define S0(x)		(ROTR64(x, 28) ^ ROTR64(x, 34) ^ ROTR64(x, 39))
+#define S1(x)		(ROTR64(x, 14) ^ ROTR64(x, 18) ^ ROTR64(x, 41))
+#define s0(x)		(ROTR64(x, 1) ^ ROTR64(x, 8) ^ (x >> 7))
+#define s1(x)		(ROTR64(x, 19) ^ ROTR64(x, 61) ^ (x >> 6))
+
+	for (i = 0; i < 16; i++)
+		W[i] = be64dec(block + i * 8);
+	for (; i < 80; i++)
+		W[i] = s1(W[i - 2]) + W[i - 7] + s0(W[i - 15]) + W[i - 16];
+
+	memcpy(S, state, sizeof(S));
+
+	for (i = 0; i < 80; i++) {
+		t1 = S[7] + S1(S[4]) + Ch(S[4], S[5], S[6]) + SHA512_K[i] + W[i];
+		t2 = S0(S[0]) + Maj(S[0], S[1], S[2]);
+		S[7] = S[6];
+		S[6] = S[5];
+		S[5] = S[4];
+		S[4] = S[3] + t1;
+		S[3] = S[2];
+		S[2] = S[1];
+		S[1] = S[0];
+		S[0] = t1 + t2;
+	}
+
+#undef S0
+#undef s0
+#undef S1
+#undef s1
+
+	for (i = 0; i < 8; i++)
+		state[i] += S[i];
+}
+
+static void
+SHA512_Init(SHA512_CTX *ctx)
+{
+	ctx->count = 0;
+	memcpy(ctx->state, SHA512_H0, sizeof(ctx->state));
+}
+
+static void
+SHA512_Update(SHA512_CTX *ctx, const void *in, size_t len)
+{
+	const unsigned char *src = in;
+	size_t r = ctx->count & 0x7f;
+
+	ctx->count += len;
+
+	if (r) {
+		if (len < 128 - r) {
+			memcpy(&ctx->buf[r], src, len);
+			return;
+		}
+
+		memcpy(&ctx->buf[r], src, 128 - r);
+		SHA512_Transform(ctx->state, ctx->buf);
+		src += 128 - r;
+		len -= 128 - r;
+	}
+
+	while (len >= 128) {
+		SHA512_Transform(ctx->state, src);
+		src += 128;
+		len -= 128;
+	}
+
+	memcpy(ctx->buf, src, len);
+}
+
+static void
+SHA512_Final(unsigned char digest[static SHA512_DIGEST_LENGTH], SHA512_CTX *ctx)
 {
-	static char buf[1024];
+	size_t r = ctx->count & 0x7f;
+	int i;
 
-	*len = fread(buf, 1, sizeof(buf), f);
+	/* Pad to 112 mod 128, followed by the 128-bit bit count */
+	ctx->buf[r++] = 0x80;
+	if (r > 112) {
+		memset(&ctx->buf[r], 0, 128 - r);
+		SHA512_Transform(ctx->state, ctx->buf);
+		r = 0;
+	}
+	memset(&ctx->buf[r], 0, 112 - r);
+	be64enc(&ctx->buf[112], ctx->count >> 61);
+	be64enc(&ctx->buf[120], ctx->count << 3);
+	SHA512_Transform(ctx->state, ctx->buf);
 
-	return *len > 0 ? buf : NULL;
+	for (i = 0; i < 8; i++)
+		be64enc(digest + i * 8, ctx->state[i]);
+
+	memset(ctx, 0, sizeof(*ctx));
 }
 
-static char *hash_string(unsigned char *buf, int len)
+/* BLAKE2b with a 512-bit digest and no key (RFC 7693). */
+#define BLAKE2B_BLOCK_LENGTH		128
+#define BLAKE2B_DIGEST_LENGTH		64
+
+typedef struct BLAKE2bContext {
+	uint64_t h[8];
+	uint64_t t[2];
+	size_t buflen;
+	uint8_t buf[BLAKE2B_BLOCK_LENGTH];
+} BLAKE2B_CTX;
+
+static const uint8_t BLAKE2B_SIGMA[12][16] = {
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+};
+
+static void
+BLAKE2b_Compress(BLAKE2B_CTX *ctx, const unsigned char block[128], bool last)
 {
-	static char str[SHA256_DIGEST_LENGTH * 2 + 1];
+	uint64_t m[16], v[16];
 	int i;
 
-	if (len * 2 + 1 > sizeof(str))
-		return NULL;
+#define B2B_G(a, b, c, d, x, y)				\
+	do {						\
+		v[a] = v[a] + v[b] + (x);		\
+		v[d] = ROTR64((v[d] ^ v[a]), 32);	\
+		v[c] = v[c] + v[d];			\
+		v[b] = ROTR64((v[b] ^ v[c]), 24);	\
+		v[a] = v[a] + v[b] + (y);		\
+		v[d] = ROTR64((v[d] ^ v[a]), 16);	\
+		v[c] = v[c] + v[d];			\
+		v[b] = ROTR64((v[b] ^ v[c]), 63);	\
+	} while (0)
+
+	for (i = 0; i < 16; i++)
+		m[i] = le64dec(block + i * 8);
+
+	memcpy(v, ctx->h, 64);
+	memcpy(v + 8, SHA512_H0, 64);
+	v[12] ^= ctx->t[0];
+	v[13] ^= ctx->t[1];
+	if (last)
+		v[14] = ~v[14];
+
+	for (i = 0; i < 12; i++) {
+		const uint8_t *s = BLAKE2B_SIGMA[i];
+
+		B2B_G(0, 4,  8, 12, m[s[0]],  m[s[1]]);
+		B2B_G(1, 5,  9, 13, m[s[2]],  m[s[3]]);
+		B2B_G(2, 6, 10, 14, m[s[4]],  m[s[5]]);
+		B2B_G(3, 7, 11, 15, m[s[6]],  m[s[7]]);
+		B2B_G(0, 5, 10, 15, m[s[8]],  m[s[9]]);
+		B2B_G(1, 6, 11, 12, m[s[10]], m[s[11]]);
+		B2B_G(2, 7,  8, 13, m[s[12]], m[s[13]]);
+		B2B_G(3, 4,  9, 14, m[s[14]], m[s[15]]);
+	}
 
-	for (i = 0; i < len; i++)
-		sprintf(&str[i * 2], "%02x", buf[i]);
+#undef B2B_G
 
-	return str;
+	for (i = 0; i < 8; i++)
+		ctx->h[i] ^= v[i] ^ v[i + 8];
 }
 
-static const char *md5_hash(FILE *f)
+static void
+BLAKE2b_Count(BLAKE2B_CTX *ctx, size_t len)
 {
-	MD5_CTX ctx;
-	unsigned char val[MD5_DIGEST_LENGTH];
-	void *buf;
-	int len;
+	ctx->t[0] += len;
+	if (ctx->t[0] < len)
+		ctx->t[1]++;
+}
 
-	MD5_begin(&ctx);
-	while ((buf = hash_buf(f, &len)) != NULL)
-		MD5_hash(buf, len, &ctx);
-	MD5_end(val, &ctx);
+static void
+BLAKE2b_Init(BLAKE2B_CTX *ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	memcpy(ctx->h, SHA512_H0, sizeof(ctx->h));
 
-	return hash_string(val, MD5_DIGEST_LENGTH);
+	/* digest length, no key, fanout and depth 1 */
+	ctx->h[0] ^= 0x01010000 | BLAKE2B_DIGEST_LENGTH;
 }
 
-static const char *sha256_hash(FILE *f)
+static void
+BLAKE2b_Update(BLAKE2B_CTX *ctx, const void *in, size_t len)
 {
-	SHA256_CTX ctx;
-	unsigned char val[SHA256_DIGEST_LENGTH];
-	void *buf;
-	int len;
+	const unsigned char *src = in;
+	size_t n = 128 - ctx->buflen;
+
+	/* The last block is compressed differently, always keep it buffered */
+	if (len > n) {
+		memcpy(&ctx->buf[ctx->buflen], src, n);
+		BLAKE2b_Count(ctx, 128);
+		BLAKE2b_Compress(ctx, ctx->buf, false);
+		ctx->buflen = 0;
+		src += n;
+		len -= n;
+
+		while (len > 128) {
+			BLAKE2b_Count(ctx, 128);
+			BLAKE2b_Compress(ctx, src, false);
+			src += 128;
+			len -= 128;
+		}
+	}
+
+	memcpy(&ctx->buf[ctx->buflen], src, len);
+	ctx->buflen += len;
+}
+
+static void
+BLAKE2b_Final(unsigned char digest[static BLAKE2B_DIGEST_LENGTH], BLAKE2B_CTX *ctx)
+{
+	int i;
+
+	BLAKE2b_Count(ctx, ctx->buflen);
+	memset(&ctx->buf[ctx->buflen], 0, 128 - ctx->buflen);
+	BLAKE2b_Compress(ctx, ctx->buf, true);
+
+	for (i = 0; i < 8; i++)
+		le64enc(digest + i * 8, ctx->h[i]);
+
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+#define HASH_MAX_DIGEST_LENGTH	64
+#define HASH_READ_SIZE		(128 * 1024)
+
+union hash_ctx {
+	MD5_CTX md5;
+	SHA256_CTX sha256;
+	SHA512_CTX sha512;
+	BLAKE2B_CTX blake2b;
+};
+
+static void md5_init(union hash_ctx *ctx)
+{
+	MD5_begin(&ctx->md5);
+}
+
+static void md5_update(union hash_ctx *ctx, const void *buf, size_t len)
+{
+	MD5_hash(buf, len, &ctx->md5);
+}
 
-	SHA256_Init(&ctx);
-	while ((buf = hash_buf(f, &len)) != NULL)
-		SHA256_Update(&ctx, buf, len);
-	SHA256_Final(val, &ctx);
+static void md5_final(unsigned char *val, union hash_ctx *ctx)
+{
+	MD5_end(val, &ctx->md5);
+}
+
+static void sha256_init(union hash_ctx *ctx)
+{
+	SHA256_Init(&ctx->sha256);
+}
+
+static void sha256_update(union hash_ctx *ctx, const void *buf, size_t len)
+{
+	SHA256_Update(&ctx->sha256, buf, len);
+}
+
+static void sha256_final(unsigned char *val, union hash_ctx *ctx)
+{
+	SHA256_Final(val, &ctx->sha256);
+}
 
-	return hash_string(val, SHA256_DIGEST_LENGTH);
+static void sha512_init(union hash_ctx *ctx)
+{
+	SHA512_Init(&ctx->sha512);
+}
+
+static void sha512_update(union hash_ctx *ctx, const void *buf, size_t len)
+{
+	SHA512_Update(&ctx->sha512, buf, len);
+}
+
+static void sha512_final(unsigned char *val, union hash_ctx *ctx)
+{
+	SHA512_Final(val, &ctx->sha512);
+}
+
+static void blake2b_init(union hash_ctx *ctx)
+{
+	BLAKE2b_Init(&ctx->blake2b);
+}
+
+static void blake2b_update(union hash_ctx *ctx, const void *buf, size_t len)
+{
+	BLAKE2b_Update(&ctx->blake2b, buf, len);
+}
+
+static void blake2b_final(unsigned char *val, union hash_ctx *ctx)
+{
+	BLAKE2b_Final(val, &ctx->blake2b);
 }
 
 
 struct hash_type {
 	const char *name;
-	const char *(*func)(FILE *f);
+	void (*init)(union hash_ctx *ctx);
+	void (*update)(union hash_ctx *ctx, const void *buf, size_t len);
+	void (*final)(unsigned char *val, union hash_ctx *ctx);
 	int len;
 };
 
 struct hash_type types[] = {
-	{ "md5", md5_hash, MD5_DIGEST_LENGTH },
-	{ "sha256", sha256_hash, SHA256_DIGEST_LENGTH },
+	{ "md5", md5_init, md5_update, md5_final, MD5_DIGEST_LENGTH },
+	{ "sha256", sha256_init, sha256_update, sha256_final, SHA256_DIGEST_LENGTH },
+	{ "sha512", sha512_init, sha512_update, sha512_final, SHA512_DIGEST_LENGTH },
+	{ "blake2b", blake2b_init, blake2b_update, blake2b_final, BLAKE2B_DIGEST_LENGTH },
+};
+
+enum hash_status {
+	HASH_OK,
+	HASH_ERR_OPEN,
+	HASH_ERR_DIR,
+	HASH_ERR_READ,
+};
+
+struct hash_job {
+	const char *filename;
+	enum hash_status status;
+	bool done;
+	char str[HASH_MAX_DIGEST_LENGTH * 2 + 1];
 };
 
 
@@ -748,6 +1287,9 @@ static int usage(const char *progname)
 		"Options:\n"
 		"	-n		Print filename(s)\n"
 		"	-N		Suppress trailing newline\n"
+		"	-f <file>	Read the names of the files to hash from <file>,\n"
+		"			one per line, '-' for stdin\n"
+		"	-j <jobs>	Hash files in parallel, 0 for one job per CPU\n"
 		"\n"
 		"Supported hash types:", progname);
 
@@ -771,42 +1313,237 @@ static struct hash_type *get_hash_type(const char *name)
 	return NULL;
 }
 
+static void hash_string(char *str, unsigned char *buf, int len)
+{
+	static const char hex[] = "0123456789abcdef";
+	int i;
 
-static int hash_file(struct hash_type *t, const char *filename, bool add_filename,
-	bool no_newline)
+	for (i = 0; i < len; i++) {
+		str[i * 2] = hex[buf[i] >> 4];
+		str[i * 2 + 1] = hex[buf[i] & 0xf];
+	}
+	str[len * 2] = 0;
+}
+
+static enum hash_status hash_fd(struct hash_type *t, int fd, char *str)
 {
-	const char *str;
+	unsigned char val[HASH_MAX_DIGEST_LENGTH];
+	union hash_ctx ctx;
+	unsigned char *buf;
+	ssize_t len;
 
-	if (!filename || !strcmp(filename, "-")) {
-		str = t->func(stdin);
-	} else {
-		struct stat path_stat;
-		stat(filename, &path_stat);
-		if (S_ISDIR(path_stat.st_mode)) {
-			fprintf(stderr, "Failed to open '%s': Is a directory\n", filename);
-			return 1;
-		}
+	buf = malloc(HASH_READ_SIZE);
+	if (!buf)
+		return HASH_ERR_READ;
 
-		FILE *f = fopen(filename, "r");
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 
-		if (!f) {
-			fprintf(stderr, "Failed to open '%s'\n", filename);
-			return 1;
+	t->init(&ctx);
+	while ((len = read(fd, buf, HASH_READ_SIZE)) != 0) {
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			free(buf);
+			return HASH_ERR_READ;
 		}
-		str = t->func(f);
-		fclose(f);
+		t->update(&ctx, buf, len);
+	}
+	t->final(val, &ctx);
+	free(buf);
+
+	hash_string(str, val, t->len);
+	return HASH_OK;
+}
+
+static void hash_job_run(struct hash_type *t, struct hash_job *job)
+{
+	struct stat path_stat;
+	int fd;
+
+	if (!job->filename || !strcmp(job->filename, "-")) {
+		job->status = hash_fd(t, STDIN_FILENO, job->str);
+		return;
+	}
+
+	fd = open(job->filename, O_RDONLY);
+	if (fd < 0) {
+		job->status = HASH_ERR_OPEN;
+		return;
 	}
 
-	if (!str) {
+	if (!fstat(fd, &path_stat) && S_ISDIR(path_stat.st_mode))
+		job->status = HASH_ERR_DIR;
+	else
+		job->status = hash_fd(t, fd, job->str);
+
+	close(fd);
+}
+
+static int hash_job_print(struct hash_job *job, bool add_filename,
+	bool no_newline)
+{
+	switch (job->status) {
+	case HASH_OK:
+		break;
+	case HASH_ERR_DIR:
+		fprintf(stderr, "Failed to open '%s': Is a directory\n", job->filename);
+		return 1;
+	case HASH_ERR_OPEN:
+		fprintf(stderr, "Failed to open '%s'\n", job->filename);
+		return 1;
+	default:
 		fprintf(stderr, "Failed to generate hash\n");
 		return 1;
 	}
 
 	if (add_filename)
-		printf("%s %s%s", str, filename ? filename : "-",
+		printf("%s %s%s", job->str, job->filename ? job->filename : "-",
 			no_newline ? "" : "\n");
 	else
-		printf("%s%s", str, no_newline ? "" : "\n");
+		printf("%s%s", job->str, no_newline ? "" : "\n");
+	return 0;
+}
+
+
+/*
+ * Worker pool for -j: workers take the next file from the list, the main
+ * thread prints the results in list order.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct hash_type *type;
+	struct hash_job *jobs;
+	int n_jobs;
+	int next;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void *hash_worker(void *arg)
+{
+	struct hash_job *job;
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.next < pool.n_jobs) {
+		job = &pool.jobs[pool.next++];
+		pthread_mutex_unlock(&pool.lock);
+
+		hash_job_run(pool.type, job);
+
+		pthread_mutex_lock(&pool.lock);
+		job->done = true;
+		pthread_cond_broadcast(&pool.cond);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return NULL;
+}
+
+static int hash_files(struct hash_type *t, struct hash_job *jobs, int n_jobs,
+	int n_threads, bool add_filename, bool no_newline)
+{
+	pthread_t *threads;
+	int i, ret = 0;
+
+	if (n_threads > n_jobs)
+		n_threads = n_jobs;
+
+	if (n_threads < 2) {
+		for (i = 0; i < n_jobs && !ret; i++) {
+			hash_job_run(t, &jobs[i]);
+			ret = hash_job_print(&jobs[i], add_filename, no_newline);
+		}
+		return ret;
+	}
+
+	pool.type = t;
+	pool.jobs = jobs;
+	pool.n_jobs = n_jobs;
+
+	threads = calloc(n_threads, sizeof(*threads));
+	if (!threads)
+		return 1;
+
+	for (i = 0; i < n_threads; i++) {
+		if (pthread_create(&threads[i], NULL, hash_worker, NULL)) {
+			n_threads = i;
+			break;
+		}
+	}
+
+	/* Without any worker, hash in this thread */
+	if (!n_threads)
+		hash_worker(NULL);
+
+	for (i = 0; i < n_jobs && !ret; i++) {
+		pthread_mutex_lock(&pool.lock);
+		while (!jobs[i].done)
+			pthread_cond_wait(&pool.cond, &pool.lock);
+		pthread_mutex_unlock(&pool.lock);
+
+		ret = hash_job_print(&jobs[i], add_filename, no_newline);
+	}
+
+	/* Stop at the first error, like the sequential loop */
+	pthread_mutex_lock(&pool.lock);
+	pool.next = pool.n_jobs;
+	pthread_mutex_unlock(&pool.lock);
+
+	for (i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	return ret;
+}
+
+static int add_job(struct hash_job **jobs, int *n_jobs, const char *filename)
+{
+	struct hash_job *new_jobs;
+
+	if (!(*n_jobs & (*n_jobs - 1))) {
+		new_jobs = realloc(*jobs, (*n_jobs ? *n_jobs * 2 : 1) * sizeof(**jobs));
+		if (!new_jobs)
+			return -1;
+		*jobs = new_jobs;
+	}
+
+	memset(&(*jobs)[*n_jobs], 0, sizeof(**jobs));
+	(*jobs)[(*n_jobs)++].filename = filename;
+	return 0;
+}
+
+static int add_job_list(struct hash_job **jobs, int *n_jobs, const char *list)
+{
+	FILE *f = stdin;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+
+	if (strcmp(list, "-") != 0 && !(f = fopen(list, "r"))) {
+		fprintf(stderr, "Failed to open '%s'\n", list);
+		return -1;
+	}
+
+	while ((len = getline(&line, &size, f)) > 0) {
+		if (line[len - 1] == '\n')
+			line[--len] = 0;
+		if (!len)
+			continue;
+		if (add_job(jobs, n_jobs, strdup(line)) ||
+		    !(*jobs)[*n_jobs - 1].filename) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+	free(line);
+
+	if (f != stdin)
+		fclose(f);
+
 	return 0;
 }
 
@@ -814,12 +1551,22 @@ static int hash_file(struct hash_type *t, const char *filename, bool add_filenam
 int main(int argc, char **argv)
 {
 	struct hash_type *t;
+	struct hash_job *jobs = NULL;
 	const char *progname = argv[0];
-	int i, ch;
+	const char *list = NULL;
+	int i, ch, n_jobs = 0, n_threads = 1;
 	bool add_filename = false, no_newline = false;
 
-	while ((ch = getopt(argc, argv, "nN")) != -1) {
+	while ((ch = getopt(argc, argv, "f:j:nN")) != -1) {
 		switch (ch) {
+		case 'f':
+			list = optarg;
+			break;
+		case 'j':
+			n_threads = atoi(optarg);
+			if (n_threads <= 0)
+				n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+			break;
 		case 'n':
 			add_filename = true;
 			break;
@@ -841,14 +1588,18 @@ int main(int argc, char **argv)
 	if (!t)
 		return usage(progname);
 
-	if (argc < 2)
-		return hash_file(t, NULL, add_filename, no_newline);
+	SHA256_Select();
 
-	for (i = 0; i < argc - 1; i++) {
-		int ret = hash_file(t, argv[1 + i], add_filename, no_newline);
-		if (ret)
-			return ret;
-	}
+	for (i = 1; i < argc; i++)
+		if (add_job(&jobs, &n_jobs, argv[i]))
+			return 1;
 
-	return 0;
+	if (list && add_job_list(&jobs, &n_jobs, list))
+		return 1;
+
+	/* No files at all, hash stdin */
+	if (!n_jobs && !list && add_job(&jobs, &n_jobs, NULL))
+		return 1;
+
+	return hash_files(t, jobs, n_jobs, n_threads, add_filename, no_newline);
 }
@@ -0,0 +1,8 @@
+#ifndef __NMBM_SIM_CRC32_H
+#define __NMBM_SIM_CRC32_H
+
+#include <linux/kernel.h>
+
+u32 crc32_le(u32 crc, const unsigned char *p, size_t len);
+
+#endif
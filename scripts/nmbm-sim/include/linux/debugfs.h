@@ -0,0 +1,31 @@
+#ifndef __NMBM_SIM_DEBUGFS_H
+#define __NMBM_SIM_DEBUGFS_H
+
+#include <linux/kernel.h>
+
+/*
+ * debugfs files are kept in a flat table, so that the simulator can call
+ * their handlers directly.
+ */
+struct dentry {
+	const char *name;
+};
+
+struct file_operations {
+	int (*get)(void *data, u64 *val);
+	int (*set)(void *data, u64 val);
+	const char *fmt;
+};
+
+#define DEFINE_DEBUGFS_ATTRIBUTE(__fops, __get, __set, __fmt)		\
+	static const struct file_operations __fops = {			\
+		.get = __get, .set = __set, .fmt = __fmt,		\
+	}
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent);
+struct dentry *debugfs_create_file_unsafe(const char *name, int mode,
+					  struct dentry *parent, void *data,
+					  const struct file_operations *fops);
+void debugfs_remove_recursive(struct dentry *dentry);
+
+#endif
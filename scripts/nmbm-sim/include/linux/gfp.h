@@ -0,0 +1 @@
+#include <linux/slab.h>
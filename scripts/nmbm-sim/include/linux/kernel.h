@@ -0,0 +1,121 @@
+/*
+ * Minimal kernel API for building the MediaTek BMT code on the host.
+ *
+ * Only what mtk_bmt*.c use is provided, everything else is left out on
+ * purpose so that new dependencies show up as build errors.
+ */
+#ifndef __NMBM_SIM_KERNEL_H
+#define __NMBM_SIM_KERNEL_H
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int32_t s32;
+typedef long long s64;
+typedef uint32_t __be32;
+typedef unsigned char u_char;
+
+/* uint64_t is u64 in the kernel, printed with %llx */
+#define uint64_t u64
+
+#define KERN_ERR	""
+#define KERN_WARNING	""
+#define KERN_NOTICE	""
+#define KERN_INFO	""
+#define KERN_DEBUG	""
+
+extern int sim_log_level;
+
+#define printk(...)		sim_printk(__VA_ARGS__)
+#define pr_info(...)		sim_printk(__VA_ARGS__)
+#define pr_notice(...)		sim_printk(__VA_ARGS__)
+#define pr_debug(...)		do { if (0) sim_printk(__VA_ARGS__); } while (0)
+
+static inline __attribute__((format(printf, 1, 2)))
+int sim_printk(const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	if (!sim_log_level)
+		return 0;
+
+	va_start(ap, fmt);
+	ret = vfprintf(stderr, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+#define DUMP_PREFIX_NONE	0
+#define DUMP_PREFIX_OFFSET	1
+
+static inline void print_hex_dump(const char *level, const char *prefix,
+				  int type, int rowsize, int groupsize,
+				  const void *buf, size_t len, bool ascii)
+{
+}
+
+#define min_t(type, x, y)	({ type __x = (x); type __y = (y); __x < __y ? __x : __y; })
+#define max_t(type, x, y)	({ type __x = (x); type __y = (y); __x > __y ? __x : __y; })
+#define min(x, y)		((x) < (y) ? (x) : (y))
+#define max(x, y)		((x) > (y) ? (x) : (y))
+
+#define ALIGN(x, a)		(((x) + (a) - 1) & ~((typeof(x))(a) - 1))
+#define round_up(x, y)		((((x) - 1) | ((typeof(x))(y) - 1)) + 1)
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+
+#define BITS_PER_LONG		(8 * sizeof(long))
+#define BIT(nr)			(1UL << (nr))
+#define BIT_WORD(nr)		((nr) / BITS_PER_LONG)
+
+static inline void set_bit(int nr, unsigned long *addr)
+{
+	addr[nr / BITS_PER_LONG] |= 1UL << (nr % BITS_PER_LONG);
+}
+
+static inline void clear_bit(int nr, unsigned long *addr)
+{
+	addr[nr / BITS_PER_LONG] &= ~(1UL << (nr % BITS_PER_LONG));
+}
+
+static inline int test_bit(int nr, const unsigned long *addr)
+{
+	return (addr[nr / BITS_PER_LONG] >> (nr % BITS_PER_LONG)) & 1;
+}
+
+static inline void *memchr_inv(const void *s, int c, size_t n)
+{
+	const u8 *p = s;
+
+	for (; n; p++, n--)
+		if (*p != (u8)c)
+			return (void *)p;
+
+	return NULL;
+}
+
+#define be32_to_cpu(x)		__builtin_bswap32(x)
+#define cpu_to_be32(x)		__builtin_bswap32(x)
+
+#ifndef EUCLEAN
+#define EUCLEAN			117
+#endif
+
+#define S_IWUSR			0200
+
+#endif
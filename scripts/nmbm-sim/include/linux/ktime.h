@@ -0,0 +1,33 @@
+#ifndef __NMBM_SIM_KTIME_H
+#define __NMBM_SIM_KTIME_H
+
+#include <linux/kernel.h>
+#include <time.h>
+
+typedef s64 ktime_t;
+
+static inline ktime_t ktime_get(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (s64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline ktime_t ktime_sub(ktime_t a, ktime_t b)
+{
+	return a - b;
+}
+
+static inline s64 ktime_to_ns(ktime_t kt)
+{
+	return kt;
+}
+
+static inline s64 ktime_to_us(ktime_t kt)
+{
+	return kt / 1000;
+}
+
+#endif
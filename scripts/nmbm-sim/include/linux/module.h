@@ -0,0 +1,8 @@
+#ifndef __NMBM_SIM_MODULE_H
+#define __NMBM_SIM_MODULE_H
+
+#define MODULE_LICENSE(x)
+#define MODULE_AUTHOR(x)
+#define MODULE_DESCRIPTION(x)
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef __NMBM_SIM_MTD_H
+#define __NMBM_SIM_MTD_H
+
+#include <linux/kernel.h>
+#include <linux/of.h>
+
+enum {
+	MTD_OPS_PLACE_OOB = 0,
+	MTD_OPS_AUTO_OOB = 1,
+	MTD_OPS_RAW = 2,
+};
+
+struct mtd_oob_ops {
+	unsigned int mode;
+	size_t len;
+	size_t retlen;
+	size_t ooblen;
+	size_t oobretlen;
+	uint32_t ooboffs;
+	uint8_t *datbuf;
+	uint8_t *oobbuf;
+};
+
+struct erase_info {
+	uint64_t addr;
+	uint64_t len;
+	uint64_t fail_addr;
+};
+
+struct mtd_info {
+	const char *name;
+	uint64_t size;
+	uint32_t erasesize;
+	uint32_t erasesize_mask;
+	uint32_t writesize;
+	uint32_t oobsize;
+	uint32_t oobavail;
+	unsigned int bitflip_threshold;
+	unsigned int ecc_strength;
+
+	int (*_read_oob)(struct mtd_info *mtd, loff_t from,
+			 struct mtd_oob_ops *ops);
+	int (*_write_oob)(struct mtd_info *mtd, loff_t to,
+			  struct mtd_oob_ops *ops);
+	int (*_erase)(struct mtd_info *mtd, struct erase_info *instr);
+	int (*_block_isbad)(struct mtd_info *mtd, loff_t ofs);
+	int (*_block_markbad)(struct mtd_info *mtd, loff_t ofs);
+
+	struct device_node *of_node;
+	void *priv;
+};
+
+static inline struct device_node *mtd_get_of_node(struct mtd_info *mtd)
+{
+	return mtd->of_node;
+}
+
+static inline int mtd_oobavail(struct mtd_info *mtd, struct mtd_oob_ops *ops)
+{
+	return ops->mode == MTD_OPS_AUTO_OOB ? mtd->oobavail : mtd->oobsize;
+}
+
+static inline int mtd_is_bitflip(int err)
+{
+	return err == -EUCLEAN;
+}
+
+static inline int mtd_is_eccerr(int err)
+{
+	return err == -EBADMSG;
+}
+
+#endif
@@ -0,0 +1 @@
+#include <linux/mtd/mtd.h>
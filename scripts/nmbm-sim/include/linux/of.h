@@ -0,0 +1,74 @@
+#ifndef __NMBM_SIM_OF_H
+#define __NMBM_SIM_OF_H
+
+#include <linux/kernel.h>
+
+struct property {
+	const char *name;
+	const void *value;
+	int length;
+};
+
+/* properties are terminated by an entry without name */
+struct device_node {
+	const struct property *properties;
+};
+
+static inline const void *of_get_property(const struct device_node *np,
+					  const char *name, int *lenp)
+{
+	const struct property *pp;
+
+	for (pp = np ? np->properties : NULL; pp && pp->name; pp++) {
+		if (strcmp(pp->name, name))
+			continue;
+
+		if (lenp)
+			*lenp = pp->length;
+		return pp->value;
+	}
+
+	if (lenp)
+		*lenp = 0;
+	return NULL;
+}
+
+static inline bool of_property_read_bool(const struct device_node *np,
+					 const char *name)
+{
+	return of_get_property(np, name, NULL) != NULL;
+}
+
+static inline int of_property_read_u32(const struct device_node *np,
+				       const char *name, u32 *out)
+{
+	const __be32 *val;
+	int len;
+
+	val = of_get_property(np, name, &len);
+	if (!val)
+		return -EINVAL;
+	if (len < sizeof(*val))
+		return -EOVERFLOW;
+
+	*out = be32_to_cpu(*val);
+	return 0;
+}
+
+static inline int of_property_read_u8(const struct device_node *np,
+				      const char *name, u8 *out)
+{
+	const u8 *val;
+	int len;
+
+	val = of_get_property(np, name, &len);
+	if (!val)
+		return -EINVAL;
+	if (len < sizeof(*val))
+		return -EOVERFLOW;
+
+	*out = *val;
+	return 0;
+}
+
+#endif
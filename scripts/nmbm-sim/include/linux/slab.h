@@ -0,0 +1,28 @@
+#ifndef __NMBM_SIM_SLAB_H
+#define __NMBM_SIM_SLAB_H
+
+#include <linux/kernel.h>
+
+#define GFP_KERNEL	0
+
+static inline void *kmalloc(size_t size, int flags)
+{
+	return malloc(size);
+}
+
+static inline void *kzalloc(size_t size, int flags)
+{
+	return calloc(1, size);
+}
+
+static inline void *kcalloc(size_t n, size_t size, int flags)
+{
+	return calloc(n, size);
+}
+
+static inline void kfree(const void *ptr)
+{
+	free((void *)ptr);
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * Host implementations of the kernel helpers used by the BMT code
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/crc32.h>
+#include <linux/debugfs.h>
+
+#include "sim.h"
+
+int sim_log_level;
+
+static struct sim_debugfs_file debugfs_files[SIM_DEBUGFS_MAX];
+static struct dentry debugfs_root = { .name = "mtk-bmt" };
+
+u32 crc32_le(u32 crc, const unsigned char *p, size_t len)
+{
+	static u32 table[256];
+	u32 i, j, c;
+
+	if (!table[1]) {
+		for (i = 0; i < 256; i++) {
+			for (c = i, j = 0; j < 8; j++)
+				c = (c >> 1) ^ (c & 1 ? 0xedb88320 : 0);
+			table[i] = c;
+		}
+	}
+
+	while (len--)
+		crc = (crc >> 8) ^ table[(crc ^ *p++) & 0xff];
+
+	return crc;
+}
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent)
+{
+	return &debugfs_root;
+}
+
+struct dentry *debugfs_create_file_unsafe(const char *name, int mode,
+					  struct dentry *parent, void *data,
+					  const struct file_operations *fops)
+{
+	int i;
+
+	for (i = 0; i < SIM_DEBUGFS_MAX; i++) {
+		if (debugfs_files[i].name)
+			continue;
+
+		debugfs_files[i].name = name;
+		debugfs_files[i].data = data;
+		debugfs_files[i].fops = fops;
+		break;
+	}
+
+	return &debugfs_root;
+}
+
+void debugfs_remove_recursive(struct dentry *dentry)
+{
+	memset(debugfs_files, 0, sizeof(debugfs_files));
+}
+
+const struct sim_debugfs_file *sim_debugfs_lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i < SIM_DEBUGFS_MAX; i++)
+		if (debugfs_files[i].name && !strcmp(debugfs_files[i].name, name))
+			return &debugfs_files[i];
+
+	return NULL;
+}
@@ -0,0 +1,439 @@
+/*
+ * Simulated NAND flash for host testing of the MediaTek BMT code
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Blocks are allocated on first program, erased blocks read back as 0xff,
+ * so large chips only cost memory for the blocks actually written.
+ * Programming follows NAND semantics: bits can only be cleared until the
+ * next erase.
+ */
+
+#include "nandsim.h"
+
+#define NANDSIM_BBM_OFFSET	0
+
+static const struct nandsim_timing nandsim_default_timing = {
+	.t_read_ns = 25000,
+	.t_prog_ns = 250000,
+	.t_erase_ns = 2000000,
+	.bus_mbps = 40,
+};
+
+static struct nandsim *mtd_to_ns(struct mtd_info *mtd)
+{
+	return mtd->priv;
+}
+
+static double nandsim_rand(struct nandsim *ns)
+{
+	return (double)rand_r(&ns->rand_state) / ((double)RAND_MAX + 1);
+}
+
+static bool nandsim_chance(struct nandsim *ns, double rate)
+{
+	return rate > 0 && nandsim_rand(ns) < rate;
+}
+
+static u64 nandsim_xfer_ns(struct nandsim *ns, size_t len)
+{
+	return (u64)len * 1000 / ns->timing.bus_mbps;
+}
+
+static u8 *nandsim_page(struct nandsim *ns, u32 block, u32 page, bool alloc)
+{
+	u8 *blk = ns->blocks[block];
+
+	if (!blk && alloc) {
+		size_t len = (size_t)ns->pages_per_block * ns->raw_page_size;
+
+		blk = malloc(len);
+		if (!blk)
+			abort();
+
+		memset(blk, 0xff, len);
+		ns->blocks[block] = blk;
+	}
+
+	if (!blk)
+		return NULL;
+
+	return blk + (size_t)page * ns->raw_page_size;
+}
+
+/* Returns true if the operation may proceed, false on power loss */
+static bool nandsim_power_op(struct nandsim *ns, bool *interrupted)
+{
+	*interrupted = false;
+
+	if (ns->powered_off)
+		return false;
+
+	if (!ns->power_cut_at)
+		return true;
+
+	if (++ns->power_ops < ns->power_cut_at)
+		return true;
+
+	ns->powered_off = true;
+	*interrupted = true;
+
+	return true;
+}
+
+static int nandsim_locate(struct nandsim *ns, loff_t addr, u32 *block,
+			  u32 *page)
+{
+	if (addr < 0 || addr >= ns->cfg.size || addr % ns->cfg.page_size)
+		return -EINVAL;
+
+	*block = addr / ns->cfg.block_size;
+	*page = (addr % ns->cfg.block_size) / ns->cfg.page_size;
+
+	return 0;
+}
+
+static int nandsim_read_oob(struct mtd_info *mtd, loff_t from,
+			    struct mtd_oob_ops *ops)
+{
+	struct nandsim *ns = mtd_to_ns(mtd);
+	u32 block, page, ooblen, max_bitflips = 0;
+	int ret = 0;
+
+	ops->retlen = 0;
+	ops->oobretlen = 0;
+
+	if (ns->powered_off)
+		return -EIO;
+
+	while (ops->retlen < ops->len || ops->oobretlen < ops->ooblen) {
+		size_t len = min_t(size_t, ops->len - ops->retlen,
+				   ns->cfg.page_size);
+		u8 *raw;
+
+		if (nandsim_locate(ns, from, &block, &page))
+			return -EINVAL;
+
+		raw = nandsim_page(ns, block, page, false);
+		ns->stats.page_reads++;
+		ns->stats.time_ns += ns->timing.t_read_ns +
+				     nandsim_xfer_ns(ns, ns->raw_page_size);
+
+		if (ops->datbuf) {
+			if (raw)
+				memcpy(ops->datbuf + ops->retlen, raw, len);
+			else
+				memset(ops->datbuf + ops->retlen, 0xff, len);
+		}
+
+		ooblen = min_t(size_t, ops->ooblen - ops->oobretlen,
+			       ns->cfg.oob_size - ops->ooboffs);
+		if (ops->oobbuf && ooblen) {
+			u8 *oob = ops->oobbuf + ops->oobretlen;
+
+			if (raw)
+				memcpy(oob, raw + ns->cfg.page_size +
+				       ops->ooboffs, ooblen);
+			else
+				memset(oob, 0xff, ooblen);
+		}
+
+		if (nandsim_chance(ns, ns->cfg.eccerr_rate)) {
+			ns->stats.eccerrs++;
+			if (ops->datbuf && len)
+				ops->datbuf[ops->retlen] ^= 0x5a;
+			ret = -EBADMSG;
+		} else if (nandsim_chance(ns, ns->cfg.bitflip_rate)) {
+			u32 flips = 1 + rand_r(&ns->rand_state) %
+				    ns->cfg.ecc_strength;
+
+			ns->stats.bitflips += flips;
+			max_bitflips = max(max_bitflips, flips);
+		}
+
+		ops->retlen += ops->datbuf ? len : 0;
+		ops->oobretlen += ops->oobbuf ? ooblen : 0;
+		ops->ooboffs = 0;
+		from += ns->cfg.page_size;
+
+		if (!ops->datbuf && !ops->oobbuf)
+			break;
+	}
+
+	return ret ? ret : max_bitflips;
+}
+
+static void nandsim_program(u8 *dst, const u8 *src, size_t len)
+{
+	while (len--)
+		*dst++ &= *src++;
+}
+
+static int nandsim_write_oob(struct mtd_info *mtd, loff_t to,
+			     struct mtd_oob_ops *ops)
+{
+	struct nandsim *ns = mtd_to_ns(mtd);
+	u32 block, page, ooblen;
+	bool cut;
+
+	ops->retlen = 0;
+	ops->oobretlen = 0;
+
+	while (ops->retlen < ops->len || ops->oobretlen < ops->ooblen) {
+		size_t len = min_t(size_t, ops->len - ops->retlen,
+				   ns->cfg.page_size);
+		u8 *raw;
+
+		if (nandsim_locate(ns, to, &block, &page))
+			return -EINVAL;
+
+		if (!nandsim_power_op(ns, &cut))
+			return -EIO;
+
+		raw = nandsim_page(ns, block, page, true);
+		ns->stats.page_writes++;
+		ns->stats.time_ns += ns->timing.t_prog_ns +
+				     nandsim_xfer_ns(ns, ns->raw_page_size);
+
+		if (ops->datbuf)
+			nandsim_program(raw, ops->datbuf + ops->retlen,
+					cut ? len / 2 : len);
+
+		ooblen = min_t(size_t, ops->ooblen - ops->oobretlen,
+			       ns->cfg.oob_size - ops->ooboffs);
+		if (ops->oobbuf && ooblen && !cut)
+			nandsim_program(raw + ns->cfg.page_size + ops->ooboffs,
+					ops->oobbuf + ops->oobretlen, ooblen);
+
+		if (cut)
+			return -EIO;
+
+		if (nandsim_chance(ns, ns->cfg.prog_fail_rate)) {
+			ns->stats.prog_fails++;
+			raw[0] &= 0xa5;
+			return -EIO;
+		}
+
+		ops->retlen += ops->datbuf ? len : 0;
+		ops->oobretlen += ops->oobbuf ? ooblen : 0;
+		ops->ooboffs = 0;
+		to += ns->cfg.page_size;
+
+		if (!ops->datbuf && !ops->oobbuf)
+			break;
+	}
+
+	return 0;
+}
+
+static int nandsim_erase(struct mtd_info *mtd, struct erase_info *instr)
+{
+	struct nandsim *ns = mtd_to_ns(mtd);
+	u32 block, page;
+	bool cut;
+
+	if (nandsim_locate(ns, instr->addr, &block, &page) || page)
+		return -EINVAL;
+
+	if (!nandsim_power_op(ns, &cut))
+		return -EIO;
+
+	ns->stats.block_erases++;
+	ns->stats.time_ns += ns->timing.t_erase_ns;
+
+	if (cut) {
+		/* interrupted erase: only the first half of the block is clean */
+		u8 *raw = nandsim_page(ns, block, 0, true);
+
+		memset(raw, 0xff, (size_t)ns->pages_per_block / 2 *
+		       ns->raw_page_size);
+		instr->fail_addr = instr->addr;
+		return -EIO;
+	}
+
+	if (nandsim_chance(ns, ns->cfg.erase_fail_rate)) {
+		ns->stats.erase_fails++;
+		instr->fail_addr = instr->addr;
+		return -EIO;
+	}
+
+	free(ns->blocks[block]);
+	ns->blocks[block] = NULL;
+
+	return 0;
+}
+
+static int nandsim_block_isbad(struct mtd_info *mtd, loff_t ofs)
+{
+	struct nandsim *ns = mtd_to_ns(mtd);
+	u32 block, page;
+	u8 *raw;
+
+	if (nandsim_locate(ns, ofs, &block, &page))
+		return -EINVAL;
+
+	ns->stats.page_reads++;
+	ns->stats.time_ns += ns->timing.t_read_ns + nandsim_xfer_ns(ns, 1);
+
+	raw = nandsim_page(ns, block, 0, false);
+
+	return raw && raw[ns->cfg.page_size + NANDSIM_BBM_OFFSET] != 0xff;
+}
+
+static int nandsim_block_markbad(struct mtd_info *mtd, loff_t ofs)
+{
+	struct nandsim *ns = mtd_to_ns(mtd);
+	u32 block, page;
+	bool cut;
+	u8 *raw;
+
+	if (nandsim_locate(ns, ofs, &block, &page))
+		return -EINVAL;
+
+	if (!nandsim_power_op(ns, &cut) || cut)
+		return -EIO;
+
+	ns->stats.page_writes++;
+	ns->stats.time_ns += ns->timing.t_prog_ns;
+
+	raw = nandsim_page(ns, block, 0, true);
+	raw[ns->cfg.page_size + NANDSIM_BBM_OFFSET] = 0;
+
+	return 0;
+}
+
+struct nandsim *nandsim_create(const struct nandsim_config *cfg)
+{
+	struct nandsim *ns;
+	u32 i;
+
+	ns = calloc(1, sizeof(*ns));
+	if (!ns)
+		return NULL;
+
+	ns->cfg = *cfg;
+	ns->timing = nandsim_default_timing;
+	ns->rand_state = cfg->seed;
+	ns->n_blocks = cfg->size / cfg->block_size;
+	ns->pages_per_block = cfg->block_size / cfg->page_size;
+	ns->raw_page_size = cfg->page_size + cfg->oob_size;
+	ns->blocks = calloc(ns->n_blocks, sizeof(*ns->blocks));
+	if (!ns->blocks) {
+		free(ns);
+		return NULL;
+	}
+
+	ns->mtd.name = "nandsim";
+	ns->mtd.size = cfg->size;
+	ns->mtd.erasesize = cfg->block_size;
+	ns->mtd.erasesize_mask = cfg->block_size - 1;
+	ns->mtd.writesize = cfg->page_size;
+	ns->mtd.oobsize = cfg->oob_size;
+	ns->mtd.oobavail = cfg->oob_size - 2;
+	ns->mtd.ecc_strength = cfg->ecc_strength;
+	ns->mtd.bitflip_threshold = cfg->bitflip_threshold;
+	ns->mtd._read_oob = nandsim_read_oob;
+	ns->mtd._write_oob = nandsim_write_oob;
+	ns->mtd._erase = nandsim_erase;
+	ns->mtd._block_isbad = nandsim_block_isbad;
+	ns->mtd._block_markbad = nandsim_block_markbad;
+	ns->mtd.priv = ns;
+
+	/* factory bad blocks are never in block 0 */
+	for (i = 0; i < cfg->factory_bad; i++) {
+		u32 block = 1 + rand_r(&ns->rand_state) % (ns->n_blocks - 1);
+		u8 *raw = nandsim_page(ns, block, 0, true);
+
+		raw[cfg->page_size + NANDSIM_BBM_OFFSET] = 0;
+	}
+
+	return ns;
+}
+
+struct nandsim *nandsim_clone(const struct nandsim *src)
+{
+	size_t len = (size_t)src->pages_per_block * src->raw_page_size;
+	struct nandsim *ns;
+	u32 i;
+
+	ns = nandsim_create(&(struct nandsim_config) {
+		.size = src->cfg.size,
+		.block_size = src->cfg.block_size,
+		.page_size = src->cfg.page_size,
+		.oob_size = src->cfg.oob_size,
+		.ecc_strength = src->cfg.ecc_strength,
+		.bitflip_threshold = src->cfg.bitflip_threshold,
+	});
+	if (!ns)
+		return NULL;
+
+	ns->cfg = src->cfg;
+	ns->timing = src->timing;
+	ns->rand_state = src->rand_state;
+
+	for (i = 0; i < src->n_blocks; i++) {
+		if (!src->blocks[i])
+			continue;
+
+		ns->blocks[i] = malloc(len);
+		if (!ns->blocks[i])
+			abort();
+
+		memcpy(ns->blocks[i], src->blocks[i], len);
+	}
+
+	return ns;
+}
+
+void nandsim_destroy(struct nandsim *ns)
+{
+	u32 i;
+
+	for (i = 0; i < ns->n_blocks; i++)
+		free(ns->blocks[i]);
+
+	free(ns->blocks);
+	free(ns);
+}
+
+void nandsim_power_cut(struct nandsim *ns, u64 ops)
+{
+	ns->power_ops = 0;
+	ns->power_cut_at = ops;
+}
+
+void nandsim_power_on(struct nandsim *ns)
+{
+	ns->power_ops = 0;
+	ns->power_cut_at = 0;
+	ns->powered_off = false;
+}
+
+int nandsim_find_magic(struct nandsim *ns, u32 magic, int from, int dir)
+{
+	int block;
+
+	for (block = from; block >= 0 && block < ns->n_blocks; block += dir) {
+		u8 *raw = nandsim_page(ns, block, 0, false);
+
+		if (raw && !memcmp(raw, &magic, sizeof(magic)))
+			return block;
+	}
+
+	return -1;
+}
+
+void nandsim_corrupt_block(struct nandsim *ns, u32 block)
+{
+	u8 *raw = nandsim_page(ns, block, 0, true);
+
+	raw[0] ^= 0xff;
+	raw[ns->cfg.page_size / 2] ^= 0xff;
+}
+
+void nandsim_reset_stats(struct nandsim *ns)
+{
+	memset(&ns->stats, 0, sizeof(ns->stats));
+}
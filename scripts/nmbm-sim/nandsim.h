@@ -0,0 +1,92 @@
+/*
+ * Simulated NAND flash for host testing of the MediaTek BMT code
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __NANDSIM_H
+#define __NANDSIM_H
+
+#include <linux/mtd/mtd.h>
+
+struct nandsim_config {
+	u64 size;
+	u32 block_size;
+	u32 page_size;
+	u32 oob_size;
+	u32 ecc_strength;
+	u32 bitflip_threshold;
+
+	/* factory bad blocks, marked in OOB before the first attach */
+	u32 factory_bad;
+
+	/* per page read probability of correctable / uncorrectable errors */
+	double bitflip_rate;
+	double eccerr_rate;
+
+	/* per operation probability of a failing program / erase */
+	double prog_fail_rate;
+	double erase_fail_rate;
+
+	unsigned int seed;
+};
+
+struct nandsim_stats {
+	u64 page_reads;
+	u64 page_writes;
+	u64 block_erases;
+	u64 bitflips;
+	u64 eccerrs;
+	u64 prog_fails;
+	u64 erase_fails;
+
+	/* modelled flash busy time */
+	u64 time_ns;
+};
+
+struct nandsim_timing {
+	u32 t_read_ns;		/* array to cache */
+	u32 t_prog_ns;		/* cache to array */
+	u32 t_erase_ns;
+	u32 bus_mbps;		/* data transfer rate in MB/s */
+};
+
+struct nandsim {
+	struct mtd_info mtd;
+	struct nandsim_config cfg;
+	struct nandsim_timing timing;
+	struct nandsim_stats stats;
+
+	u32 n_blocks;
+	u32 pages_per_block;
+	u32 raw_page_size;
+	u8 **blocks;		/* NULL for erased blocks */
+
+	/* power cut: fail everything after this many program/erase ops */
+	u64 power_cut_at;
+	u64 power_ops;
+	bool powered_off;
+
+	unsigned int rand_state;
+};
+
+struct nandsim *nandsim_create(const struct nandsim_config *cfg);
+struct nandsim *nandsim_clone(const struct nandsim *src);
+void nandsim_destroy(struct nandsim *ns);
+
+/*
+ * Schedule a power cut after @ops further program or erase operations.
+ * The interrupted operation leaves partially programmed or erased data
+ * behind, all later operations fail until nandsim_power_on().
+ */
+void nandsim_power_cut(struct nandsim *ns, u64 ops);
+void nandsim_power_on(struct nandsim *ns);
+
+/* First block from @from in direction @dir whose data starts with @magic */
+int nandsim_find_magic(struct nandsim *ns, u32 magic, int from, int dir);
+void nandsim_corrupt_block(struct nandsim *ns, u32 block);
+
+void nandsim_reset_stats(struct nandsim *ns);
+
+#endif
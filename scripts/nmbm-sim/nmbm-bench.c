@@ -0,0 +1,496 @@
+/*
+ * Attach time, table rescue and write amplification of the NMBM code,
+ * measured on a simulated NAND
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Flash time is modelled from typical SLC NAND timings, so the numbers
+ * approximate what a device spends in nmbm_attach() at boot. Host CPU
+ * time is shown separately.
+ */
+
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/slab.h>
+
+#include "mtk_bmt.h"
+#include "nandsim.h"
+#include "sim.h"
+
+#define NMBM_MAGIC_INFO_TABLE	0x314d4d4e	/* NMM1 */
+
+#define PROP_U32(_name, _val) \
+	{ .name = _name, .value = &(const __be32) { cpu_to_be32(_val) }, .length = 4 }
+#define PROP_BOOL(_name) \
+	{ .name = _name, .value = "", .length = 0 }
+
+static const struct property nmbm_props[] = {
+	PROP_BOOL("mediatek,nmbm"),
+	PROP_BOOL("mediatek,bmt-force-create"),
+	PROP_U32("mediatek,bmt-max-ratio", 1),
+	PROP_U32("mediatek,bmt-max-reserved-blocks", 256),
+	{}
+};
+
+static const struct property nmbm_write_back_props[] = {
+	PROP_BOOL("mediatek,nmbm"),
+	PROP_BOOL("mediatek,bmt-force-create"),
+	PROP_BOOL("mediatek,bmt-write-back"),
+	PROP_U32("mediatek,bmt-max-ratio", 1),
+	PROP_U32("mediatek,bmt-max-reserved-blocks", 256),
+	{}
+};
+
+/* enough spare blocks for a grown bad block on every boot */
+static const struct property nmbm_aged_props[] = {
+	PROP_BOOL("mediatek,nmbm"),
+	PROP_BOOL("mediatek,bmt-force-create"),
+	PROP_U32("mediatek,bmt-max-ratio", 5),
+	PROP_U32("mediatek,bmt-max-reserved-blocks", 256),
+	{}
+};
+
+static struct device_node nmbm_node = {
+	.properties = nmbm_props,
+};
+
+struct bench_result {
+	u64 flash_ns;
+	u64 cpu_ns;
+	u64 reads;
+	u64 writes;
+	u64 erases;
+	int ret;
+};
+
+static struct {
+	int remaps;
+	int power_cuts;
+	int boots;
+	u32 factory_bad;
+	u32 op_blocks;
+	double bitflip_rate;
+	double eccerr_rate;
+	unsigned int seed;
+} opts = {
+	.remaps = 8,
+	.factory_bad = 4,
+	.op_blocks = 1,
+	.seed = 1,
+};
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_attach(struct nandsim *ns, struct bench_result *res)
+{
+	u64 start;
+
+	nandsim_reset_stats(ns);
+	ns->mtd.size = ns->cfg.size;
+	ns->mtd.of_node = &nmbm_node;
+
+	start = now_ns();
+	res->ret = mtk_bmt_attach(&ns->mtd);
+	res->cpu_ns = now_ns() - start;
+	res->flash_ns = ns->stats.time_ns;
+	res->reads = ns->stats.page_reads;
+	res->writes = ns->stats.page_writes;
+	res->erases = ns->stats.block_erases;
+
+	return res->ret;
+}
+
+/* Print NMBM state through the "debug" file, shown with -v */
+static void bench_debug(u64 val)
+{
+	const struct sim_debugfs_file *f = sim_debugfs_lookup("debug");
+
+	if (f)
+		f->fops->set(f->data, val);
+}
+
+static void bench_detach(struct nandsim *ns)
+{
+	void *ni = bmtd.ni;
+
+	mtk_bmt_detach(&ns->mtd);
+	kfree(ni);
+}
+
+static void fill_block(u8 *buf, u32 len, u32 lb, u32 gen)
+{
+	u32 i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (lb * 31 + gen * 7 + i) ^ (i >> 8);
+}
+
+/* Erase and write @n blocks with one MTD operation each */
+static int write_blocks(struct nandsim *ns, u32 lb, u32 n, u32 gen, u8 *buf)
+{
+	struct mtd_info *mtd = &ns->mtd;
+	struct mtd_oob_ops ops = {
+		.mode = MTD_OPS_PLACE_OOB,
+		.datbuf = buf,
+		.len = n * mtd->erasesize,
+	};
+	struct erase_info ei = {
+		.addr = (u64)lb * mtd->erasesize,
+		.len = n * mtd->erasesize,
+	};
+	u32 i;
+	int ret;
+
+	ret = mtd->_erase(mtd, &ei);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < n; i++)
+		fill_block(buf + i * mtd->erasesize, mtd->erasesize, lb + i, gen);
+
+	return mtd->_write_oob(mtd, ei.addr, &ops);
+}
+
+static int verify_block(struct nandsim *ns, u32 lb, u32 gen, u8 *buf,
+			u8 *ref)
+{
+	struct mtd_info *mtd = &ns->mtd;
+	struct mtd_oob_ops ops = {
+		.mode = MTD_OPS_PLACE_OOB,
+		.datbuf = buf,
+		.len = mtd->erasesize,
+	};
+	int ret;
+
+	/*
+	 * mtk_bmt_read() keeps reporting an ECC error after it remapped the
+	 * block and read it again, so judge by the data only.
+	 */
+	ret = mtd->_read_oob(mtd, (u64)lb * mtd->erasesize, &ops);
+	if (ret < 0 && !mtd_is_eccerr(ret))
+		return ret;
+
+	fill_block(ref, mtd->erasesize, lb, gen);
+
+	return memcmp(buf, ref, mtd->erasesize) ? -EILSEQ : 0;
+}
+
+static void print_result(const char *name, const struct bench_result *res)
+{
+	printf("  %-10s %9.2f ms flash %8.2f ms cpu %7llu reads %6llu writes %5llu erases%s\n",
+	       name, res->flash_ns / 1e6, res->cpu_ns / 1e6, res->reads,
+	       res->writes, res->erases, res->ret ? "  FAILED" : "");
+}
+
+/*
+ * Write @count blocks with program failures injected, so that about
+ * opts.remaps blocks go bad and get remapped on the way.
+ */
+static int bench_write(struct nandsim *ns, u32 first, u32 count, u32 gen,
+		       int remaps, u8 *buf)
+{
+	u32 pages = count * ns->pages_per_block;
+	u32 lb;
+	int ret;
+
+	ns->cfg.prog_fail_rate = remaps ? (double)remaps / pages : 0;
+
+	for (lb = first; lb < first + count; lb += opts.op_blocks) {
+		ret = write_blocks(ns, lb,
+				   min_t(u32, opts.op_blocks, first + count - lb),
+				   gen, buf);
+		if (ret)
+			break;
+	}
+
+	ns->cfg.prog_fail_rate = 0;
+
+	return ret;
+}
+
+static int bench_power_cut(struct nandsim *base, u32 count, u8 *buf, u8 *ref,
+			   u64 max_ops, u64 cut)
+{
+	struct bench_result res;
+	struct nandsim *ns;
+	u32 lb;
+	int ret;
+
+	ns = nandsim_clone(base);
+	if (!ns)
+		return -ENOMEM;
+
+	/* storm of remaps on the second half, cut power somewhere inside */
+	ret = bench_attach(ns, &res);
+	if (!ret) {
+		nandsim_power_cut(ns, cut);
+		bench_write(ns, count, count, 1, opts.remaps, buf);
+		bench_detach(ns);
+	}
+
+	nandsim_power_on(ns);
+
+	ret = bench_attach(ns, &res);
+	if (ret) {
+		fprintf(stderr, "power cut after %llu/%llu ops: attach failed (%d)\n",
+			cut, max_ops, ret);
+		goto out;
+	}
+
+	/* the first half was written before and must have survived */
+	for (lb = 0; lb < count; lb++) {
+		ret = verify_block(ns, lb, 0, buf, ref);
+		if (ret) {
+			fprintf(stderr, "power cut after %llu/%llu ops: block %u lost (%d)\n",
+				cut, max_ops, lb, ret);
+			break;
+		}
+	}
+
+	bench_detach(ns);
+
+out:
+	nandsim_destroy(ns);
+	return ret;
+}
+
+static int bench_size(u32 size_mb)
+{
+	struct nandsim_config cfg = {
+		.size = (u64)size_mb << 20,
+		.block_size = 128 << 10,
+		.page_size = 2048,
+		.oob_size = 64,
+		.ecc_strength = 4,
+		.bitflip_threshold = 3,
+		.factory_bad = opts.factory_bad * size_mb / 128,
+		.bitflip_rate = opts.bitflip_rate,
+		.eccerr_rate = opts.eccerr_rate,
+		.seed = opts.seed,
+	};
+	struct bench_result create, attach, rescue, res;
+	u64 logical, physical, max_ops;
+	struct nandsim *ns, *rescue_ns, *aged_ns;
+	u32 count, lb;
+	int table, i, failed = 0;
+	u8 *buf, *ref;
+
+	ns = nandsim_create(&cfg);
+	buf = malloc(opts.op_blocks * cfg.block_size);
+	ref = malloc(cfg.block_size);
+	if (!ns || !buf || !ref)
+		return -ENOMEM;
+
+	printf("%u MiB, %u blocks, %u factory bad\n", size_mb, ns->n_blocks,
+	       cfg.factory_bad);
+
+	/* first boot creates signature and tables */
+	bench_attach(ns, &create);
+	print_result("create", &create);
+	if (create.ret)
+		return create.ret;
+	bench_detach(ns);
+
+	/* regular boot */
+	bench_attach(ns, &attach);
+	print_result("attach", &attach);
+	if (attach.ret)
+		return attach.ret;
+	bench_debug(1);
+
+	/* write amplification of remapping grown bad blocks */
+	count = min_t(u32, 64, ns->n_blocks / 16);
+	bench_write(ns, 0, count, 0, 0, buf);
+
+	nandsim_reset_stats(ns);
+	if (bench_write(ns, count, count, 1, opts.remaps, buf)) {
+		printf("  write failed\n");
+		failed++;
+	}
+
+	logical = (u64)count * ns->pages_per_block;
+	physical = ns->stats.page_writes;
+	max_ops = ns->stats.page_writes + ns->stats.block_erases;
+	printf("  remap      %5llu prog fails, %llu page writes for %llu pages: WA %.2f\n",
+	       ns->stats.prog_fails, physical, logical,
+	       (double)physical / logical);
+	bench_debug(2);
+
+	for (lb = 0; lb < 2 * count; lb++) {
+		if (verify_block(ns, lb, lb >= count, buf, ref)) {
+			printf("  block %u corrupted after remap\n", lb);
+			failed++;
+			break;
+		}
+	}
+
+	bench_detach(ns);
+
+	/* boot with a damaged main info table */
+	rescue_ns = nandsim_clone(ns);
+	table = nandsim_find_magic(rescue_ns, NMBM_MAGIC_INFO_TABLE, 0, 1);
+	if (table >= 0)
+		nandsim_corrupt_block(rescue_ns, table);
+
+	bench_attach(rescue_ns, &rescue);
+	print_result("rescue", &rescue);
+	if (rescue.ret)
+		failed++;
+	else
+		bench_detach(rescue_ns);
+
+	/* reboot after the rescue */
+	if (!bench_attach(rescue_ns, &res)) {
+		print_result("reattach", &res);
+		bench_detach(rescue_ns);
+	}
+	nandsim_destroy(rescue_ns);
+
+	/*
+	 * Boots with a grown bad block most of the time, enough to fill the
+	 * hint log a few times, then a boot without and the measured one
+	 */
+	if (opts.boots) {
+		const struct property *props = nmbm_node.properties;
+
+		nmbm_node.properties = nmbm_aged_props;
+		aged_ns = nandsim_create(&cfg);
+
+		for (i = 0; i <= opts.boots + 1; i++) {
+			if (bench_attach(aged_ns, &res))
+				break;
+			if (i == opts.boots + 1)
+				break;
+			if (i < opts.boots)
+				bench_write(aged_ns, i % count, 1, 2, 1, buf);
+			bench_detach(aged_ns);
+		}
+
+		if (res.ret) {
+			printf("  attach after %d boots failed\n", i);
+			failed++;
+		} else {
+			print_result("aged", &res);
+			bench_debug(1);
+			bench_detach(aged_ns);
+		}
+		nandsim_destroy(aged_ns);
+		nmbm_node.properties = props;
+	}
+
+	/* power cuts at random points of a remap storm */
+	if (opts.power_cuts) {
+		struct nandsim *base = ns;
+		int lost = 0;
+
+		/* start over from the state before the storm */
+		ns = nandsim_create(&cfg);
+		bench_attach(ns, &res);
+		bench_detach(ns);
+		bench_attach(ns, &res);
+		bench_write(ns, 0, count, 0, 0, buf);
+		bench_detach(ns);
+		nandsim_destroy(base);
+
+		for (i = 0; i < opts.power_cuts; i++) {
+			u64 cut = 1 + rand_r(&opts.seed) % max_ops;
+
+			if (bench_power_cut(ns, count, buf, ref, max_ops, cut))
+				lost++;
+		}
+
+		printf("  power cut  %d/%d recovered\n", opts.power_cuts - lost,
+		       opts.power_cuts);
+		failed += lost;
+	}
+
+	nandsim_destroy(ns);
+	free(buf);
+	free(ref);
+
+	return failed ? -EIO : 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -s <MiB,...>  flash sizes (default 128,256,512,1024)\n"
+		"  -r <n>        grown bad blocks during the write test (default %d)\n"
+		"  -p <n>        power cut trials per size (default 0)\n"
+		"  -a <n>        boots with table updates before an aged attach (default 0)\n"
+		"  -b <n>        factory bad blocks per 128 MiB (default %u)\n"
+		"  -m <n>        blocks per erase/write operation (default 1)\n"
+		"  -w            defer table updates to the end of each operation\n"
+		"  -f <rate>     correctable bitflips per page read\n"
+		"  -e <rate>     uncorrectable ECC errors per page read\n"
+		"  -S <seed>     random seed\n"
+		"  -v            print kernel log messages\n",
+		prog, opts.remaps, opts.factory_bad);
+}
+
+int main(int argc, char **argv)
+{
+	char *sizes = "128,256,512,1024";
+	char *size, *saveptr;
+	int ch, ret = 0;
+
+	while ((ch = getopt(argc, argv, "s:r:p:a:b:m:wf:e:S:v")) != -1) {
+		switch (ch) {
+		case 's':
+			sizes = optarg;
+			break;
+		case 'r':
+			opts.remaps = atoi(optarg);
+			break;
+		case 'p':
+			opts.power_cuts = atoi(optarg);
+			break;
+		case 'a':
+			opts.boots = atoi(optarg);
+			break;
+		case 'b':
+			opts.factory_bad = atoi(optarg);
+			break;
+		case 'm':
+			opts.op_blocks = atoi(optarg) ? : 1;
+			break;
+		case 'w':
+			nmbm_node.properties = nmbm_write_back_props;
+			break;
+		case 'f':
+			opts.bitflip_rate = atof(optarg);
+			break;
+		case 'e':
+			opts.eccerr_rate = atof(optarg);
+			break;
+		case 'S':
+			opts.seed = atoi(optarg);
+			break;
+		case 'v':
+			sim_log_level = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	for (size = strtok_r(sizes, ",", &saveptr); size;
+	     size = strtok_r(NULL, ",", &saveptr)) {
+		if (bench_size(atoi(size)))
+			ret = 1;
+	}
+
+	return ret;
+}
@@ -0,0 +1,27 @@
+/*
+ * Host build of the MediaTek BMT code
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __NMBM_SIM_H
+#define __NMBM_SIM_H
+
+#include <linux/debugfs.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/mtk_bmt.h>
+
+#define SIM_DEBUGFS_MAX		16
+
+struct sim_debugfs_file {
+	const char *name;
+	void *data;
+	const struct file_operations *fops;
+};
+
+extern int sim_log_level;
+
+const struct sim_debugfs_file *sim_debugfs_lookup(const char *name);
+
+#endif
@@ -97,31 +97,11 @@ sub gen_kconfig_overrides() {
 	}
 }
 
-my %dep_check;
-sub __find_package_dep($$) {
-	my $pkg = shift;
-	my $name = shift;
-	my $deps = $pkg->{depends};
-
-	return 0 unless defined $deps;
-	foreach my $vpkg (@{$deps}) {
-		foreach my $dep (@{$vpackage{$vpkg}}) {
-			next if $dep_check{$dep->{name}};
-			$dep_check{$dep->{name}} = 1;
-			return 1 if $dep->{name} eq $name;
-			return 1 if (__find_package_dep($dep, $name) == 1);
-		}
-	}
-	return 0;
-}
-
-# wrapper to avoid infinite recursion
 sub find_package_dep($$) {
 	my $pkg = shift;
 	my $name = shift;
 
-	%dep_check = ();
-	return __find_package_dep($pkg, $name);
+	return $pkgdeps{$pkg->{name}}{$name} ? 1 : 0;
 }
 
 sub package_depends($$) {
@@ -0,0 +1,139 @@
+#!/usr/bin/env perl
+#
+# List the ELF files below the given paths for rstrip.sh.
+#
+# Files are identified from their ELF header, so no process is started per
+# file. For every executable, shared object and relocatable file, the path,
+# the type, the permissions and the RUNPATH or RPATH are printed, each field
+# terminated by a NUL byte.
+#
+# This is free software, licensed under the GNU General Public License v2.
+# See /LICENSE for more information.
+#
+
+use strict;
+use warnings;
+use File::Find;
+
+my %types = (
+	1 => 'relocatable',
+	2 => 'executable',
+	3 => 'shared object',
+);
+
+use constant {
+	PT_LOAD => 1,
+	PT_DYNAMIC => 2,
+	DT_NULL => 0,
+	DT_STRTAB => 5,
+	DT_RPATH => 15,
+	DT_RUNPATH => 29,
+	DT_FLAGS_1 => 0x6ffffffb,
+	DF_1_PIE => 0x08000000,
+};
+
+sub read_at($$$) {
+	my ($fh, $offset, $len) = @_;
+	my $buf = '';
+
+	seek($fh, $offset, 0) or return '';
+	read($fh, $buf, $len);
+	return $buf;
+}
+
+# Return the RUNPATH, or the RPATH if there is none, like patchelf does, and
+# the DT_FLAGS_1 value
+sub elf_dynamic($$$$$$) {
+	my ($fh, $is64, $e, $phoff, $phentsize, $phnum) = @_;
+	my (@load, $dyn_off, $dyn_size);
+
+	my $phdrs = read_at($fh, $phoff, $phentsize * $phnum);
+	return ('', 0) unless length($phdrs) == $phentsize * $phnum;
+
+	for my $i (0 .. $phnum - 1) {
+		my $ph = substr($phdrs, $i * $phentsize, $phentsize);
+		my ($type, $offset, $vaddr, $filesz);
+
+		if ($is64) {
+			($type, $offset, $vaddr, $filesz) = unpack("L$e x4 Q$e Q$e x8 Q$e", $ph);
+		} else {
+			($type, $offset, $vaddr, $filesz) = unpack("L$e L$e L$e x4 L$e", $ph);
+		}
+
+		if ($type == PT_LOAD) {
+			push @load, [ $vaddr, $offset, $filesz ];
+		} elsif ($type == PT_DYNAMIC) {
+			($dyn_off, $dyn_size) = ($offset, $filesz);
+		}
+	}
+	return ('', 0) unless defined $dyn_off;
+
+	my $dyn = read_at($fh, $dyn_off, $dyn_size);
+	my $entsize = $is64 ? 16 : 8;
+	my ($strtab, $rpath, $runpath, $flags_1) = (undef, undef, undef, 0);
+
+	for (my $pos = 0; $pos + $entsize <= length($dyn); $pos += $entsize) {
+		my ($tag, $val) = unpack($is64 ? "q$e Q$e" : "l$e L$e", substr($dyn, $pos, $entsize));
+
+		last if $tag == DT_NULL;
+		$strtab = $val if $tag == DT_STRTAB;
+		$rpath = $val if $tag == DT_RPATH;
+		$runpath = $val if $tag == DT_RUNPATH;
+		$flags_1 = $val if $tag == DT_FLAGS_1;
+	}
+	$rpath = $runpath if defined $runpath;
+	return ('', $flags_1) unless defined $strtab && defined $rpath;
+
+	# DT_STRTAB is an address, find the segment it was loaded from
+	for my $seg (@load) {
+		my ($vaddr, $offset, $filesz) = @$seg;
+		next unless $strtab >= $vaddr && $strtab < $vaddr + $filesz;
+
+		my $str = read_at($fh, $offset + $strtab - $vaddr + $rpath, 4096);
+		$str =~ s/\0.*//s;
+		return ($str, $flags_1);
+	}
+
+	return ('', $flags_1);
+}
+
+sub scan_file($) {
+	my $file = shift;
+	my ($fh, $ehdr);
+
+	my @st = lstat($file) or return;
+	return unless -f _;
+
+	open($fh, '<:raw', $file) or return;
+	return unless (read($fh, $ehdr, 64) // 0) >= 52;
+	return unless substr($ehdr, 0, 4) eq "\x7fELF";
+
+	my ($class, $data) = unpack('x4 C C', $ehdr);
+	return unless ($class == 1 || $class == 2) && ($data == 1 || $data == 2);
+
+	my $is64 = $class == 2;
+	my $e = $data == 1 ? '<' : '>';
+	my $type = $types{unpack("x16 S$e", $ehdr)} or return;
+	my ($rpath, $flags_1) = ('', 0);
+
+	if ($type ne 'relocatable') {
+		return if $is64 && length($ehdr) < 64;
+
+		my ($phoff, $phentsize, $phnum) = $is64 ?
+			unpack("x32 Q$e x14 S$e S$e", $ehdr) :
+			unpack("x28 L$e x10 S$e S$e", $ehdr);
+
+		($rpath, $flags_1) = elf_dynamic($fh, $is64, $e, $phoff, $phentsize, $phnum)
+			if $phnum && $phentsize >= ($is64 ? 56 : 32);
+
+		# Report position independent executables like file(1) does
+		$type = 'executable' if $flags_1 & DF_1_PIE;
+	}
+	close($fh);
+
+	printf "%s\0%s\0%o\0%s\0", $file, $type, $st[2] & 07777, $rpath;
+}
+
+@ARGV or die "Usage: $0 <path>...\n";
+
+find({ wanted => sub { scan_file($File::Find::name) }, no_chdir => 1 }, @ARGV);
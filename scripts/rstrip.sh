@@ -1,10 +1,23 @@
 #!/usr/bin/env bash
-# 
+#
 # Copyright (C) 2006 OpenWrt.org
 #
 # This is free software, licensed under the GNU General Public License v2.
 # See /LICENSE for more information.
 #
+# ELF files are found from their headers by rstrip-scan.pl and stripped by a
+# pool of workers. Stripped files can be kept in a cache, keyed by the hash
+# of the unstripped file and of the strip configuration, so unchanged files
+# are copied instead of being stripped again.
+#
+# Environment:
+#   STRIP         strip command for executables and shared objects
+#   STRIP_KMOD    strip command for kernel modules
+#   PATCHELF      patchelf command, used with TOPDIR to drop build RPATHs
+#   MKHASH        mkhash command, needed for the cache
+#   RSTRIP_CACHE  directory to keep stripped files in, if set
+#   RSTRIP_JOBS   number of workers
+#
 SELF=${0##*/}
 
 [ -z "$STRIP" ] && {
@@ -20,31 +33,81 @@ TARGETS=$*
   exit 1
 }
 
-find $TARGETS -type f -a -exec file {} \; | \
-  sed -n -e 's/^\(.*\):.*ELF.*\(executable\|relocatable\|shared object\).*,.*/\1:\2/p' | \
-(
-  IFS=":"
-  while read F S; do
-    echo "$SELF: $F: $S"
-	[ "${S}" = "relocatable" ] && {
-		[ "${F##*.}" == "o" ] && continue
+jobs="${RSTRIP_JOBS:-$(nproc 2>/dev/null || echo 1)}"
+
+# Strip one file, or copy it from the cache if the hash is known there
+strip_file() {
+	local F="$1" S="$2" b="$3" old_rpath="$4" hash="$5" new_rpath="" path ret IFS=":"
+
+	echo "$SELF: $F: $S"
+	[ "$S" = "relocatable" ] && [ "${F##*.}" == "o" ] && return
+
+	if [ "$S" != "relocatable" ] && [ -n "$PATCHELF" ] && [ -n "$TOPDIR" ]; then
+		for path in $old_rpath; do
+			case "$path" in
+				/lib/[^/]*|/usr/lib/[^/]*|\$ORIGIN/*|\$ORIGIN) new_rpath="${new_rpath:+$new_rpath:}$path" ;;
+				*) echo "$SELF: $F: removing rpath $path" ;;
+			esac
+		done
+	else
+		new_rpath="$old_rpath"
+	fi
+
+	if [ -n "$hash" ] && cp -f "$cache/$hash" "$F" 2>/dev/null; then
+		# Writing the file drops setuid and setgid bits
+		[ ${#b} -le 3 ] || chmod $b "$F"
+		return
+	fi
+
+	if [ "$S" = "relocatable" ]; then
 		eval "$STRIP_KMOD $F"
-	} || {
-		b=$(stat -c '%a' $F)
-		[ -z "$PATCHELF" ] || [ -z "$TOPDIR" ] || {
-			old_rpath="$($PATCHELF --print-rpath $F)"; new_rpath=""
-			for path in $old_rpath; do
-				case "$path" in
-					/lib/[^/]*|/usr/lib/[^/]*|\$ORIGIN/*|\$ORIGIN) new_rpath="${new_rpath:+$new_rpath:}$path" ;;
-					*) echo "$SELF: $F: removing rpath $path" ;;
-				esac
-			done
-			[ "$new_rpath" = "$old_rpath" ] || $PATCHELF --set-rpath "$new_rpath" $F
-		}
+		ret=$?
+	else
+		[ "$new_rpath" = "$old_rpath" ] || \
+			$PATCHELF --set-rpath "$new_rpath" "$F" || hash=
 		eval "$STRIP $F"
-		a=$(stat -c '%a' $F)
-		[ "$a" = "$b" ] || chmod $b $F
-	}
-  done
-  true
-)
+		ret=$?
+		[ "$(stat -c '%a' "$F")" = "$b" ] || chmod $b "$F"
+	fi
+
+	[ -n "$hash" ] && [ $ret -eq 0 ] || return
+	cp "$F" "$cache/.new.$$" && mv "$cache/.new.$$" "$cache/$hash"
+}
+
+# Strip a batch of files, given as path, type, mode and rpath each
+strip_files() {
+	local args=("$@") files=() hashes=() i
+
+	if [ -n "$cache" ]; then
+		for ((i = 0; i < ${#args[@]}; i += 4)); do
+			files+=("${args[$i]}")
+		done
+		mapfile -t hashes < <($MKHASH sha256 "${files[@]}" 2>/dev/null)
+		[ ${#hashes[@]} -eq ${#files[@]} ] || hashes=()
+	fi
+
+	for ((i = 0; i + 3 < ${#args[@]}; i += 4)); do
+		strip_file "${args[@]:$i:4}" "${hashes[$((i / 4))]}"
+	done
+}
+export -f strip_file strip_files
+export SELF cache=
+
+if [ -n "$RSTRIP_CACHE" ] && [ -n "$MKHASH" ]; then
+	# Anything that changes the output of a strip is part of the key
+	tools=()
+	for tool in "${STRIP%% *}" "$STRIP_KMOD" "${CROSS}objcopy" "${CROSS}nm" "$PATCHELF"; do
+		tool="$(type -P "$tool")" && tools+=("$tool")
+	done
+	key="$(
+		echo "$STRIP|$STRIP_KMOD|$PATCHELF|$TOPDIR|$CROSS|$NM|$KEEP_BUILD_ID|$NO_RENAME|$KEEP_SYMBOLS"
+		[ ${#tools[@]} -eq 0 ] || stat -L -c '%n %s %Y' "${tools[@]}"
+	)"
+	key="$(echo "$key" | $MKHASH sha256)" && \
+		cache="$RSTRIP_CACHE/$key" && \
+		mkdir -p "$cache" || cache=
+fi
+
+"${0%/*}/rstrip-scan.pl" "$@" | \
+	xargs -0 -r -n 64 -P "$jobs" bash -c 'strip_files "$@"' strip_files
+true
@@ -0,0 +1,181 @@
+#!/usr/bin/env bash
+#
+# Dump the metadata of one package or target Makefile for include/scan.mk,
+# reusing earlier output from a content addressed cache.
+#
+# The cache key covers the content of every makefile read while the
+# Makefile was dumped the last time, including the Makefile itself and the
+# ones read by sub-makes, so a change to any .mk file only invalidates the
+# Makefiles that include it. The extra deps are expanded globs from
+# include/scan.mk; their current list is part of the key, so an added
+# image/*.mk or subtarget also invalidates the entry.
+#
+# Every entry records its key in keys/, --prune drops the entries of the
+# Makefiles that are not part of the scan of <scan dir> any more and the
+# output that no recorded key points to.
+#
+# Usage: scan-dump.sh <dir> <feed> <log> [<extra dep>...]
+#        scan-dump.sh --prune <scan dir> < <file list>
+#
+# Environment:
+#   SCAN_MAKE       make command used for the dump
+#   SCAN_MAKEOPTS   extra make arguments
+#   SCAN_CACHE_DIR  cache directory, caching is disabled if empty
+#   SCAN_TIMING     file to append "<ms> <hit|miss> <dir>" to
+#
+export LANG=C
+export LC_ALL=C
+set -o pipefail
+
+cd "$TOPDIR" || exit 1
+
+# Name of the cache entry of one Makefile
+entry_name() {
+	local opts="${SCAN_MAKEOPTS//[^A-Za-z0-9_=.-]/_}"
+
+	echo "${1//\//_}${2:+@$2}${opts:+@$opts}"
+}
+
+# Keep the entries of the Makefiles in the file list, relative to the scan
+# dir as in include/scan.mk, and the output their keys point to
+prune() {
+	local -A live used
+	local d f feed prefix="${1//\//_}_"
+
+	while read -r d; do
+		feed=
+		case "$d" in
+			feeds/*) feed="${d#feeds/}"; feed="${feed%%/*}" ;;
+		esac
+		live["$(entry_name "$1/$d" "$feed")"]=1
+	done
+
+	for f in "$SCAN_CACHE_DIR/deps/$prefix"*; do
+		[ -e "$f" ] || continue
+		f="${f##*/}"
+		[ -n "${live[$f]}" ] || rm -f "$SCAN_CACHE_DIR/deps/$f" "$SCAN_CACHE_DIR/keys/$f"
+	done
+
+	# Keys of other scans share the output directory
+	for f in "$SCAN_CACHE_DIR/keys/"*; do
+		[ -s "$f" ] && used["$(< "$f")"]=1
+	done
+
+	for f in "$SCAN_CACHE_DIR/info/"*; do
+		[ -e "$f" ] || continue
+		[ -n "${used[${f##*/}]}" ] || rm -f "$f"
+	done
+}
+
+if [ "$1" = --prune ]; then
+	[ -n "$2" ] && [ -n "$SCAN_CACHE_DIR" ] || exit 0
+	prune "$2"
+	exit 0
+fi
+
+DIR="$1"
+FEED="$2"
+LOG="$3"
+shift 3
+
+[ -n "$DIR" ] && [ -n "$LOG" ] || {
+	echo "Usage: $0 <dir> <feed> <log> [<extra dep>...]" >&2
+	echo "       $0 --prune <scan dir> < <file list>" >&2
+	exit 1
+}
+
+now_ms() {
+	if [ -n "$EPOCHREALTIME" ]; then
+		printf -v "$1" '%s' "${EPOCHREALTIME/[.,]/}"
+		printf -v "$1" '%s' "$(( ${!1} / 1000 ))"
+	else
+		printf -v "$1" '%s' "$(( $(date +%s) * 1000 ))"
+	fi
+}
+
+hash_deps() {
+	$MKHASH -n -f "$1" sha256 2>/dev/null
+}
+
+# Paths relative to TOPDIR to share the cache between trees, in the order
+# they were read. Files in TMP_DIR are generated by the dump, the kernel
+# configs they are merged from are recorded by include/target.mk instead.
+dep_list() {
+	local -A seen
+	local f
+
+	for f in "$@"; do
+		[ "${f#$TMP_DIR/}" = "$f" ] || continue
+		f="${f#$TOPDIR/}"
+		[ "$f" = include/scan-deps.mk ] || [ -n "${seen[$f]}" ] || {
+			seen[$f]=1
+			echo "$f"
+		}
+	done
+}
+
+dump() {
+	$SCAN_MAKE --no-print-dir -r DUMP=1 FEED="$FEED" -C "$DIR" \
+		-f Makefile -f "$TOPDIR/include/scan-deps.mk" \
+		SCAN_DEPS_FILE="$1" $SCAN_MAKEOPTS
+}
+
+finish() {
+	local end
+
+	if [ -n "$SCAN_TIMING" ]; then
+		now_ms end
+		echo "$((end - start)) $1 $DIR" >> "$SCAN_TIMING"
+	fi
+	exit "$2"
+}
+
+now_ms start
+
+if [ -n "$SCAN_CACHE_DIR" ]; then
+	# Makefiles read on the last miss, the Makefile itself is one of them
+	name="$(entry_name "$DIR" "$FEED")"
+	deps="$SCAN_CACHE_DIR/deps/$name"
+	key="$SCAN_CACHE_DIR/keys/$name"
+
+	if [ -s "$deps" ]; then
+		read -r -d '' -a files < "$deps"
+		if hash="$(dep_list "${files[@]}" "$@" | hash_deps - | $MKHASH sha256)" &&
+		   cat "$SCAN_CACHE_DIR/info/$hash" 2>/dev/null; then
+			[ -s "$key" ] && [ "$(< "$key")" = "$hash" ] || echo "$hash" > "$key"
+			finish hit 0
+		fi
+	fi
+
+	[ -d "$SCAN_CACHE_DIR/info" ] && [ -d "$SCAN_CACHE_DIR/deps" ] &&
+	[ -d "$SCAN_CACHE_DIR/keys" ] || \
+		mkdir -p "$SCAN_CACHE_DIR/info" "$SCAN_CACHE_DIR/deps" "$SCAN_CACHE_DIR/keys"
+
+	# Same file system as the cache, to publish entries with a rename
+	tmp="$SCAN_CACHE_DIR/.tmp.$$"
+else
+	tmp="$TMP_DIR/.scan-dump.$$"
+fi
+trap 'rm -f "$tmp" "$tmp.deps"' EXIT
+
+dump "$tmp.deps" > "$tmp" 2>/dev/null || {
+	mkdir -p "${LOG%/*}"
+	dump "$tmp.deps" > "$LOG" 2>&1
+	finish miss 1
+}
+
+cat "$tmp"
+
+[ -n "$SCAN_CACHE_DIR" ] && [ -s "$tmp.deps" ] || finish miss 0
+
+# One line per make run, the target dumps run several
+read -r -d '' -a files < "$tmp.deps"
+dep_list "${files[@]}" "$@" > "$tmp.deps"
+
+hash="$(hash_deps "$tmp.deps" | $MKHASH sha256)" || finish miss 0
+
+mv "$tmp" "$SCAN_CACHE_DIR/info/$hash"
+mv "$tmp.deps" "$deps"
+echo "$hash" > "$key"
+
+finish miss 0
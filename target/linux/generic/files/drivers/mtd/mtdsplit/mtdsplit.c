@@ -12,10 +12,18 @@
 
 #define pr_fmt(fmt)	"mtdsplit: " fmt
 
+#include <linux/debugfs.h>
 #include <linux/export.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/magic.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/partitions.h>
 #include <linux/byteorder/generic.h>
@@ -24,21 +32,211 @@
 
 #define UBI_EC_MAGIC			0x55424923	/* UBI# */
 
+/*
+ * All split parsers probe the same partition one after another, mostly
+ * reading small headers near its start and scanning erase block boundaries
+ * for rootfs magic. The probe cache keeps a read-ahead window per master
+ * device to serve these reads from a single larger flash read, and remembers
+ * the magic found at each erase block. Caches are dropped once no parser has
+ * used them for a while, when the device or a partition goes away, and at
+ * the start of every split, as the flash may have been written since.
+ */
+#define MTDSPLIT_PROBE_WINDOW		SZ_64K
+#define MTDSPLIT_PROBE_IDLE		(5 * HZ)
+
+enum {
+	PROBE_MAGIC_UNKNOWN,
+	PROBE_MAGIC_NONE,
+	PROBE_MAGIC_FOUND,	/* + enum mtdsplit_part_type */
+};
+
+struct mtdsplit_probe {
+	struct list_head list;
+	struct mtd_info *master;
+
+	/* read-ahead window, in master offsets */
+	u8 *buf;
+	loff_t buf_ofs;
+	size_t buf_len;
+
+	/* magic per master erase block */
+	u8 *magic;
+	u32 n_blocks;
+};
+
+struct mtdsplit_stats {
+	struct list_head list;
+	const char *parser;
+	u64 reads;
+	u64 bytes;
+	u64 hits;
+	u64 magic_hits;
+	u64 time_ns;
+};
+
+static DEFINE_MUTEX(probe_lock);
+static LIST_HEAD(probe_list);
+static LIST_HEAD(stats_list);
+
+static void mtdsplit_probe_free(struct mtdsplit_probe *p)
+{
+	list_del(&p->list);
+	kvfree(p->magic);
+	kfree(p->buf);
+	kfree(p);
+}
+
+static void mtdsplit_probe_gc(struct work_struct *work)
+{
+	struct mtdsplit_probe *p, *tmp;
+
+	mutex_lock(&probe_lock);
+	list_for_each_entry_safe(p, tmp, &probe_list, list)
+		mtdsplit_probe_free(p);
+	mutex_unlock(&probe_lock);
+}
+
+static DECLARE_DELAYED_WORK(probe_gc_work, mtdsplit_probe_gc);
+
+static struct mtdsplit_probe *mtdsplit_probe_get(struct mtd_info *mtd)
+{
+	struct mtd_info *master = mtd_get_master(mtd);
+	struct mtdsplit_probe *p;
+
+	mod_delayed_work(system_wq, &probe_gc_work, MTDSPLIT_PROBE_IDLE);
+
+	list_for_each_entry(p, &probe_list, list)
+		if (p->master == master)
+			return p;
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return NULL;
+
+	p->master = master;
+	p->n_blocks = mtd_div_by_eb(master->size, master);
+	p->magic = kvcalloc(p->n_blocks, sizeof(*p->magic), GFP_KERNEL);
+	if (!p->magic)
+		p->n_blocks = 0;
+
+	list_add(&p->list, &probe_list);
+
+	return p;
+}
+
+static struct mtdsplit_stats *mtdsplit_stats_get(const char *parser)
+{
+	static struct mtdsplit_stats fallback = { .parser = "(unknown)" };
+	struct mtdsplit_stats *st;
+
+	list_for_each_entry(st, &stats_list, list)
+		if (!strcmp(st->parser, parser))
+			return st;
+
+	st = kzalloc(sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return &fallback;
+
+	st->parser = parser;
+	list_add_tail(&st->list, &stats_list);
+
+	return st;
+}
+
+static int mtdsplit_read_flash(struct mtd_info *mtd, loff_t from, size_t len,
+			       size_t *retlen, u_char *buf,
+			       struct mtdsplit_stats *st)
+{
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = mtd_read(mtd, from, len, retlen, buf);
+
+	st->time_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	st->reads++;
+	st->bytes += *retlen;
+
+	return ret;
+}
+
+static int mtdsplit_read(struct mtd_info *mtd, loff_t from, size_t len,
+			 size_t *retlen, u_char *buf, bool readahead,
+			 const char *parser)
+{
+	struct mtdsplit_stats *st = mtdsplit_stats_get(parser);
+	struct mtdsplit_probe *p = mtdsplit_probe_get(mtd);
+	loff_t ofs = mtd_get_master_ofs(mtd, from);
+	size_t winlen;
+	int ret;
+
+	if (!p || from < 0 || from >= mtd->size)
+		return mtdsplit_read_flash(mtd, from, len, retlen, buf, st);
+
+	if (p->buf_len && ofs >= p->buf_ofs &&
+	    ofs + len <= p->buf_ofs + p->buf_len) {
+		memcpy(buf, p->buf + (ofs - p->buf_ofs), len);
+		*retlen = len;
+		st->hits++;
+		return 0;
+	}
+
+	/* don't read ahead past the end of the partition */
+	winlen = min_t(u64, MTDSPLIT_PROBE_WINDOW, mtd->size - from);
+	if (!readahead || len > MTDSPLIT_PROBE_WINDOW / 2 || winlen < len)
+		return mtdsplit_read_flash(mtd, from, len, retlen, buf, st);
+
+	if (!p->buf) {
+		p->buf = kmalloc(MTDSPLIT_PROBE_WINDOW, GFP_KERNEL);
+		if (!p->buf)
+			return mtdsplit_read_flash(mtd, from, len, retlen, buf, st);
+	}
+
+	p->buf_len = 0;
+	ret = mtdsplit_read_flash(mtd, from, winlen, retlen, p->buf, st);
+
+	/* corrected bitflips still return valid data, anything else may
+	 * come from beyond the requested range, so retry without read-ahead */
+	if ((ret && !mtd_is_bitflip(ret)) || *retlen != winlen)
+		return mtdsplit_read_flash(mtd, from, len, retlen, buf, st);
+
+	p->buf_ofs = ofs;
+	p->buf_len = winlen;
+	memcpy(buf, p->buf, len);
+	*retlen = len;
+
+	return 0;
+}
+
+int __mtd_split_read(struct mtd_info *mtd, loff_t from, size_t len,
+		     size_t *retlen, u_char *buf, const char *parser)
+{
+	int ret;
+
+	mutex_lock(&probe_lock);
+	ret = mtdsplit_read(mtd, from, len, retlen, buf, true, parser);
+	mutex_unlock(&probe_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(__mtd_split_read);
+
 struct squashfs_super_block {
 	__le32 s_magic;
 	__le32 pad0[9];
 	__le64 bytes_used;
 };
 
-int mtd_get_squashfs_len(struct mtd_info *master,
-			 size_t offset,
-			 size_t *squashfs_len)
+int __mtd_get_squashfs_len(struct mtd_info *master,
+			   size_t offset,
+			   size_t *squashfs_len,
+			   const char *parser)
 {
 	struct squashfs_super_block sb;
 	size_t retlen;
 	int err;
 
-	err = mtd_read(master, offset, sizeof(sb), &retlen, (void *)&sb);
+	err = __mtd_split_read(master, offset, sizeof(sb), &retlen, (void *)&sb,
+			       parser);
 	if (err || (retlen != sizeof(sb))) {
 		pr_alert("error occured while reading from \"%s\"\n",
 			 master->name);
@@ -65,66 +263,170 @@ int mtd_get_squashfs_len(struct mtd_info *master,
 	*squashfs_len = retlen;
 	return 0;
 }
-EXPORT_SYMBOL_GPL(mtd_get_squashfs_len);
+EXPORT_SYMBOL_GPL(__mtd_get_squashfs_len);
 
 static ssize_t mtd_next_eb(struct mtd_info *mtd, size_t offset)
 {
 	return mtd_rounddown_to_eb(offset, mtd) + mtd->erasesize;
 }
 
-int mtd_check_rootfs_magic(struct mtd_info *mtd, size_t offset,
-			   enum mtdsplit_part_type *type)
+static int mtdsplit_check_magic(struct mtd_info *mtd, size_t offset,
+				enum mtdsplit_part_type *type,
+				const char *parser)
 {
-	u32 magic;
+	struct mtdsplit_probe *p = mtdsplit_probe_get(mtd);
+	struct mtd_info *master = mtd_get_master(mtd);
+	u64 ofs = mtd_get_master_ofs(mtd, offset);
+	enum mtdsplit_part_type t;
+	u8 *memo = NULL;
 	size_t retlen;
+	u32 magic;
 	int ret;
 
-	ret = mtd_read(mtd, offset, sizeof(magic), &retlen,
-		       (unsigned char *) &magic);
+	if (p && p->n_blocks && offset < mtd->size &&
+	    !mtd_mod_by_eb(ofs, master))
+		memo = &p->magic[mtd_div_by_eb(ofs, master)];
+
+	if (memo && *memo != PROBE_MAGIC_UNKNOWN) {
+		mtdsplit_stats_get(parser)->magic_hits++;
+		if (*memo == PROBE_MAGIC_NONE)
+			return -EINVAL;
+
+		if (type)
+			*type = *memo - PROBE_MAGIC_FOUND;
+		return 0;
+	}
+
+	/* read ahead only if the window covers further erase blocks */
+	ret = mtdsplit_read(mtd, offset, sizeof(magic), &retlen,
+			    (unsigned char *) &magic,
+			    mtd->erasesize < MTDSPLIT_PROBE_WINDOW, parser);
 	if (ret)
 		return ret;
 
 	if (retlen != sizeof(magic))
 		return -EIO;
 
-	if (le32_to_cpu(magic) == SQUASHFS_MAGIC) {
-		if (type)
-			*type = MTDSPLIT_PART_TYPE_SQUASHFS;
-		return 0;
-	} else if (magic == 0x19852003) {
-		if (type)
-			*type = MTDSPLIT_PART_TYPE_JFFS2;
-		return 0;
-	} else if (be32_to_cpu(magic) == UBI_EC_MAGIC) {
-		if (type)
-			*type = MTDSPLIT_PART_TYPE_UBI;
-		return 0;
-	}
+	if (le32_to_cpu(magic) == SQUASHFS_MAGIC)
+		t = MTDSPLIT_PART_TYPE_SQUASHFS;
+	else if (magic == 0x19852003)
+		t = MTDSPLIT_PART_TYPE_JFFS2;
+	else if (be32_to_cpu(magic) == UBI_EC_MAGIC)
+		t = MTDSPLIT_PART_TYPE_UBI;
+	else
+		t = MTDSPLIT_PART_TYPE_UNK;
 
-	return -EINVAL;
+	if (memo)
+		*memo = t ? PROBE_MAGIC_FOUND + t : PROBE_MAGIC_NONE;
+
+	if (!t)
+		return -EINVAL;
+
+	if (type)
+		*type = t;
+	return 0;
 }
-EXPORT_SYMBOL_GPL(mtd_check_rootfs_magic);
 
-int mtd_find_rootfs_from(struct mtd_info *mtd,
-			 size_t from,
-			 size_t limit,
-			 size_t *ret_offset,
-			 enum mtdsplit_part_type *type)
+int __mtd_check_rootfs_magic(struct mtd_info *mtd, size_t offset,
+			     enum mtdsplit_part_type *type,
+			     const char *parser)
+{
+	int ret;
+
+	mutex_lock(&probe_lock);
+	ret = mtdsplit_check_magic(mtd, offset, type, parser);
+	mutex_unlock(&probe_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(__mtd_check_rootfs_magic);
+
+int __mtd_find_rootfs_from(struct mtd_info *mtd,
+			   size_t from,
+			   size_t limit,
+			   size_t *ret_offset,
+			   enum mtdsplit_part_type *type,
+			   const char *parser)
 {
 	size_t offset;
-	int err;
+	int err = -ENODEV;
+
+	mutex_lock(&probe_lock);
 
 	for (offset = from; offset < limit;
 	     offset = mtd_next_eb(mtd, offset)) {
-		err = mtd_check_rootfs_magic(mtd, offset, type);
-		if (err)
+		if (mtdsplit_check_magic(mtd, offset, type, parser))
 			continue;
 
 		*ret_offset = offset;
-		return 0;
+		err = 0;
+		break;
 	}
 
-	return -ENODEV;
+	mutex_unlock(&probe_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(__mtd_find_rootfs_from);
+
+void mtd_split_probe_reset(struct mtd_info *mtd)
+{
+	struct mtd_info *master = mtd_get_master(mtd);
+	struct mtdsplit_probe *p;
+
+	mutex_lock(&probe_lock);
+	list_for_each_entry(p, &probe_list, list) {
+		if (p->master == master) {
+			mtdsplit_probe_free(p);
+			break;
+		}
+	}
+	mutex_unlock(&probe_lock);
+}
+EXPORT_SYMBOL_GPL(mtd_split_probe_reset);
+
+static void mtdsplit_notify_add(struct mtd_info *mtd)
+{
+}
+
+static void mtdsplit_notify_remove(struct mtd_info *mtd)
+{
+	mtd_split_probe_reset(mtd);
+}
+
+static struct mtd_notifier mtdsplit_notifier = {
+	.add = mtdsplit_notify_add,
+	.remove = mtdsplit_notify_remove,
+};
+
+static int mtdsplit_stats_show(struct seq_file *s, void *unused)
+{
+	struct mtdsplit_stats *st;
+
+	seq_printf(s, "%-24s %8s %12s %8s %12s %10s\n", "parser", "reads",
+		   "bytes", "hits", "magic_hits", "time_us");
+
+	mutex_lock(&probe_lock);
+	list_for_each_entry(st, &stats_list, list)
+		seq_printf(s, "%-24s %8llu %12llu %8llu %12llu %10llu\n",
+			   st->parser, st->reads, st->bytes, st->hits,
+			   st->magic_hits, div_u64(st->time_ns, NSEC_PER_USEC));
+	mutex_unlock(&probe_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mtdsplit_stats);
+
+static int __init mtdsplit_init(void)
+{
+	struct dentry *dir;
+
+	register_mtd_user(&mtdsplit_notifier);
+
+	dir = debugfs_create_dir("mtdsplit", NULL);
+	debugfs_create_file("stats", 0400, dir, NULL, &mtdsplit_stats_fops);
+
+	return 0;
 }
-EXPORT_SYMBOL_GPL(mtd_find_rootfs_from);
+subsys_initcall(mtdsplit_init);
 
@@ -27,20 +27,56 @@ enum mtdsplit_part_type {
 };
 
 #ifdef CONFIG_MTD_SPLIT
-int mtd_get_squashfs_len(struct mtd_info *master,
-			 size_t offset,
-			 size_t *squashfs_len);
+/*
+ * These go through the shared probe cache, reads are accounted to the
+ * calling parser in /sys/kernel/debug/mtdsplit/stats.
+ */
+int __mtd_split_read(struct mtd_info *mtd, loff_t from, size_t len,
+		     size_t *retlen, u_char *buf, const char *parser);
+
+/* Drop the cached data of the master, called before each split */
+void mtd_split_probe_reset(struct mtd_info *mtd);
+
+int __mtd_get_squashfs_len(struct mtd_info *master,
+			   size_t offset,
+			   size_t *squashfs_len,
+			   const char *parser);
+
+int __mtd_check_rootfs_magic(struct mtd_info *mtd, size_t offset,
+			     enum mtdsplit_part_type *type,
+			     const char *parser);
+
+int __mtd_find_rootfs_from(struct mtd_info *mtd,
+			   size_t from,
+			   size_t limit,
+			   size_t *ret_offset,
+			   enum mtdsplit_part_type *type,
+			   const char *parser);
+
+#define mtd_split_read(mtd, from, len, retlen, buf) \
+	__mtd_split_read(mtd, from, len, retlen, buf, KBUILD_MODNAME)
 
-int mtd_check_rootfs_magic(struct mtd_info *mtd, size_t offset,
-			   enum mtdsplit_part_type *type);
+#define mtd_get_squashfs_len(master, offset, squashfs_len) \
+	__mtd_get_squashfs_len(master, offset, squashfs_len, KBUILD_MODNAME)
 
-int mtd_find_rootfs_from(struct mtd_info *mtd,
-			 size_t from,
-			 size_t limit,
-			 size_t *ret_offset,
-			 enum mtdsplit_part_type *type);
+#define mtd_check_rootfs_magic(mtd, offset, type) \
+	__mtd_check_rootfs_magic(mtd, offset, type, KBUILD_MODNAME)
+
+#define mtd_find_rootfs_from(mtd, from, limit, ret_offset, type) \
+	__mtd_find_rootfs_from(mtd, from, limit, ret_offset, type, \
+			       KBUILD_MODNAME)
 
 #else
+static inline void mtd_split_probe_reset(struct mtd_info *mtd)
+{
+}
+
+static inline int mtd_split_read(struct mtd_info *mtd, loff_t from, size_t len,
+				 size_t *retlen, u_char *buf)
+{
+	return mtd_read(mtd, from, len, retlen, buf);
+}
+
 static inline int mtd_get_squashfs_len(struct mtd_info *master,
 				       size_t offset,
 				       size_t *squashfs_len)
@@ -82,8 +82,8 @@ static int jffs2_find_file(struct mtd_info *mtd, uint8_t *buf,
 		unsigned int block_offs = 0;
 
 		/* Skip CFE erased blocks */
-		rc = mtd_read(mtd, *offs, sizeof(magic), &retlen,
-			      (void *) &magic);
+		rc = mtd_split_read(mtd, *offs, sizeof(magic), &retlen,
+				    (void *) &magic);
 		if (rc || retlen != sizeof(magic)) {
 			continue;
 		}
@@ -93,8 +93,8 @@ static int jffs2_find_file(struct mtd_info *mtd, uint8_t *buf,
 			continue;
 
 		/* Read full block */
-		rc = mtd_read(mtd, *offs, mtd->erasesize, &retlen,
-			      (void *) buf);
+		rc = mtd_split_read(mtd, *offs, mtd->erasesize, &retlen,
+				    (void *) buf);
 		if (rc)
 			return rc;
 		if (retlen != mtd->erasesize)
@@ -142,8 +142,8 @@ static int ubifs_find(struct mtd_info *mtd, loff_t *offs, loff_t size)
 	int rc;
 
 	for (; *offs < end; *offs += mtd->erasesize) {
-		rc = mtd_read(mtd, *offs, sizeof(magic), &retlen,
-			      (unsigned char *) &magic);
+		rc = mtd_split_read(mtd, *offs, sizeof(magic), &retlen,
+				    (unsigned char *) &magic);
 		if (rc || retlen != sizeof(magic))
 			continue;
 
@@ -398,7 +398,7 @@ static int sercomm_bootflag_value(struct mtd_info *mtd, uint8_t *buf)
 	int rc;
 
 	for (offs = 0; offs < mtd->size; offs += mtd->erasesize) {
-		rc = mtd_read(mtd, offs, SERCOMM_MAGIC_LEN, &retlen, buf);
+		rc = mtd_split_read(mtd, offs, SERCOMM_MAGIC_LEN, &retlen, buf);
 		if (rc || retlen != SERCOMM_MAGIC_LEN)
 			continue;
 
@@ -39,7 +39,7 @@ static int mtdsplit_parse_eva(struct mtd_info *master,
 	unsigned long kernel_size, rootfs_offset;
 	int err;
 
-	err = mtd_read(master, 0, sizeof(hdr), &retlen, (void *) &hdr);
+	err = mtd_split_read(master, 0, sizeof(hdr), &retlen, (void *) &hdr);
 	if (err)
 		return err;
 
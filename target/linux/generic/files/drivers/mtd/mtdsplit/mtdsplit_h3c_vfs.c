@@ -90,8 +90,8 @@ static int mtdsplit_h3c_vfs_parse(struct mtd_info *mtd,
 		return -EINVAL;
 
 	/* Check format flag */
-	err = mtd_read(mtd, FORMAT_FLAG_OFFSET, sizeof(format_flag), &retlen,
-		       (void *) &format_flag);
+	err = mtd_split_read(mtd, FORMAT_FLAG_OFFSET, sizeof(format_flag),
+			     &retlen, (void *) &format_flag);
 	if (err)
 		return err;
 
@@ -102,8 +102,8 @@ static int mtdsplit_h3c_vfs_parse(struct mtd_info *mtd,
 		return -EINVAL;
 
 	/* Check file entry */
-	err = mtd_read(mtd, FILE_ENTRY_OFFSET, sizeof(file_entry), &retlen,
-		       (void *) &file_entry);
+	err = mtd_split_read(mtd, FILE_ENTRY_OFFSET, sizeof(file_entry),
+			     &retlen, (void *) &file_entry);
 	if (err)
 		return err;
 
@@ -60,7 +60,7 @@ static int mtdsplit_parse_minor(struct mtd_info *master,
 	int err;
 
 	hdr_len = sizeof(hdr);
-	err = mtd_read(master, 0, hdr_len, &retlen, (void *) &hdr);
+	err = mtd_split_read(master, 0, hdr_len, &retlen, (void *) &hdr);
 	if (err)
 		return err;
 
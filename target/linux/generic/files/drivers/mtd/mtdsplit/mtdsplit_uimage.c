@@ -49,7 +49,7 @@ read_uimage_header(struct mtd_info *mtd, size_t offset, u_char *buf,
 	size_t retlen;
 	int ret;
 
-	ret = mtd_read(mtd, offset, header_len, &retlen, buf);
+	ret = mtd_split_read(mtd, offset, header_len, &retlen, buf);
 	if (ret) {
 		pr_debug("read error in \"%s\"\n", mtd->name);
 		return ret;
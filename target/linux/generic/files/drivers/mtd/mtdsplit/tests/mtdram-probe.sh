@@ -0,0 +1,111 @@
+#!/bin/sh
+# Probe a fake uImage + squashfs firmware on an mtdram device and show how
+# much flash the split parsers read.
+#
+# A "firmware" partition is added on top of mtdram, which makes the kernel
+# run all firmware split parsers on it. The test passes if the partition is
+# split into "kernel" and "rootfs" at the expected offsets.
+#
+# Requires root, a kernel with CONFIG_MTD_SPLIT_FIRMWARE (name "firmware"),
+# the mtdram module, debugfs and mtdpart from mtd-utils.
+#
+# Environment:
+#   SIZE_KB    mtdram size in KiB (default 16384)
+#   ERASE_KB   erase block size in KiB (default 64)
+#   KERNEL_KB  uImage payload size in KiB (default 1500)
+
+set -e
+
+SIZE_KB="${SIZE_KB:-16384}"
+ERASE_KB="${ERASE_KB:-64}"
+KERNEL_KB="${KERNEL_KB:-1500}"
+
+stats=/sys/kernel/debug/mtdsplit/stats
+img="$(mktemp)"
+before="$(mktemp)"
+mtd=
+fw=
+
+cleanup() {
+	rm -f "$img" "$before"
+	# deleting the firmware partition also deletes its split partitions
+	[ -n "$fw" ] && mtdpart del "/dev/$mtd" "${fw#mtd}" 2>/dev/null
+	rmmod mtdram 2>/dev/null || true
+}
+trap cleanup EXIT
+
+fail() {
+	echo "FAIL: $*" >&2
+	cat /proc/mtd >&2
+	exit 1
+}
+
+be32() {
+	printf "\\$(printf %03o $(($1 >> 24 & 255)))\\$(printf %03o $(($1 >> 16 & 255)))"
+	printf "\\$(printf %03o $(($1 >> 8 & 255)))\\$(printf %03o $(($1 & 255)))"
+}
+
+le32() {
+	printf "\\$(printf %03o $(($1 & 255)))\\$(printf %03o $(($1 >> 8 & 255)))"
+	printf "\\$(printf %03o $(($1 >> 16 & 255)))\\$(printf %03o $(($1 >> 24 & 255)))"
+}
+
+zeros() {
+	[ "$1" -gt 0 ] && head -c "$1" /dev/zero
+	return 0
+}
+
+erase=$((ERASE_KB * 1024))
+kernel_len=$((KERNEL_KB * 1024))
+rootfs_ofs=$(((64 + kernel_len + erase - 1) / erase * erase))
+rootfs_len=$((2 * 1024 * 1024))
+
+{
+	# uImage header: magic, hcrc, time, size, load, ep, dcrc, os, arch, type
+	be32 0x27051956; zeros 8; be32 "$kernel_len"; zeros 12
+	printf '\005\005\002\000'; zeros 32
+	zeros "$kernel_len"
+	zeros $((rootfs_ofs - 64 - kernel_len))
+
+	# squashfs superblock with bytes_used at offset 40
+	printf 'hsqs'; zeros 36; le32 "$rootfs_len"; zeros 4
+	zeros $((rootfs_len - 48))
+} > "$img"
+
+modprobe mtdram total_size="$SIZE_KB" erase_size="$ERASE_KB"
+[ -f "$stats" ] || mount -t debugfs none /sys/kernel/debug
+
+mtd="$(grep -l "mtdram test device" /sys/class/mtd/mtd*/name | head -n1)"
+mtd="$(basename "$(dirname "$mtd")")"
+[ -n "$mtd" ] || fail "no mtdram device"
+
+dd if="$img" of="/dev/$mtd" bs="$erase" conv=notrunc 2>/dev/null
+
+cat "$stats" > "$before"
+devs="$(ls /sys/class/mtd)"
+
+start="$(date +%s%N)"
+mtdpart add "/dev/$mtd" firmware 0 $((SIZE_KB * 1024))
+end="$(date +%s%N)"
+
+for dev in $(grep -lx firmware /sys/class/mtd/mtd*/name); do
+	dev="$(basename "$(dirname "$dev")")"
+	echo "$devs" | grep -qx "$dev" || fw="$dev"
+done
+
+part_ofs() {
+	local dev="$(grep -l "^$1\$" /sys/class/mtd/mtd*/name | tail -n1)"
+
+	[ -n "$dev" ] && cat "$(dirname "$dev")/offset"
+}
+
+[ "$(part_ofs kernel)" = 0 ] || fail "kernel partition"
+[ "$(part_ofs rootfs)" = "$rootfs_ofs" ] || fail "rootfs partition"
+
+echo "PASS: split in $(((end - start) / 1000)) us"
+echo
+echo "before:"
+cat "$before"
+echo
+echo "after:"
+cat "$stats"
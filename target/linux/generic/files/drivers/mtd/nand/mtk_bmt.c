@@ -103,9 +103,20 @@ mtk_bmt_remap_block(u32 block, u32 mapped_block, int copy_len)
 	return bmtd.ops->remap_block(block, mapped_block, copy_len);
 }
 
+/*
+ * Remaps may be collected by the ops until the end of an MTD operation.
+ * Write them back before the operation returns to its caller.
+ */
+static void
+mtk_bmt_commit(void)
+{
+	if (bmtd.ops->commit)
+		bmtd.ops->commit();
+}
+
 static int
-mtk_bmt_read(struct mtd_info *mtd, loff_t from,
-	     struct mtd_oob_ops *ops)
+__mtk_bmt_read(struct mtd_info *mtd, loff_t from,
+	       struct mtd_oob_ops *ops)
 {
 	struct mtd_oob_ops cur_ops = *ops;
 	int retry_count = 0;
@@ -172,8 +183,20 @@ out:
 }
 
 static int
-mtk_bmt_write(struct mtd_info *mtd, loff_t to,
-	      struct mtd_oob_ops *ops)
+mtk_bmt_read(struct mtd_info *mtd, loff_t from,
+	     struct mtd_oob_ops *ops)
+{
+	int ret;
+
+	ret = __mtk_bmt_read(mtd, from, ops);
+	mtk_bmt_commit();
+
+	return ret;
+}
+
+static int
+__mtk_bmt_write(struct mtd_info *mtd, loff_t to,
+		struct mtd_oob_ops *ops)
 {
 	struct mtd_oob_ops cur_ops = *ops;
 	int retry_count = 0;
@@ -226,14 +249,26 @@ mtk_bmt_write(struct mtd_info *mtd, loff_t to,
 }
 
 static int
-mtk_bmt_mtd_erase(struct mtd_info *mtd, struct erase_info *instr)
+mtk_bmt_write(struct mtd_info *mtd, loff_t to,
+	      struct mtd_oob_ops *ops)
+{
+	int ret;
+
+	ret = __mtk_bmt_write(mtd, to, ops);
+	mtk_bmt_commit();
+
+	return ret;
+}
+
+static int
+__mtk_bmt_mtd_erase(struct mtd_info *mtd, struct erase_info *instr)
 {
 	struct erase_info mapped_instr = {
 		.len = bmtd.blk_size,
 	};
 	int retry_count = 0;
 	u64 start_addr, end_addr;
-	int ret;
+	int ret = 0;
 	u16 orig_block;
 	int block;
 
@@ -260,6 +295,18 @@ mtk_bmt_mtd_erase(struct mtd_info *mtd, struct erase_info *instr)
 
 	return ret;
 }
+
+static int
+mtk_bmt_mtd_erase(struct mtd_info *mtd, struct erase_info *instr)
+{
+	int ret;
+
+	ret = __mtk_bmt_mtd_erase(mtd, instr);
+	mtk_bmt_commit();
+
+	return ret;
+}
+
 static int
 mtk_bmt_block_isbad(struct mtd_info *mtd, loff_t ofs)
 {
@@ -276,6 +323,7 @@ retry:
 		    retry_count++ < 10)
 			goto retry;
 	}
+	mtk_bmt_commit();
 	return ret;
 }
 
@@ -290,6 +338,7 @@ mtk_bmt_block_markbad(struct mtd_info *mtd, loff_t ofs)
 		return -EIO;
 
 	mtk_bmt_remap_block(orig_block, block, bmtd.blk_size);
+	mtk_bmt_commit();
 
 	return bmtd._block_markbad(mtd, (loff_t)block << bmtd.blk_shift);
 }
@@ -350,6 +399,7 @@ static int mtk_bmt_debug_mark_bad(void *data, u64 val)
 		return -EIO;
 
 	mtk_bmt_remap_block(block, cur_block, bmtd.blk_size);
+	mtk_bmt_commit();
 
 	return 0;
 }
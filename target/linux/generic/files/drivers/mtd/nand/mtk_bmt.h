@@ -21,6 +21,8 @@ struct mtk_bmt_ops {
 	void (*unmap_block)(u16 block);
 	int (*get_mapping_block)(int block);
 	int (*debug)(void *data, u64 val);
+	/* optional, write back remaps deferred by remap_block */
+	void (*commit)(void);
 };
 
 struct bbbt;
@@ -121,7 +123,7 @@ static inline int write_bmt(u16 block, unsigned char *dat)
 	struct mtd_oob_ops ops = {
 		.mode = MTD_OPS_PLACE_OOB,
 		.ooboffs = OOB_SIGNATURE_OFFSET + bmtd.oob_offset,
-		.oobbuf = bmtd.ops->sig,
+		.oobbuf = (u8 *)bmtd.ops->sig,
 		.ooblen = bmtd.ops->sig_len,
 		.datbuf = dat,
 		.len = bmtd.bmt_pgs << bmtd.pg_shift,
@@ -1,4 +1,5 @@
 #include <linux/crc32.h>
+#include <linux/ktime.h>
 #include <linux/slab.h>
 #include "mtk_bmt.h"
 
@@ -9,6 +10,7 @@
 
 #define NMBM_MAGIC_SIGNATURE			0x304d4d4e	/* NMM0 */
 #define NMBM_MAGIC_INFO_TABLE			0x314d4d4e	/* NMM1 */
+#define NMBM_MAGIC_HINT				0x324d4d4e	/* NMM2 */
 
 #define NMBM_VERSION_MAJOR_S			0
 #define NMBM_VERSION_MAJOR_M			0xffff
@@ -73,6 +75,26 @@ struct nmbm_info_table_header {
 	u32 padding;
 };
 
+/*
+ * Info table location hint
+ *
+ * The signature is only repeated in the first half of the signature block,
+ * the second half is an append-only log of hints, one per page. The last
+ * programmed page tells where both info tables were when they had the given
+ * write count, and how many attaches found the previous hint outdated.
+ * Chips created without hint log have the signature in every page and always
+ * use the full table search.
+ */
+struct nmbm_hint {
+	struct nmbm_header header;
+	u32 generation;
+	u32 write_count;
+	u32 main_table_ba;
+	u32 backup_table_ba;
+	u32 misses;
+	u32 padding;
+};
+
 struct nmbm_instance {
 	u32 rawpage_size;
 	u32 rawblock_size;
@@ -111,6 +133,23 @@ struct nmbm_instance {
 	u32 max_reserved_blocks;
 	bool empty_page_ecc_ok;
 	bool force_create;
+	bool write_back;
+
+	u32 remaps_pending;
+	u32 table_commits;
+	u32 table_updates_avoided;
+
+	/* write count of the main table on flash, see nmbm_write_hint() */
+	u32 main_table_write_count;
+
+	struct nmbm_hint hint;
+	u32 hint_page;
+	bool hint_valid;
+	bool hint_log_broken;
+
+	u64 attach_time_ns;
+	bool attach_hinted;
+	bool attach_hint_missed;
 };
 
 static inline u32 nmbm_crc32(u32 crcval, const void *buf, size_t size)
@@ -722,9 +761,10 @@ static void nmbm_erase_range(struct nmbm_instance *ni, uint32_t ba,
  * @ba: block address where the data will be written to
  * @data: the data to be written
  * @size: size of the data
+ * @pages: number of pages to write, starting from the first page
  *
- * Write data to every page of the block. Success only if all pages within
- * this block have been successfully written.
+ * Write data to the first @pages pages of the block. Success only if all of
+ * these pages have been successfully written.
  *
  * Make sure data size is not bigger than one page.
  *
@@ -732,7 +772,8 @@ static void nmbm_erase_range(struct nmbm_instance *ni, uint32_t ba,
  * NMBM_TRY_COUNT times.
  */
 static bool nmbm_write_repeated_data(struct nmbm_instance *ni, uint32_t ba,
-				     const void *data, uint32_t size)
+				     const void *data, uint32_t size,
+				     uint32_t pages)
 {
 	uint64_t addr, off;
 	bool success;
@@ -743,7 +784,8 @@ static bool nmbm_write_repeated_data(struct nmbm_instance *ni, uint32_t ba,
 
 	addr = ba2addr(ni, ba);
 
-	for (off = 0; off < bmtd.blk_size; off += bmtd.pg_size) {
+	for (off = 0; off < (uint64_t)pages << bmtd.pg_shift;
+	     off += bmtd.pg_size) {
 		/* Prepare page data. fill 0xff to unused region */
 		memcpy(ni->page_cache, data, size);
 		memset(ni->page_cache + size, 0xff, ni->rawpage_size - size);
@@ -764,6 +806,14 @@ static bool nmbm_write_repeated_data(struct nmbm_instance *ni, uint32_t ba,
 	return true;
 }
 
+/*
+ * nmbm_hint_first_page - Get the first page of the hint log
+ */
+static uint32_t nmbm_hint_first_page(void)
+{
+	return (bmtd.blk_size >> bmtd.pg_shift) / 2;
+}
+
 /*
  * nmbm_write_signature - Write signature to NAND chip
  * @ni: NMBM instance structure
@@ -798,7 +848,8 @@ static bool nmbm_write_signature(struct nmbm_instance *ni, uint32_t limit,
 			goto skip_bad_block;
 
 		success = nmbm_write_repeated_data(ni, ba, signature,
-						   sizeof(*signature));
+						   sizeof(*signature),
+						   nmbm_hint_first_page());
 		if (success) {
 			*signature_ba = ba;
 			return true;
@@ -863,6 +914,197 @@ static int nmbn_read_data(struct nmbm_instance *ni, uint64_t addr, void *data,
 	return 0;
 }
 
+/*
+ * nmbm_hint_page_erased - Check whether a page of the signature block is erased
+ * @ni: NMBM instance structure
+ * @page: page index within the signature block
+ * @hint: used for storing the record of a programmed page
+ * @hint_page: set to @page if @hint has been filled
+ *
+ * Pages which can't be read are treated as programmed.
+ */
+static bool nmbm_hint_page_erased(struct nmbm_instance *ni, uint32_t page,
+				  struct nmbm_hint *hint, uint32_t *hint_page)
+{
+	uint64_t addr = ba2addr(ni, ni->signature_ba) +
+			((uint64_t)page << bmtd.pg_shift);
+	int ret;
+
+	ret = nmbm_read_phys_page(ni, addr, ni->page_cache, NULL);
+	if (ret < 0)
+		return false;
+
+	if (!memchr_inv(ni->page_cache, 0xff, bmtd.pg_size))
+		return true;
+
+	memcpy(hint, ni->page_cache, sizeof(*hint));
+	*hint_page = page;
+
+	return false;
+}
+
+/*
+ * nmbm_read_hint - Read the latest info table location hint
+ * @ni: NMBM instance structure
+ *
+ * Find the end of the hint log with a binary search and load its last
+ * record. ni->hint_page is left at the next free page, or 0 if the
+ * signature block has no hint log.
+ */
+static void nmbm_read_hint(struct nmbm_instance *ni)
+{
+	uint32_t first = nmbm_hint_first_page();
+	uint32_t lo = first, hi = bmtd.blk_size >> bmtd.pg_shift, mid;
+	uint32_t hint_page = 0;
+	struct nmbm_hint hint;
+	int ret;
+
+	ni->hint_page = 0;
+	ni->hint_valid = false;
+
+	/* Signature in all pages, this chip has no hint log */
+	ret = nmbn_read_data(ni, ba2addr(ni, ni->signature_ba) +
+			     ((uint64_t)first << bmtd.pg_shift),
+			     &ni->hint, sizeof(ni->hint));
+	if (!ret && ni->hint.header.magic == NMBM_MAGIC_SIGNATURE)
+		return;
+
+	/* Hints are appended in page order, find the first erased page */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (nmbm_hint_page_erased(ni, mid, &hint, &hint_page))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	ni->hint_page = lo;
+	if (lo == first)
+		return;
+
+	/* The last record has usually been read by the search already */
+	ret = 0;
+	if (hint_page != lo - 1)
+		ret = nmbn_read_data(ni, ba2addr(ni, ni->signature_ba) +
+				     ((uint64_t)(lo - 1) << bmtd.pg_shift),
+				     &hint, sizeof(hint));
+	if (ret || hint.header.magic != NMBM_MAGIC_HINT ||
+	    !nmbm_check_header(&hint, sizeof(hint)))
+		return;
+
+	memcpy(&ni->hint, &hint, sizeof(hint));
+	ni->hint_valid = true;
+}
+
+/*
+ * nmbm_reclaim_hint_log - Start a new hint log
+ * @ni: NMBM instance structure
+ *
+ * Erase the signature block and write the signature to its first half
+ * again. This is also how a signature block without hint log, written by
+ * U-Boot or an older kernel, gets one. The signature is only missing between
+ * the erase and the first page write, like during nmbm_create_new().
+ */
+static bool nmbm_reclaim_hint_log(struct nmbm_instance *ni)
+{
+	bool success;
+
+	success = nmbm_erase_block_and_check(ni, ni->signature_ba);
+	if (success)
+		success = nmbm_write_repeated_data(ni, ni->signature_ba,
+						   &ni->signature,
+						   sizeof(ni->signature),
+						   nmbm_hint_first_page());
+
+	/* Retry once, the signature must not get lost */
+	if (!success) {
+		nlog_warn(ni, "Failed to rewrite signature block %u, retrying\n",
+			  ni->signature_ba);
+		success = nmbm_erase_block_and_check(ni, ni->signature_ba) &&
+			  nmbm_write_repeated_data(ni, ni->signature_ba,
+						   &ni->signature,
+						   sizeof(ni->signature),
+						   nmbm_hint_first_page());
+	}
+
+	if (!success) {
+		nlog_err(ni, "Failed to rewrite signature block %u\n",
+			 ni->signature_ba);
+		ni->hint_log_broken = true;
+		return false;
+	}
+
+	nlog_info(ni, "Hint log in signature block %u has been reclaimed\n",
+		  ni->signature_ba);
+	ni->hint_page = nmbm_hint_first_page();
+
+	return true;
+}
+
+/*
+ * nmbm_write_hint - Record the current info table locations
+ * @ni: NMBM instance structure
+ *
+ * Append a hint for the current info tables if it differs from the last one.
+ * A failed or interrupted write only leaves an invalid last record behind,
+ * which makes the next attach use the full table search.
+ *
+ * The recorded write count is the one of the main table on flash, the one in
+ * ni->info_table is ahead as long as changes are pending. A full log, or a
+ * signature block without log, is reclaimed by rewriting the signature block
+ * first.
+ */
+static void nmbm_write_hint(struct nmbm_instance *ni)
+{
+	struct nmbm_hint *hint = &ni->hint;
+	uint64_t addr;
+	bool success;
+
+	if (ni->protected || ni->hint_log_broken)
+		return;
+
+	if (!ni->main_table_ba || !ni->backup_table_ba)
+		return;
+
+	if (ni->hint_valid &&
+	    hint->write_count == ni->main_table_write_count &&
+	    hint->main_table_ba == ni->main_table_ba &&
+	    hint->backup_table_ba == ni->backup_table_ba)
+		return;
+
+	if ((!ni->hint_page ||
+	     ni->hint_page >= bmtd.blk_size >> bmtd.pg_shift) &&
+	    !nmbm_reclaim_hint_log(ni))
+		return;
+
+	hint->header.magic = NMBM_MAGIC_HINT;
+	hint->header.version = NMBM_VER;
+	hint->header.size = sizeof(*hint);
+	hint->generation = ni->hint_valid ? hint->generation + 1 : 1;
+	hint->write_count = ni->main_table_write_count;
+	hint->main_table_ba = ni->main_table_ba;
+	hint->backup_table_ba = ni->backup_table_ba;
+	hint->misses = ni->hint_valid ? hint->misses : 0;
+	if (ni->attach_hint_missed)
+		hint->misses++;
+	hint->padding = 0;
+	nmbm_update_checksum(&hint->header);
+
+	memcpy(ni->page_cache, hint, sizeof(*hint));
+	memset(ni->page_cache + sizeof(*hint), 0xff,
+	       ni->rawpage_size - sizeof(*hint));
+
+	addr = ba2addr(ni, ni->signature_ba) +
+	       ((uint64_t)ni->hint_page << bmtd.pg_shift);
+	success = nmbm_write_phys_page(ni, addr, ni->page_cache, NULL);
+
+	ni->hint_page++;
+	ni->hint_valid = success;
+	if (success)
+		ni->attach_hint_missed = false;
+}
+
 /*
  * nmbn_write_verify_data - Write data with validation
  * @ni: NMBM instance structure
@@ -1109,6 +1351,7 @@ static bool nmbm_rebuild_info_table(struct nmbm_instance *ni)
 	ni->mapping_blocks_ba = table_end_ba;
 
 	nmbm_mark_tables_clean(ni);
+	ni->main_table_write_count = ni->info_table.write_count;
 
 	nlog_table_creation(ni, true, table_start_ba, table_end_ba);
 
@@ -1178,6 +1421,7 @@ static bool nmbm_rescue_single_info_table(struct nmbm_instance *ni)
 		/* Erase spare blocks of main table to clean possible interference data */
 		nmbm_erase_range(ni, table_end_ba, ni->backup_table_ba);
 
+		ni->main_table_write_count = ni->info_table.write_count;
 		nlog_table_creation(ni, true, table_start_ba, table_end_ba);
 
 		return true;
@@ -1254,6 +1498,8 @@ static bool nmbm_update_single_info_table(struct nmbm_instance *ni,
 		}
 
 		nmbm_mark_tables_clean(ni);
+		if (update_main_table)
+			ni->main_table_write_count = ni->info_table.write_count;
 
 		nlog_table_update(ni, update_main_table, table_start_ba,
 				 table_end_ba);
@@ -1356,6 +1602,7 @@ static bool nmbm_rescue_main_info_table(struct nmbm_instance *ni)
 	ni->main_table_ba = main_table_start_ba;
 
 	nmbm_mark_tables_clean(ni);
+	ni->main_table_write_count = ni->info_table.write_count;
 
 	nlog_table_creation(ni, true, main_table_start_ba, main_table_end_ba);
 
@@ -1503,6 +1750,7 @@ write_main_table:
 		ni->mapping_blocks_ba = table_end_ba;
 
 	nmbm_mark_tables_clean(ni);
+	ni->main_table_write_count = ni->info_table.write_count;
 
 	nlog_table_update(ni, true, table_start_ba, table_end_ba);
 
@@ -1536,6 +1784,11 @@ static bool nmbm_update_info_table(struct nmbm_instance *ni)
 		}
 	}
 
+	/* Tables have been moved, don't leave a hint to the old location */
+	if (ni->hint.main_table_ba != ni->main_table_ba ||
+	    ni->hint.backup_table_ba != ni->backup_table_ba)
+		nmbm_write_hint(ni);
+
 	return true;
 }
 
@@ -1662,6 +1915,10 @@ static bool nmbm_create_new(struct nmbm_instance *ni)
 	nlog_info(ni, "Signature has been written to block %u [0x%08llx]\n",
 		 ni->signature_ba, ba2addr(ni, ni->signature_ba));
 
+	/* Fresh signature block, the hint log is empty */
+	ni->hint_page = nmbm_hint_first_page();
+	ni->hint_valid = false;
+
 	/* Write info table(s) */
 	success = nmbm_create_info_table(ni);
 	if (success) {
@@ -1865,53 +2122,38 @@ static bool nmbm_search_info_table(struct nmbm_instance *ni, uint32_t ba,
 }
 
 /*
- * nmbm_load_info_table - Load info table(s) from a chip
+ * nmbm_reset_info_table - Reset info table state before loading
  * @ni: NMBM instance structure
- * @ba: start block address to search info table
- * @limit: highest block address allowed for searching
  */
-static bool nmbm_load_info_table(struct nmbm_instance *ni, uint32_t ba,
-				 uint32_t limit)
+static void nmbm_reset_info_table(struct nmbm_instance *ni)
 {
-	uint32_t main_table_end_ba, backup_table_end_ba, table_end_ba;
-	uint32_t main_mapping_blocks_top_ba, backup_mapping_blocks_top_ba;
-	uint32_t main_table_write_count, backup_table_write_count;
-	uint32_t i;
-	bool success;
-
-	/* Set initial value */
 	ni->main_table_ba = 0;
 	ni->backup_table_ba = 0;
 	ni->info_table.write_count = 0;
 	ni->mapping_blocks_top_ba = ni->signature_ba - 1;
 	ni->data_block_count = ni->signature.mgmt_start_pb;
+}
 
-	/* Find first info table */
-	success = nmbm_search_info_table(ni, ba, limit, &ni->main_table_ba,
-		&main_table_end_ba, &main_table_write_count,
-		&main_mapping_blocks_top_ba, false);
-	if (!success) {
-		nlog_warn(ni, "No valid info table found\n");
-		return false;
-	}
-
-	table_end_ba = main_table_end_ba;
-
-	nlog_table_found(ni, true, main_table_write_count, ni->main_table_ba,
-			main_table_end_ba);
-
-	/* Find second info table */
-	success = nmbm_search_info_table(ni, main_table_end_ba, limit,
-		&ni->backup_table_ba, &backup_table_end_ba,
-		&backup_table_write_count, &backup_mapping_blocks_top_ba, true);
-	if (!success) {
-		nlog_warn(ni, "Second info table not found\n");
-	} else {
-		table_end_ba = backup_table_end_ba;
+/*
+ * nmbm_apply_info_table - Set up the instance from loaded info table(s)
+ * @ni: NMBM instance structure
+ * @table_end_ba: block address after the end of the last table
+ * @main_table_write_count: write count of the main table
+ * @backup_table_write_count: write count of the backup table
+ * @main_mapping_blocks_top_ba: top remapped block of the main table
+ * @backup_mapping_blocks_top_ba: top remapped block of the backup table
+ */
+static void nmbm_apply_info_table(struct nmbm_instance *ni,
+				  uint32_t table_end_ba,
+				  uint32_t main_table_write_count,
+				  uint32_t backup_table_write_count,
+				  uint32_t main_mapping_blocks_top_ba,
+				  uint32_t backup_mapping_blocks_top_ba)
+{
+	uint32_t i;
+	bool success;
 
-		nlog_table_found(ni, false, backup_table_write_count,
-				ni->backup_table_ba, backup_table_end_ba);
-	}
+	ni->main_table_write_count = main_table_write_count;
 
 	/* Pick mapping_blocks_top_ba */
 	if (!ni->backup_table_ba) {
@@ -1965,6 +2207,124 @@ static bool nmbm_load_info_table(struct nmbm_instance *ni, uint32_t ba,
 		nlog_warn(ni, "Only one info table found. Device is now read-only\n");
 		ni->protected = 1;
 	}
+}
+
+/*
+ * nmbm_load_info_table - Load info table(s) from a chip
+ * @ni: NMBM instance structure
+ * @ba: start block address to search info table
+ * @limit: highest block address allowed for searching
+ */
+static bool nmbm_load_info_table(struct nmbm_instance *ni, uint32_t ba,
+				 uint32_t limit)
+{
+	uint32_t main_table_end_ba, backup_table_end_ba, table_end_ba;
+	uint32_t main_mapping_blocks_top_ba, backup_mapping_blocks_top_ba;
+	uint32_t main_table_write_count, backup_table_write_count;
+	bool success;
+
+	nmbm_reset_info_table(ni);
+
+	/* Find first info table */
+	success = nmbm_search_info_table(ni, ba, limit, &ni->main_table_ba,
+		&main_table_end_ba, &main_table_write_count,
+		&main_mapping_blocks_top_ba, false);
+	if (!success) {
+		nlog_warn(ni, "No valid info table found\n");
+		return false;
+	}
+
+	table_end_ba = main_table_end_ba;
+
+	nlog_table_found(ni, true, main_table_write_count, ni->main_table_ba,
+			main_table_end_ba);
+
+	/* Find second info table */
+	success = nmbm_search_info_table(ni, main_table_end_ba, limit,
+		&ni->backup_table_ba, &backup_table_end_ba,
+		&backup_table_write_count, &backup_mapping_blocks_top_ba, true);
+	if (!success) {
+		nlog_warn(ni, "Second info table not found\n");
+	} else {
+		table_end_ba = backup_table_end_ba;
+
+		nlog_table_found(ni, false, backup_table_write_count,
+				ni->backup_table_ba, backup_table_end_ba);
+	}
+
+	nmbm_apply_info_table(ni, table_end_ba, main_table_write_count,
+			      backup_table_write_count,
+			      main_mapping_blocks_top_ba,
+			      backup_mapping_blocks_top_ba);
+
+	return true;
+}
+
+/*
+ * nmbm_load_hinted_info_table - Load info tables from the hinted location
+ * @ni: NMBM instance structure
+ *
+ * The hint is only used if both tables are valid at the hinted blocks and
+ * the main table still has the write count recorded in the hint. Updates
+ * write the backup table first, so any table update after the hint was
+ * written, by this or another NMBM implementation, leaves a backup table
+ * newer than the hint and makes the attach fall back to
+ * nmbm_load_info_table(). An older backup table is left behind by a rescue
+ * of the main table and gets updated as usual.
+ *
+ * The header of the main table is checked first, so an outdated hint only
+ * costs a single page read on top of the full search.
+ */
+static bool nmbm_load_hinted_info_table(struct nmbm_instance *ni)
+{
+	uint32_t main_table_end_ba, backup_table_end_ba;
+	uint32_t main_mapping_blocks_top_ba, backup_mapping_blocks_top_ba;
+	uint32_t main_table_write_count, backup_table_write_count;
+	const struct nmbm_hint *hint = &ni->hint;
+	struct nmbm_info_table_header ifthdr;
+	bool success;
+	int ret;
+
+	if (!ni->hint_valid ||
+	    hint->main_table_ba < ni->mgmt_start_ba ||
+	    hint->main_table_ba >= hint->backup_table_ba ||
+	    hint->backup_table_ba >= ni->signature_ba)
+		return false;
+
+	ret = nmbn_read_data(ni, ba2addr(ni, hint->main_table_ba), &ifthdr,
+			     sizeof(ifthdr));
+	if (ret || !nmbm_check_info_table_header(ni, &ifthdr) ||
+	    ifthdr.write_count != hint->write_count)
+		return false;
+
+	nmbm_reset_info_table(ni);
+
+	success = nmbm_try_load_info_table(ni, hint->main_table_ba,
+					   &main_table_end_ba,
+					   &main_table_write_count,
+					   &main_mapping_blocks_top_ba, false);
+	if (!success || main_table_write_count != hint->write_count ||
+	    main_table_end_ba > hint->backup_table_ba)
+		return false;
+
+	success = nmbm_try_load_info_table(ni, hint->backup_table_ba,
+					   &backup_table_end_ba,
+					   &backup_table_write_count,
+					   &backup_mapping_blocks_top_ba, true);
+	if (!success || backup_table_write_count > hint->write_count)
+		return false;
+
+	ni->main_table_ba = hint->main_table_ba;
+	ni->backup_table_ba = hint->backup_table_ba;
+
+	nlog_info(ni, "Info tables with writecount %u/%u found at hinted blocks %u and %u\n",
+		  main_table_write_count, backup_table_write_count,
+		  hint->main_table_ba, hint->backup_table_ba);
+
+	nmbm_apply_info_table(ni, backup_table_end_ba, main_table_write_count,
+			      backup_table_write_count,
+			      main_mapping_blocks_top_ba,
+			      backup_mapping_blocks_top_ba);
 
 	return true;
 }
@@ -1983,6 +2343,18 @@ static bool nmbm_load_existing(struct nmbm_instance *ni)
 	nlog_debug(ni, "NMBM management region starts at block %u [0x%08llx]\n",
 		  ni->mgmt_start_ba, ba2addr(ni, ni->mgmt_start_ba));
 
+	/* Try the location of the last attach before searching */
+	nmbm_read_hint(ni);
+
+	ni->attach_hinted = nmbm_load_hinted_info_table(ni);
+	if (ni->attach_hinted) {
+		nlog_info(ni, "NMBM has been successfully attached\n");
+		return true;
+	}
+
+	/* Counted in the next hint, which replaces the outdated one */
+	ni->attach_hint_missed = ni->hint_valid;
+
 	/* Look for info table(s) */
 	success = nmbm_load_info_table(ni, ni->mgmt_start_ba,
 		ni->signature_ba);
@@ -2184,6 +2556,8 @@ static int nmbm_attach(struct nmbm_instance *ni)
 		if (!success)
 			return -ENODEV;
 
+		nmbm_write_hint(ni);
+
 		return 0;
 	}
 
@@ -2209,6 +2583,8 @@ static int nmbm_attach(struct nmbm_instance *ni)
 	if (!success)
 		return -ENODEV;
 
+	nmbm_write_hint(ni);
+
 	return 0;
 }
 
@@ -2228,11 +2604,32 @@ static bool remap_block_nmbm(u16 block, u16 mapped_block, int copy_len)
 	bbt_nand_erase(new_block);
     if (copy_len > 0)
 		bbt_nand_copy(new_block, mapped_block, copy_len);
+
+	/* Written back by commit_nmbm() at the end of the MTD operation */
+	if (ni->write_back) {
+		ni->remaps_pending++;
+		return true;
+	}
+
 	nmbm_update_info_table(ni);
 
 	return true;
 }
 
+static void commit_nmbm(void)
+{
+	struct nmbm_instance *ni = bmtd.ni;
+
+	if (!ni->remaps_pending)
+		return;
+
+	ni->table_commits++;
+	ni->table_updates_avoided += ni->remaps_pending - 1;
+	ni->remaps_pending = 0;
+
+	nmbm_update_info_table(ni);
+}
+
 static int get_mapping_block_index_nmbm(int block)
 {
 	struct nmbm_instance *ni = bmtd.ni;
@@ -2246,6 +2643,7 @@ static int get_mapping_block_index_nmbm(int block)
 static int mtk_bmt_init_nmbm(struct device_node *np)
 {
 	struct nmbm_instance *ni;
+	ktime_t start;
 	int ret;
 
 	ni = kzalloc(nmbm_calc_structure_size(), GFP_KERNEL);
@@ -2263,11 +2661,16 @@ static int mtk_bmt_init_nmbm(struct device_node *np)
 		ni->empty_page_ecc_ok = true;
 	if (of_property_read_bool(np, "mediatek,bmt-force-create"))
 		ni->force_create = true;
+	if (of_property_read_bool(np, "mediatek,bmt-write-back"))
+		ni->write_back = true;
 
+	start = ktime_get();
 	ret = nmbm_attach(ni);
 	if (ret)
 		goto out;
 
+	ni->attach_time_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
 	bmtd.mtd->size = ni->data_block_count << bmtd.blk_shift;
 
 	return 0;
@@ -2292,6 +2695,27 @@ static int mtk_bmt_debug_nmbm(void *data, u64 val)
 
 			printk("remap [%x->%x]\n", i, ni->block_mapping[i]);
 		}
+		break;
+	case 1:
+		printk("attach: %llu us, %s\n",
+		       (unsigned long long)ni->attach_time_ns / 1000,
+		       ni->attach_hinted ? "hinted" :
+		       ni->attach_hint_missed ? "hint missed, full search" :
+		       "full search");
+		if (ni->hint_page)
+			printk("hint: generation %u, %u misses, %u free pages\n",
+			       ni->hint_valid ? ni->hint.generation : 0,
+			       ni->hint_valid ? ni->hint.misses : 0,
+			       (bmtd.blk_size >> bmtd.pg_shift) - ni->hint_page);
+		else
+			printk("hint: no hint log\n");
+		break;
+	case 2:
+		printk("write back: %s, %u table updates for %u remaps, %u avoided\n",
+		       ni->write_back ? "on" : "off", ni->table_commits,
+		       ni->table_commits + ni->table_updates_avoided,
+		       ni->table_updates_avoided);
+		break;
 	}
 
 	return 0;
@@ -2345,4 +2769,5 @@ const struct mtk_bmt_ops mtk_bmt_nmbm_ops = {
 	.unmap_block = unmap_block_nmbm,
 	.get_mapping_block = get_mapping_block_index_nmbm,
 	.debug = mtk_bmt_debug_nmbm,
+	.commit = commit_nmbm,
 };
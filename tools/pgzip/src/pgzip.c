@@ -0,0 +1,400 @@
+/*
+ * pgzip - deterministic parallel gzip compressor
+ *
+ * Copyright (C) 2026 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Compresses stdin to stdout as a single gzip member: the input is cut into
+ * blocks of a fixed size, each block is deflated on its own with the last
+ * 32 KiB of the previous block as preset dictionary and ends on a byte
+ * boundary, so blocks can be compressed in parallel and simply concatenated.
+ * The output only depends on the block size and level, not on the number of
+ * threads. The header carries no name and no time, like gzip -n.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define DICT_SIZE	32768
+
+enum job_state {
+	JOB_FREE,
+	JOB_FILLED,
+	JOB_BUSY,
+	JOB_DONE,
+};
+
+struct job {
+	enum job_state state;
+	unsigned long seq;
+	int last;
+
+	/* preset dictionary, followed by the input of the block */
+	unsigned char *in;
+	size_t dict, len;
+	uLong crc;
+
+	unsigned char *out;
+	size_t out_len, out_size;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static struct job *jobs;
+static unsigned int n_jobs;
+static size_t block_size = 128 * 1024;
+static int level = Z_DEFAULT_COMPRESSION;
+
+static unsigned long next_compress;
+static unsigned long n_filled;
+static int input_done;
+static int failed;
+
+static void fail(const char *msg)
+{
+	fprintf(stderr, "pgzip: %s\n", msg);
+	exit(1);
+}
+
+static void *xmalloc(size_t size)
+{
+	void *ptr = malloc(size);
+
+	if (!ptr)
+		fail("out of memory");
+
+	return ptr;
+}
+
+static struct job *job_get(unsigned long seq)
+{
+	return &jobs[seq % n_jobs];
+}
+
+static int deflate_run(z_stream *strm, struct job *job, int flush)
+{
+	int ret;
+
+	do {
+		if (job->out_len == job->out_size) {
+			job->out_size *= 2;
+			job->out = realloc(job->out, job->out_size);
+			if (!job->out)
+				return Z_MEM_ERROR;
+		}
+
+		strm->next_out = job->out + job->out_len;
+		strm->avail_out = job->out_size - job->out_len;
+		ret = deflate(strm, flush);
+		job->out_len = job->out_size - strm->avail_out;
+	} while (strm->avail_out == 0 && ret != Z_STREAM_END);
+
+	return ret == Z_BUF_ERROR ? Z_OK : ret;
+}
+
+static int compress_job(z_stream *strm, struct job *job)
+{
+	int bits, ret;
+
+	deflateReset(strm);
+	if (job->dict)
+		deflateSetDictionary(strm, job->in, job->dict);
+
+	strm->next_in = job->in + job->dict;
+	strm->avail_in = job->len;
+	job->out_len = 0;
+
+	if (job->last)
+		return deflate_run(strm, job, Z_FINISH) == Z_STREAM_END ? 0 : -1;
+
+	/* End the block on a byte boundary, with as few bits as possible */
+	if (deflate_run(strm, job, Z_BLOCK) != Z_OK ||
+	    deflatePending(strm, Z_NULL, &bits) != Z_OK)
+		return -1;
+
+	if (bits & 1) {
+		ret = deflate_run(strm, job, Z_SYNC_FLUSH);
+	} else if (bits & 7) {
+		do {
+			/* empty static block */
+			if (deflatePrime(strm, 10, 2) != Z_OK)
+				return -1;
+			deflatePending(strm, Z_NULL, &bits);
+		} while (bits & 7);
+		ret = deflate_run(strm, job, Z_BLOCK);
+	} else {
+		ret = Z_OK;
+	}
+
+	return ret == Z_OK ? 0 : -1;
+}
+
+static void *compress_thread(void *arg)
+{
+	z_stream strm = { 0 };
+	struct job *job;
+	int ret;
+
+	if (deflateInit2(&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		fail("failed to initialize zlib");
+
+	pthread_mutex_lock(&lock);
+	while (1) {
+		while (next_compress == n_filled && !input_done)
+			pthread_cond_wait(&cond, &lock);
+
+		if (next_compress == n_filled)
+			break;
+
+		job = job_get(next_compress++);
+		job->state = JOB_BUSY;
+		pthread_mutex_unlock(&lock);
+
+		job->crc = crc32(0, job->in + job->dict, job->len);
+		ret = compress_job(&strm, job);
+
+		pthread_mutex_lock(&lock);
+		if (ret)
+			failed = 1;
+		job->state = JOB_DONE;
+		pthread_cond_broadcast(&cond);
+	}
+	pthread_mutex_unlock(&lock);
+
+	deflateEnd(&strm);
+	return NULL;
+}
+
+static int write_all(const unsigned char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(STDOUT_FILENO, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static void put_le32(unsigned char *buf, uint32_t val)
+{
+	buf[0] = val;
+	buf[1] = val >> 8;
+	buf[2] = val >> 16;
+	buf[3] = val >> 24;
+}
+
+static void *write_thread(void *arg)
+{
+	unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+	unsigned char trailer[8];
+	unsigned long seq = 0;
+	uLong crc = crc32(0, NULL, 0);
+	uint32_t size = 0;
+	struct job *job;
+	int last = 0;
+
+	header[8] = level >= 9 ? 2 : level == 1 ? 4 : 0;
+	if (write_all(header, sizeof(header)))
+		fail("write error");
+
+	while (!last) {
+		job = job_get(seq);
+
+		pthread_mutex_lock(&lock);
+		while (!(job->seq == seq && job->state == JOB_DONE))
+			pthread_cond_wait(&cond, &lock);
+		if (failed)
+			fail("compression failed");
+		pthread_mutex_unlock(&lock);
+
+		if (write_all(job->out, job->out_len))
+			fail("write error");
+
+		crc = crc32_combine(crc, job->crc, job->len);
+		size += job->len;
+		last = job->last;
+
+		pthread_mutex_lock(&lock);
+		job->state = JOB_FREE;
+		pthread_cond_broadcast(&cond);
+		pthread_mutex_unlock(&lock);
+
+		seq++;
+	}
+
+	put_le32(trailer, crc);
+	put_le32(trailer + 4, size);
+	if (write_all(trailer, sizeof(trailer)))
+		fail("write error");
+
+	return NULL;
+}
+
+static size_t read_block(unsigned char *buf, size_t len)
+{
+	size_t total = 0;
+	ssize_t n;
+
+	while (total < len) {
+		n = read(STDIN_FILENO, buf + total, len - total);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			fail("read error");
+		if (n == 0)
+			break;
+
+		total += n;
+	}
+
+	return total;
+}
+
+static struct job *job_acquire(unsigned long seq)
+{
+	struct job *job = job_get(seq);
+
+	pthread_mutex_lock(&lock);
+	while (job->state != JOB_FREE)
+		pthread_cond_wait(&cond, &lock);
+	job->seq = seq;
+	job->last = 0;
+	pthread_mutex_unlock(&lock);
+
+	return job;
+}
+
+static void job_publish(struct job *job)
+{
+	pthread_mutex_lock(&lock);
+	job->state = JOB_FILLED;
+	n_filled++;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&lock);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-1..-9] [-b <KiB>] [-p <threads>] < input > output.gz\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t *threads, writer;
+	struct job *job, *next;
+	unsigned long seq = 0;
+	long n_threads = 0;
+	unsigned int i;
+	size_t dict;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "123456789b:np:")) != -1) {
+		switch (ch) {
+		case '1' ... '9':
+			level = ch - '0';
+			break;
+		case 'b':
+			block_size = strtoul(optarg, NULL, 0) * 1024;
+			if (block_size < DICT_SIZE || block_size > (1 << 30))
+				usage(argv[0]);
+			break;
+		case 'n':
+			/* never stores a name or time */
+			break;
+		case 'p':
+			n_threads = strtol(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind != argc)
+		usage(argv[0]);
+
+	if (n_threads <= 0)
+		n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n_threads <= 0)
+		n_threads = 1;
+
+	/* keep every thread busy while the writer drains the output */
+	n_jobs = n_threads * 2 + 2;
+	jobs = calloc(n_jobs, sizeof(*jobs));
+	threads = calloc(n_threads, sizeof(*threads));
+	if (!jobs || !threads)
+		fail("out of memory");
+
+	for (i = 0; i < n_jobs; i++) {
+		jobs[i].in = xmalloc(DICT_SIZE + block_size);
+		jobs[i].out_size = deflateBound(NULL, block_size) + 64;
+		jobs[i].out = xmalloc(jobs[i].out_size);
+	}
+
+	for (i = 0; i < n_threads; i++)
+		if (pthread_create(&threads[i], NULL, compress_thread, NULL))
+			fail("failed to create thread");
+
+	if (pthread_create(&writer, NULL, write_thread, NULL))
+		fail("failed to create thread");
+
+	/*
+	 * A block is only handed out once the next one was read, to know
+	 * whether it is the last one.
+	 */
+	job = job_acquire(seq++);
+	job->dict = 0;
+	job->len = read_block(job->in, block_size);
+
+	while (job->len == block_size) {
+		next = job_acquire(seq++);
+
+		dict = job->len < DICT_SIZE ? job->len : DICT_SIZE;
+		memcpy(next->in, job->in + job->dict + job->len - dict, dict);
+		next->dict = dict;
+		next->len = read_block(next->in + dict, block_size);
+
+		if (!next->len) {
+			/* never handed out, the slot is free again */
+			seq--;
+			break;
+		}
+
+		job_publish(job);
+		job = next;
+	}
+
+	job->last = 1;
+	job_publish(job);
+
+	pthread_mutex_lock(&lock);
+	input_done = 1;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&lock);
+
+	for (i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+	pthread_join(writer, NULL);
+
+	return 0;
+}